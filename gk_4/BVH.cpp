@@ -0,0 +1,311 @@
+#include"BVH.h"
+#include<algorithm>
+#include<cfloat>
+
+// Relative cost of visiting a node against testing one object in a leaf
+static const float TraversalCost = 1.0f;
+static const float IntersectionCost = 1.0f;
+static const int BinCount = 16;
+static const uint32_t MaxLeafSize = 4;
+// Keeps the traversal stacks (one entry per level plus one) within their fixed size
+static const int MaxDepth = 62;
+
+static float SurfaceArea(const AABB& box)
+{
+	glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static AABB EmptyBox()
+{
+	return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+static void Grow(AABB& box, const AABB& other)
+{
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+
+// Builds the tree over boxes[i] for every object i
+void BVH::Build(const std::vector<AABB>& boxes)
+{
+	itemBoxes = boxes;
+	nodes.clear();
+	items.resize(boxes.size());
+	centroids.resize(boxes.size());
+	for (uint32_t i = 0; i < boxes.size(); i++)
+	{
+		items[i] = i;
+		centroids[i] = boxes[i].Center();
+	}
+	if (boxes.empty())
+	{
+		cost = builtCost = 0.0f;
+		return;
+	}
+
+	// A binary tree with n leaves has at most 2n - 1 nodes
+	nodes.reserve(2 * boxes.size());
+	nodes.push_back({ EmptyBox(), 0, (uint32_t)boxes.size(), 0 });
+	Subdivide(0, 0);
+	UpdateNodeBoxes();
+	cost = builtCost = ComputeCost();
+}
+
+// Splits the node along the binned SAH plane, recursing into both children
+void BVH::Subdivide(uint32_t nodeIndex, int depth)
+{
+	uint32_t first = nodes[nodeIndex].firstItem;
+	uint32_t count = nodes[nodeIndex].itemCount;
+	if (count <= 1 || depth >= MaxDepth)
+		return;
+
+	// Bins are placed over the bounds of the centroids, not of the boxes
+	AABB nodeBox = EmptyBox();
+	AABB centroidBox = EmptyBox();
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		Grow(nodeBox, itemBoxes[items[i]]);
+		Grow(centroidBox, { centroids[items[i]], centroids[items[i]] });
+	}
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	float bestSplit = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lo = centroidBox.min[axis], hi = centroidBox.max[axis];
+		if (hi <= lo)
+			continue;
+
+		AABB binBoxes[BinCount];
+		uint32_t binCounts[BinCount] = {};
+		for (AABB& box : binBoxes)
+			box = EmptyBox();
+		float scale = BinCount / (hi - lo);
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			int bin = std::min(BinCount - 1, (int)((centroids[items[i]][axis] - lo) * scale));
+			binCounts[bin]++;
+			Grow(binBoxes[bin], itemBoxes[items[i]]);
+		}
+
+		// Sweep from both sides to get the cost of every plane between two bins
+		float leftArea[BinCount - 1], rightArea[BinCount - 1];
+		uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+		AABB leftBox = EmptyBox(), rightBox = EmptyBox();
+		uint32_t leftSum = 0, rightSum = 0;
+		for (int i = 0; i < BinCount - 1; i++)
+		{
+			leftSum += binCounts[i];
+			leftCount[i] = leftSum;
+			Grow(leftBox, binBoxes[i]);
+			leftArea[i] = leftSum ? SurfaceArea(leftBox) : 0.0f;
+
+			rightSum += binCounts[BinCount - 1 - i];
+			rightCount[BinCount - 2 - i] = rightSum;
+			Grow(rightBox, binBoxes[BinCount - 1 - i]);
+			rightArea[BinCount - 2 - i] = rightSum ? SurfaceArea(rightBox) : 0.0f;
+		}
+		for (int i = 0; i < BinCount - 1; i++)
+		{
+			if (leftCount[i] == 0 || rightCount[i] == 0)
+				continue;
+			float planeCost = leftArea[i] * leftCount[i] + rightArea[i] * rightCount[i];
+			if (planeCost < bestCost)
+			{
+				bestCost = planeCost;
+				bestAxis = axis;
+				bestSplit = lo + (i + 1) / scale;
+			}
+		}
+	}
+
+	// Small nodes stay leaves when no split is cheaper than testing every object
+	float leafCost = IntersectionCost * count;
+	float splitCost = TraversalCost + IntersectionCost * bestCost / std::max(SurfaceArea(nodeBox), FLT_MIN);
+	if (bestAxis < 0 || (count <= MaxLeafSize && splitCost >= leafCost))
+		return;
+
+	uint32_t* begin = &items[first];
+	uint32_t* middle = std::partition(begin, begin + count,
+		[&](uint32_t item) { return centroids[item][bestAxis] < bestSplit; });
+	uint32_t leftItems = (uint32_t)(middle - begin);
+	if (leftItems == 0 || leftItems == count)
+		return;
+
+	uint32_t left = (uint32_t)nodes.size();
+	nodes.push_back({ EmptyBox(), first, leftItems, 0 });
+	nodes.push_back({ EmptyBox(), first + leftItems, count - leftItems, 0 });
+	nodes[nodeIndex].left = left;
+	Subdivide(left, depth + 1);
+	Subdivide(left + 1, depth + 1);
+}
+
+// Recomputes the box of every node from its children or items, children first
+void BVH::UpdateNodeBoxes()
+{
+	// Children are always stored after their parent, so a reverse sweep visits them first
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		Node& node = nodes[n];
+		if (node.left)
+		{
+			node.box = nodes[node.left].box;
+			Grow(node.box, nodes[node.left + 1].box);
+		}
+		else
+		{
+			node.box = EmptyBox();
+			for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+				Grow(node.box, itemBoxes[items[i]]);
+		}
+	}
+}
+
+// Surface area heuristic cost of the whole tree
+float BVH::ComputeCost() const
+{
+	if (nodes.empty())
+		return 0.0f;
+	float total = 0.0f;
+	for (const Node& node : nodes)
+		total += SurfaceArea(node.box) * (node.left ? TraversalCost : IntersectionCost * node.itemCount);
+	return total / std::max(SurfaceArea(nodes[0].box), FLT_MIN);
+}
+
+// Moves the node boxes to the new object boxes, keeping the tree structure
+void BVH::Refit(const std::vector<AABB>& boxes)
+{
+	itemBoxes = boxes;
+	UpdateNodeBoxes();
+	cost = ComputeCost();
+}
+
+// Refits, or rebuilds when the object count changed or the tree has degraded
+void BVH::Update(const std::vector<AABB>& boxes)
+{
+	if (boxes.size() != itemBoxes.size() || nodes.empty())
+	{
+		Build(boxes);
+		return;
+	}
+	Refit(boxes);
+	if (cost > builtCost * rebuildThreshold)
+	{
+		Build(boxes);
+		rebuilds++;
+	}
+}
+
+// Sets visible[i] for every object i whose box touches the frustum, returns how many do
+size_t BVH::Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+	visible.assign(itemBoxes.size(), 0);
+	if (nodes.empty())
+		return 0;
+
+	// Each stack entry keeps the planes its parent was not entirely inside of;
+	// once a node is inside all six, its whole subtree is visible without further tests
+	struct Entry { uint32_t node; uint32_t planeMask; };
+	Entry stack[64];
+	int top = 0;
+	stack[top++] = { 0, 0x3F };
+	size_t visibleCount = 0;
+	while (top > 0)
+	{
+		Entry entry = stack[--top];
+		const Node& node = nodes[entry.node];
+		uint32_t mask = entry.planeMask;
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			if (!(mask & (1u << p)))
+				continue;
+			const glm::vec4& plane = frustum.planes[p];
+			glm::vec3 normal(plane);
+			glm::vec3 center = node.box.Center();
+			glm::vec3 extents = node.box.Extents();
+			float distance = glm::dot(normal, center) + plane.w;
+			float radius = glm::dot(glm::abs(normal), extents);
+			if (distance < -radius)
+				outside = true;
+			else if (distance >= radius)
+				mask &= ~(1u << p);
+		}
+		if (outside)
+			continue;
+
+		if (mask == 0 || !node.left)
+		{
+			// Leaf objects still get their own box test unless the node was fully inside
+			for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+			{
+				if (mask == 0 || frustum.Intersects(itemBoxes[items[i]]))
+				{
+					visible[items[i]] = 1;
+					visibleCount++;
+				}
+			}
+			continue;
+		}
+		stack[top++] = { node.left, mask };
+		stack[top++] = { node.left + 1, mask };
+	}
+	return visibleCount;
+}
+
+// Slab test, returns the entry distance along the ray or FLT_MAX on a miss
+static float IntersectBox(const AABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxT)
+{
+	glm::vec3 t0 = (box.min - origin) * inverseDirection;
+	glm::vec3 t1 = (box.max - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxT));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+// Returns the object whose box the ray enters first (or -1) and the hit distance in hitT
+int BVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxT, float& hitT) const
+{
+	int hit = -1;
+	hitT = maxT;
+	if (nodes.empty())
+		return hit;
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	uint32_t stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (IntersectBox(node.box, origin, inverseDirection, hitT) == FLT_MAX)
+			continue;
+		if (!node.left)
+		{
+			for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++)
+			{
+				float t = IntersectBox(itemBoxes[items[i]], origin, inverseDirection, hitT);
+				if (t < hitT)
+				{
+					hitT = t;
+					hit = (int)items[i];
+				}
+			}
+			continue;
+		}
+		// Push the farther child first so the nearer one shrinks hitT before it is visited
+		float leftT = IntersectBox(nodes[node.left].box, origin, inverseDirection, hitT);
+		float rightT = IntersectBox(nodes[node.left + 1].box, origin, inverseDirection, hitT);
+		uint32_t nearChild = leftT <= rightT ? node.left : node.left + 1;
+		uint32_t farChild = leftT <= rightT ? node.left + 1 : node.left;
+		if (std::max(leftT, rightT) != FLT_MAX)
+			stack[top++] = farChild;
+		if (std::min(leftT, rightT) != FLT_MAX)
+			stack[top++] = nearChild;
+	}
+	return hit;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+
+#include"Bounds.h"
+#include"Frustum.h"
+
+// Bounding volume hierarchy over world space object boxes. Built top-down with the
+// surface area heuristic; moving objects only refit the node boxes, and the tree is
+// rebuilt once refitting has made it noticeably worse than it was right after a build.
+class BVH
+{
+public:
+	// Refit cost (relative to the cost after the last build) that triggers a rebuild
+	float rebuildThreshold = 1.5f;
+
+	// Builds the tree over boxes[i] for every object i
+	void Build(const std::vector<AABB>& boxes);
+	// Moves the node boxes to the new object boxes, keeping the tree structure
+	void Refit(const std::vector<AABB>& boxes);
+	// Refits, or rebuilds when the object count changed or the tree has degraded
+	void Update(const std::vector<AABB>& boxes);
+
+	// Sets visible[i] for every object i whose box touches the frustum, returns how many do
+	size_t Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+	// Returns the object whose box the ray enters first (or -1) and the hit distance in hitT
+	int Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxT, float& hitT) const;
+
+	size_t Size() const { return itemBoxes.size(); }
+	size_t NodeCount() const { return nodes.size(); }
+	// Surface area cost of the tree; lower is better
+	float Cost() const { return cost; }
+	float BuiltCost() const { return builtCost; }
+	int Rebuilds() const { return rebuilds; }
+
+private:
+	struct Node
+	{
+		AABB box;
+		// Range of items[] below this node (items of a subtree are contiguous)
+		uint32_t firstItem;
+		uint32_t itemCount;
+		// Index of the left child, the right child follows it; 0 for leaves
+		uint32_t left;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> items;
+	std::vector<AABB> itemBoxes;
+	std::vector<glm::vec3> centroids;
+	float cost = 0.0f;
+	float builtCost = 0.0f;
+	int rebuilds = 0;
+
+	// Splits the node along the binned SAH plane, recursing into both children
+	void Subdivide(uint32_t nodeIndex, int depth);
+	// Recomputes the box of every node from its children or items, children first
+	void UpdateNodeBoxes();
+	// Surface area heuristic cost of the whole tree
+	float ComputeCost() const;
+};
@@ -0,0 +1,144 @@
+#include"BVHBenchmark.h"
+#include"BVH.h"
+#include<glm/gtc/matrix_transform.hpp>
+#include<chrono>
+#include<random>
+#include<cfloat>
+#include<cmath>
+#include<iostream>
+
+using BenchClock = std::chrono::steady_clock;
+
+static double MillisecondsSince(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// Slab test against one box, used for the brute force ray query
+static float RayBoxDistance(const AABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxT)
+{
+	glm::vec3 t0 = (box.min - origin) * inverseDirection;
+	glm::vec3 t1 = (box.max - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxT));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+static void BenchmarkScene(int objectCount)
+{
+	const int frames = 30;
+	const int rayCount = 1000;
+	std::mt19937 random(1234u + objectCount);
+	// Objects fill a cube whose volume grows with the count, so the density stays the same
+	float extent = 2.0f * std::cbrt((float)objectCount);
+	std::uniform_real_distribution<float> position(-extent, extent);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// Unit cube with the same bounds the scene objects get from their vertices
+	float cubeCorners[] = { -0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f };
+	Bounds localBounds = Bounds::FromVertices(cubeCorners, 6, 3);
+	std::vector<glm::vec3> origins(objectCount), velocities(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		origins[i] = glm::vec3(position(random), position(random), position(random));
+		velocities[i] = glm::vec3(unit(random), unit(random), unit(random));
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 4.0f * extent);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, extent), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = Frustum::FromMatrix(projection * view);
+
+	CullingBatch batch;
+	BVH bvh;
+	std::vector<uint8_t> bvhVisible, bruteVisible;
+	double buildMs = 0.0, updateMs = 0.0, bvhCullMs = 0.0, bruteCullMs = 0.0;
+	size_t visibleCount = 0, mismatches = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		// Every object drifts a little each frame, the way the animated scene objects move
+		float time = frame * 0.05f;
+		batch.Clear();
+		for (int i = 0; i < objectCount; i++)
+			batch.Add(localBounds, glm::translate(glm::mat4(1.0f), origins[i] + velocities[i] * time));
+
+		BenchClock::time_point start = BenchClock::now();
+		if (frame == 0)
+		{
+			bvh.Build(batch.Boxes());
+			buildMs = MillisecondsSince(start);
+		}
+		else
+		{
+			bvh.Update(batch.Boxes());
+			updateMs += MillisecondsSince(start);
+		}
+
+		start = BenchClock::now();
+		visibleCount = bvh.Cull(frustum, bvhVisible);
+		bvhCullMs += MillisecondsSince(start);
+
+		start = BenchClock::now();
+		batch.Cull(frustum, bruteVisible);
+		bruteCullMs += MillisecondsSince(start);
+
+		// The sphere pre-test can only reject more, so the box results have to agree exactly
+		for (int i = 0; i < objectCount; i++)
+			mismatches += bvhVisible[i] != bruteVisible[i];
+	}
+
+	// Rays from random points in the volume in random directions
+	std::vector<glm::vec3> rayOrigins(rayCount), rayDirections(rayCount);
+	for (int i = 0; i < rayCount; i++)
+	{
+		rayOrigins[i] = glm::vec3(position(random), position(random), position(random));
+		rayDirections[i] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+	}
+	const std::vector<AABB>& boxes = batch.Boxes();
+	float maxT = 4.0f * extent;
+	int rayHits = 0, rayMismatches = 0;
+	std::vector<int> bvhHits(rayCount);
+	BenchClock::time_point start = BenchClock::now();
+	for (int r = 0; r < rayCount; r++)
+	{
+		float t;
+		bvhHits[r] = bvh.Raycast(rayOrigins[r], rayDirections[r], maxT, t);
+	}
+	double bvhRayMs = MillisecondsSince(start);
+	start = BenchClock::now();
+	for (int r = 0; r < rayCount; r++)
+	{
+		glm::vec3 inverseDirection = 1.0f / rayDirections[r];
+		int hit = -1;
+		float hitT = maxT;
+		for (int i = 0; i < objectCount; i++)
+		{
+			float t = RayBoxDistance(boxes[i], rayOrigins[r], inverseDirection, hitT);
+			if (t < hitT)
+			{
+				hitT = t;
+				hit = i;
+			}
+		}
+		rayHits += hit >= 0;
+		// Ties between overlapping boxes may pick either object, so only hit/miss is compared
+		rayMismatches += (hit >= 0) != (bvhHits[r] >= 0);
+	}
+	double bruteRayMs = MillisecondsSince(start);
+
+	int updates = frames - 1;
+	std::cout << objectCount << " objects: " << bvh.NodeCount() << " nodes, build " << buildMs << " ms, refit/rebuild "
+		<< updateMs / updates << " ms (" << bvh.Rebuilds() << " rebuilds, cost " << bvh.Cost() << " vs " << bvh.BuiltCost() << " built)\n"
+		<< "  frustum (" << visibleCount << " visible): bvh " << bvhCullMs / frames << " ms, brute force " << bruteCullMs / frames
+		<< " ms, " << mismatches << " mismatches\n"
+		<< "  " << rayCount << " rays (" << rayHits << " hits): bvh " << bvhRayMs << " ms, brute force " << bruteRayMs
+		<< " ms, " << rayMismatches << " mismatches" << std::endl;
+}
+
+// Compares BVH frustum culling and ray queries against brute force over 1k, 10k and
+// 100k moving objects and prints the timings (no GL context needed)
+void RunBVHBenchmark()
+{
+	for (int objectCount : { 1000, 10000, 100000 })
+		BenchmarkScene(objectCount);
+}
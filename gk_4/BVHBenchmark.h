@@ -0,0 +1,5 @@
+#pragma once
+
+// Compares BVH frustum culling and ray queries against brute force over 1k, 10k and
+// 100k moving objects and prints the timings (no GL context needed)
+void RunBVHBenchmark();
@@ -0,0 +1,49 @@
+#include"Bounds.h"
+#include<cmath>
+#include<algorithm>
+
+// Box enclosing this box after the transform
+AABB AABB::Transformed(const glm::mat4& model) const
+{
+	// Transform the center and project the extents onto the world axes (Arvo's method)
+	glm::vec3 center = glm::vec3(model * glm::vec4(Center(), 1.0f));
+	glm::vec3 extents = Extents();
+	glm::vec3 worldExtents(0.0f);
+	for (int axis = 0; axis < 3; axis++)
+		worldExtents += glm::abs(glm::vec3(model[axis])) * extents[axis];
+	return { center - worldExtents, center + worldExtents };
+}
+
+// Sphere enclosing this sphere after the transform (radius grows with the largest axis scale)
+BoundingSphere BoundingSphere::Transformed(const glm::mat4& model) const
+{
+	float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+	return { glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale };
+}
+
+// Computes the bounds of interleaved vertex data whose first three floats are the position
+Bounds Bounds::FromVertices(const float* vertices, size_t floatCount, size_t strideFloats)
+{
+	Bounds bounds;
+	if (floatCount < 3)
+		return bounds;
+
+	bounds.box.min = bounds.box.max = glm::vec3(vertices[0], vertices[1], vertices[2]);
+	for (size_t i = 0; i + 2 < floatCount; i += strideFloats)
+	{
+		glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+		bounds.box.min = glm::min(bounds.box.min, position);
+		bounds.box.max = glm::max(bounds.box.max, position);
+	}
+
+	// Sphere around the box center, tightened to the farthest vertex
+	bounds.sphere.center = bounds.box.Center();
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i + 2 < floatCount; i += strideFloats)
+	{
+		glm::vec3 offset = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]) - bounds.sphere.center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	bounds.sphere.radius = std::sqrt(radiusSquared);
+	return bounds;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include<glm/glm.hpp>
+#include<cstddef>
+
+// Axis aligned bounding box
+struct AABB
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	glm::vec3 Extents() const { return (max - min) * 0.5f; }
+	// Box enclosing this box after the transform
+	AABB Transformed(const glm::mat4& model) const;
+};
+
+struct BoundingSphere
+{
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+
+	// Sphere enclosing this sphere after the transform (radius grows with the largest axis scale)
+	BoundingSphere Transformed(const glm::mat4& model) const;
+};
+
+// Local space bounds of a mesh
+struct Bounds
+{
+	AABB box;
+	BoundingSphere sphere;
+
+	// Computes the bounds of interleaved vertex data whose first three floats are the position
+	static Bounds FromVertices(const float* vertices, size_t floatCount, size_t strideFloats);
+};
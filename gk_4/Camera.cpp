@@ -18,12 +18,21 @@ void Camera::updateMatrix(float FOVdeg, float nearPlane, float farPlane)
 
     // Optionally, compute a combined camera matrix.
     cameraMatrix = projectionMatrix * viewMatrix;
+
+    // Frustum planes for culling against the combined matrix.
+    frustum = Frustum::FromMatrix(cameraMatrix);
 }
 
 void Camera::Matrix(Shader& shader, const char* uniform)
 {
     // This sends the combined cameraMatrix to the shader.
-    glUniformMatrix4fv(glGetUniformLocation(shader.ID, uniform), 1, GL_FALSE, glm::value_ptr(cameraMatrix));
+    Matrix(shader, shader.GetUniform<glm::mat4>(uniform));
+}
+
+void Camera::Matrix(Shader& shader, Uniform<glm::mat4> uniform)
+{
+    // Pre-resolved handle: no location lookup per frame.
+    shader.set(uniform, cameraMatrix);
 }
 
 void Camera::Inputs(GLFWwindow* window)
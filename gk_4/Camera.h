@@ -1,7 +1,7 @@
 #pragma once
 
-#include <glad\glad.h>
-#include <GLFW\glfw3.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtx/vector_angle.hpp>
@@ -9,6 +9,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "Frustum.h"
 
 enum CameraMode { FIRST_PERSON, THIRD_PERSON, ORBITAL };
 
@@ -21,6 +22,8 @@ public:
     glm::mat4 cameraMatrix = glm::mat4(1.0f);
     glm::mat4 viewMatrix;
     glm::mat4 projectionMatrix;
+    // Planes of cameraMatrix, refreshed by updateMatrix
+    Frustum frustum;
 
     int width;
     int height;
@@ -40,6 +43,7 @@ public:
     Camera(int width, int height, glm::vec3 position);
     void updateMatrix(float FOVdeg, float nearPlane, float farPlane);
     void Matrix(Shader& shader, const char* uniform);
+    void Matrix(Shader& shader, Uniform<glm::mat4> uniform);
     void Inputs(GLFWwindow* window);
     void HandleModes(GLFWwindow* window);
 };
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include"ClusteredLighting.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstring>
+#include<iostream>
+
+// uvec2 slots taken by the GridHeader at the start of the grid block
+static const size_t HeaderWords = sizeof(ClusteredLighting::GridHeader) / sizeof(glm::uvec2);
+static_assert(sizeof(ClusteredLighting::GridHeader) % sizeof(glm::uvec2) == 0, "GridHeader must fill whole uvec2 slots");
+
+// Constructor for a camera with the given clip planes; clustered false only uploads the
+// light list (LIGHT_LIST_ALL)
+ClusteredLighting::ClusteredLighting(float nearPlane, float farPlane, bool clustered)
+	: nearPlane(nearPlane), farPlane(farPlane), clustered(clustered)
+{
+	// Exponential slices: slice = GridZ * log(depth / near) / log(far / near)
+	sliceScale = GridZ / std::log(farPlane / nearPlane);
+	sliceBias = -std::log(nearPlane) * sliceScale;
+	grid.resize(HeaderWords + ClusterCount);
+}
+
+// Packs the lights and bins them into the clusters of the view (lights need radius > 0)
+void ClusteredLighting::Update(const std::vector<LightSource>& lights, const glm::mat4& view, const glm::mat4& projection)
+{
+	auto start = std::chrono::steady_clock::now();
+	gpuLights.clear();
+	references.clear();
+	const float scaleX = projection[0][0], scaleY = projection[1][1];
+
+	for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+	{
+		const LightSource& light = lights[i];
+		GPULight gpuLight;
+		gpuLight.positionRadius = glm::vec4(light.position, light.radius);
+		gpuLight.colorType = glm::vec4(light.color, (float)light.type);
+		gpuLight.directionCutOff = glm::vec4(light.type == SPOT_LIGHT ? glm::normalize(light.direction) : glm::vec3(0.0f), light.cutOff);
+		gpuLight.outerCutOff = glm::vec4(light.outerCutOff, 0.0f, 0.0f, 0.0f);
+		gpuLights.push_back(gpuLight);
+		if (!clustered)
+			continue;
+
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		float depth = -center.z, radius = light.radius;
+		if (depth + radius < nearPlane || depth - radius > farPlane)
+			continue;
+
+		int firstSlice = sliceOf(std::max(depth - radius, nearPlane));
+		int lastSlice = sliceOf(std::min(depth + radius, farPlane));
+		for (int slice = firstSlice; slice <= lastSlice; slice++)
+		{
+			// Part of the sphere inside the slice: its depth range and widest cross section
+			float zNear = std::max(sliceStart(slice), std::max(depth - radius, nearPlane));
+			float zFar = std::min(sliceStart(slice + 1), depth + radius);
+			float dz = depth < zNear ? zNear - depth : depth > zFar ? depth - zFar : 0.0f;
+			float sliceRadius = std::sqrt(std::max(radius * radius - dz * dz, 0.0f));
+
+			// Conservative screen rectangle: an edge left of the axis projects furthest out at
+			// the near depth of the range, an edge right of it at the far depth (and vice versa)
+			float x0 = center.x - sliceRadius, x1 = center.x + sliceRadius;
+			float y0 = center.y - sliceRadius, y1 = center.y + sliceRadius;
+			float ndcX0 = scaleX * x0 / (x0 < 0.0f ? zNear : zFar);
+			float ndcX1 = scaleX * x1 / (x1 > 0.0f ? zNear : zFar);
+			float ndcY0 = scaleY * y0 / (y0 < 0.0f ? zNear : zFar);
+			float ndcY1 = scaleY * y1 / (y1 > 0.0f ? zNear : zFar);
+			if (ndcX1 < -1.0f || ndcX0 > 1.0f || ndcY1 < -1.0f || ndcY0 > 1.0f)
+				continue;
+			int tileX0 = std::clamp((int)std::floor((ndcX0 * 0.5f + 0.5f) * GridX), 0, GridX - 1);
+			int tileX1 = std::clamp((int)std::floor((ndcX1 * 0.5f + 0.5f) * GridX), 0, GridX - 1);
+			int tileY0 = std::clamp((int)std::floor((ndcY0 * 0.5f + 0.5f) * GridY), 0, GridY - 1);
+			int tileY1 = std::clamp((int)std::floor((ndcY1 * 0.5f + 0.5f) * GridY), 0, GridY - 1);
+			for (int y = tileY0; y <= tileY1; y++)
+			{
+				for (int x = tileX0; x <= tileX1; x++)
+					references.push_back(glm::uvec2((slice * GridY + y) * GridX + x, i));
+			}
+		}
+	}
+
+	// Counting sort of the references by cluster: counts, offsets, then the flat index list
+	std::fill(grid.begin() + HeaderWords, grid.end(), glm::uvec2(0));
+	glm::uvec2* clusters = grid.data() + HeaderWords;
+	for (const glm::uvec2& reference : references)
+		clusters[reference.x].y++;
+	uint32_t offset = 0;
+	maxClusterLights = 0;
+	for (int cluster = 0; cluster < ClusterCount; cluster++)
+	{
+		clusters[cluster].x = offset;
+		offset += clusters[cluster].y;
+		maxClusterLights = std::max(maxClusterLights, clusters[cluster].y);
+		clusters[cluster].y = 0;
+	}
+	indices.resize(references.size());
+	for (const glm::uvec2& reference : references)
+	{
+		glm::uvec2& cluster = clusters[reference.x];
+		indices[cluster.x + cluster.y++] = reference.y;
+	}
+
+	GridHeader header;
+	header.view = view;
+	header.projection = glm::vec4(scaleX, scaleY, 0.0f, 0.0f);
+	header.gridSize = glm::uvec4(GridX, GridY, GridZ, (uint32_t)lights.size());
+	header.depthSlicing = glm::vec4(nearPlane, farPlane, sliceScale, sliceBias);
+	memcpy(grid.data(), &header, sizeof(GridHeader));
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	binMilliseconds += elapsed.count();
+	totalIndices += indices.size();
+	updates++;
+}
+
+// Writes the light list, and when clustered the grid and index list, to the ring buffer
+// and binds them
+void ClusteredLighting::Bind(RingBuffer& ring)
+{
+	if (gpuLights.empty())
+		return;
+	RingBuffer::BindStorage(LightBinding, ring.Write(gpuLights.data(), gpuLights.size() * sizeof(GPULight)));
+	if (!clustered)
+		return;
+	RingBuffer::BindStorage(ClusterBinding, ring.Write(grid.data(), grid.size() * sizeof(glm::uvec2)));
+	// A binding needs a non-empty range even when every light is off screen
+	const uint32_t noLights = 0;
+	if (indices.empty())
+		RingBuffer::BindStorage(IndexBinding, ring.Write(noLights));
+	else
+		RingBuffer::BindStorage(IndexBinding, ring.Write(indices.data(), indices.size() * sizeof(uint32_t)));
+}
+
+// Prints the cost of binning and the light references per cluster
+void ClusteredLighting::PrintStats() const
+{
+	if (updates == 0 || !clustered)
+		return;
+	std::cout << "Clustered lighting: " << gpuLights.size() << " lights in " << GridX << "x" << GridY << "x" << GridZ
+		<< " clusters, " << (double)totalIndices / updates << " light references per frame ("
+		<< (double)totalIndices / updates / ClusterCount << " per cluster, max " << maxClusterLights << " last frame), binning "
+		<< binMilliseconds / updates << " ms per frame" << std::endl;
+}
+
+// Depth slice containing the view depth (clamped to the grid)
+int ClusteredLighting::sliceOf(float depth) const
+{
+	return std::clamp((int)std::floor(std::log(depth) * sliceScale + sliceBias), 0, GridZ - 1);
+}
+
+// View depth where the slice starts
+float ClusteredLighting::sliceStart(int slice) const
+{
+	return nearPlane * std::pow(farPlane / nearPlane, (float)slice / GridZ);
+}
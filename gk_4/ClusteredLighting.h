@@ -0,0 +1,96 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+
+#include"LightSource.h"
+#include"RingBuffer.h"
+#include"GLExtensions.h"
+
+// Clustered forward shading for many point and spot lights with a finite radius.
+// Each frame the lights are binned on the CPU into a GridX x GridY x GridZ grid of froxels
+// (screen tiles split into exponentially spaced depth slices of the camera view). The light
+// list, the per-cluster (offset, count) pairs and the flat light index list are written to
+// the ring buffer as shader storage blocks; the LIGHT_LIST_CLUSTERED scene shader only loops
+// over the lights of the fragment's cluster. Needs GL 4.3 (glExt.shaderStorage).
+// Fragments outside the grid (the mirrored views) loop over every light instead.
+class ClusteredLighting
+{
+public:
+	// Grid resolution: screen tiles across and down, depth slices from near to far plane
+	static const int GridX = 16;
+	static const int GridY = 16;
+	static const int GridZ = 24;
+	static const int ClusterCount = GridX * GridY * GridZ;
+	// Shader storage bindings of LightList, ClusterGrid and ClusterLightIndices (layout(binding)
+	// qualifiers in default.frag)
+	static const GLuint LightBinding = 1;
+	static const GLuint ClusterBinding = 2;
+	static const GLuint IndexBinding = 3;
+
+	// std430 mirror of ListLight in default.frag
+	struct GPULight
+	{
+		glm::vec4 positionRadius;
+		// w: LightType
+		glm::vec4 colorType;
+		// xyz: spot direction, w: cosine of the inner cutoff
+		glm::vec4 directionCutOff;
+		// x: cosine of the outer cutoff
+		glm::vec4 outerCutOff;
+	};
+
+	// std430 mirror of the ClusterGrid header in default.frag, followed by ClusterCount uvec2
+	struct GridHeader
+	{
+		glm::mat4 view;
+		// x, y: projection scale (P[0][0], P[1][1])
+		glm::vec4 projection;
+		// x, y, z: grid size, w: light count
+		glm::uvec4 gridSize;
+		// x, y: near and far plane, z, w: slice = floor(log(depth) * z + w)
+		glm::vec4 depthSlicing;
+	};
+
+	// Constructor for a camera with the given clip planes; clustered false only uploads the
+	// light list (LIGHT_LIST_ALL)
+	ClusteredLighting(float nearPlane, float farPlane, bool clustered = true);
+
+	// Packs the lights and bins them into the clusters of the view (lights need radius > 0)
+	void Update(const std::vector<LightSource>& lights, const glm::mat4& view, const glm::mat4& projection);
+	// Writes the light list, and when clustered the grid and index list, to the ring buffer
+	// and binds them
+	void Bind(RingBuffer& ring);
+
+	// Light references stored in the grid by the last Update
+	size_t IndexCount() const { return indices.size(); }
+	// Most lights in one cluster in the last Update
+	uint32_t MaxClusterLights() const { return maxClusterLights; }
+	// Prints the cost of binning and the light references per cluster
+	void PrintStats() const;
+
+private:
+	float nearPlane;
+	float farPlane;
+	bool clustered;
+	float sliceScale;
+	float sliceBias;
+
+	std::vector<GPULight> gpuLights;
+	// GridHeader followed by (offset, count) per cluster, uploaded as one block
+	std::vector<glm::uvec2> grid;
+	std::vector<uint32_t> indices;
+	// (cluster, light) pairs of the current Update before they are sorted by cluster
+	std::vector<glm::uvec2> references;
+
+	uint32_t maxClusterLights = 0;
+	unsigned updates = 0;
+	double binMilliseconds = 0.0;
+	size_t totalIndices = 0;
+
+	// Depth slice containing the view depth (clamped to the grid)
+	int sliceOf(float depth) const;
+	// View depth where the slice starts
+	float sliceStart(int slice) const;
+};
@@ -0,0 +1,111 @@
+#include"DeferredRenderer.h"
+#include"UniformBlocks.h"
+
+// Texture units the lighting stage samples the G-buffer from
+static const GLint AlbedoUnit = 0, NormalUnit = 1, DepthUnit = 2;
+
+// Creates the G-buffer; lighting variants are built from deferred.vert and default.frag
+DeferredRenderer::DeferredRenderer(int width, int height, ProgramCache* cache)
+	: width(width), height(height), lightingShaders("deferred.vert", "default.frag", cache)
+{
+	glGenFramebuffers(1, &fbo);
+	glState.BindFramebuffer(fbo);
+	albedoTexture = attachTexture(GL_COLOR_ATTACHMENT0, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	normalTexture = attachTexture(GL_COLOR_ATTACHMENT1, GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+	depthTexture = attachTexture(GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "G-buffer is not complete!" << std::endl;
+	glState.BindFramebuffer(0);
+
+	lightingShaders.BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+	lightingShaders.BindUniformBlock("LightData", LIGHT_BLOCK_BINDING);
+}
+
+// Creates a texture of the given format and attaches it to the G-buffer
+GLuint DeferredRenderer::attachTexture(GLenum attachment, GLint internalFormat, GLenum format, GLenum type)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glState.BindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+	// Read with texelFetch, one texel per pixel
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+	return texture;
+}
+
+// Binds the G-buffer and clears it
+void DeferredRenderer::BeginGeometry()
+{
+	glState.BindFramebuffer(fbo);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+// Shades the G-buffer into the target framebuffer with the lighting variant matching the
+// scene features, then copies depth and stencil there and leaves it bound
+void DeferredRenderer::Light(const ShaderFeatures& sceneFeatures, GLuint targetFBO)
+{
+	ShaderFeatures features = sceneFeatures;
+	features.deferred = LIGHTING_STAGE;
+	features.instanced = false;
+	features.multiDraw = false;
+	Shader& shader = lightingShaders.Get(features);
+	shader.Activate();
+	if (&shader != preparedShader)
+	{
+		// New variant: point its samplers at the G-buffer units
+		glUniform1i(shader.FindUniform("gAlbedo"), AlbedoUnit);
+		glUniform1i(shader.FindUniform("gNormal"), NormalUnit);
+		glUniform1i(shader.FindUniform("gDepth"), DepthUnit);
+		preparedShader = &shader;
+	}
+
+	glState.BindFramebuffer(targetFBO);
+	const GLuint textures[] = { albedoTexture, normalTexture, depthTexture };
+	for (GLint unit = AlbedoUnit; unit <= DepthUnit; unit++)
+	{
+		glState.ActiveTexture(GL_TEXTURE0 + unit);
+		glState.BindTexture(GL_TEXTURE_2D, textures[unit]);
+	}
+	glState.ActiveTexture(GL_TEXTURE0);
+
+	// Every covered pixel is shaded exactly once; empty pixels are discarded
+	glDisable(GL_DEPTH_TEST);
+	glState.BindVertexArray(emptyVAO.ID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glEnable(GL_DEPTH_TEST);
+
+	// The forward passes that follow test against the scene depth and the cleared stencil
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFBO);
+}
+
+// Prints the G-buffer size and format (nothing when the path was never used)
+void DeferredRenderer::PrintStats() const
+{
+	if (lightingShaders.Count() == 0)
+		return;
+	std::cout << "Deferred shading: " << width << "x" << height << " G-buffer, " << BytesPerPixel
+		<< " bytes per pixel (albedo RGBA8, octahedral normal RG16, depth24 stencil8), "
+		<< lightingShaders.Count() << " lighting variants" << std::endl;
+}
+
+// Deletes the G-buffer, the lighting variants and the VAO
+void DeferredRenderer::Delete()
+{
+	for (GLuint* texture : { &albedoTexture, &normalTexture, &depthTexture })
+	{
+		glState.ForgetTexture(*texture);
+		glDeleteTextures(1, texture);
+	}
+	glState.ForgetFramebuffer(fbo);
+	glDeleteFramebuffers(1, &fbo);
+	lightingShaders.Delete();
+	emptyVAO.Delete();
+}
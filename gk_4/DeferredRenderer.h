@@ -0,0 +1,52 @@
+#pragma once
+#include<glad/glad.h>
+#include<iostream>
+
+#include"ShaderVariants.h"
+#include"VAO.h"
+
+// Deferred shading path. The opaque pass renders the GEOMETRY_STAGE variants of the scene
+// shader into a compact G-buffer (12 bytes per pixel):
+//   albedo  RGBA8   texture color
+//   normal  RG16    octahedral encoding of the world space normal
+//   depth   DEPTH24_STENCIL8, the world position is rebuilt from it and the FrameData matrices
+// Light then runs the LIGHTING_STAGE variant of the same shader (same light types, light
+// list and fog) once per covered pixel in a full-screen pass, so overdrawn fragments are
+// never lit. Depth and stencil are copied to the target afterwards so forward passes
+// (mirror, blended objects) can follow.
+class DeferredRenderer
+{
+public:
+	// Creates the G-buffer; lighting variants are built from deferred.vert and default.frag
+	DeferredRenderer(int width, int height, ProgramCache* cache = nullptr);
+
+	// Binds the G-buffer and clears it
+	void BeginGeometry();
+	// Shades the G-buffer into the target framebuffer with the lighting variant matching the
+	// scene features, then copies depth and stencil there and leaves it bound
+	void Light(const ShaderFeatures& sceneFeatures, GLuint targetFBO);
+
+	// Bytes stored per pixel
+	static const int BytesPerPixel = 12;
+	// Prints the G-buffer size and format (nothing when the path was never used)
+	void PrintStats() const;
+
+	// Deletes the G-buffer, the lighting variants and the VAO
+	void Delete();
+
+private:
+	int width;
+	int height;
+	GLuint fbo = 0;
+	GLuint albedoTexture = 0;
+	GLuint normalTexture = 0;
+	GLuint depthTexture = 0;
+	ShaderVariants lightingShaders;
+	// Variant whose sampler uniforms were last set
+	Shader* preparedShader = nullptr;
+	// Empty, the full-screen triangle is generated from gl_VertexID
+	VAO emptyVAO;
+
+	// Creates a texture of the given format and attaches it to the G-buffer
+	GLuint attachTexture(GLenum attachment, GLint internalFormat, GLenum format, GLenum type);
+};
@@ -0,0 +1,123 @@
+#include"DepthPrepass.h"
+#include<algorithm>
+
+DepthPrepass::DepthPrepass(PrepassMode mode)
+	: mode(mode)
+{
+	glGenQueries(1, &depthQuery);
+	glGenQueries(1, &shadingQuery);
+}
+
+// Collects finished measurements and returns whether this frame uses the pre-pass
+bool DepthPrepass::BeginFrame()
+{
+	frames++;
+	framesSinceMeasurement++;
+	if (pending)
+	{
+		GLuint available = 0;
+		glGetQueryObjectuiv(shadingQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint shadedSamples = 0, visibleSamples = 0;
+			glGetQueryObjectuiv(depthQuery, GL_QUERY_RESULT, &shadedSamples);
+			glGetQueryObjectuiv(shadingQuery, GL_QUERY_RESULT, &visibleSamples);
+			overdraw = visibleSamples ? (float)shadedSamples / visibleSamples : 1.0f;
+			autoEnabled = overdraw > AutoThreshold;
+			pending = false;
+			measurements++;
+		}
+	}
+
+	measuring = false;
+	if (mode == PREPASS_ON)
+		measuring = !pending;
+	else if (mode == PREPASS_AUTO)
+		measuring = !pending && framesSinceMeasurement >= MeasureInterval;
+	active = mode == PREPASS_ON || (mode == PREPASS_AUTO && (autoEnabled || measuring));
+	if (active)
+		prepassFrames++;
+	return active;
+}
+
+// Masks color writes (and starts the depth pass query of a measured frame)
+void DepthPrepass::BeginDepth()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	if (measuring)
+		glBeginQuery(GL_SAMPLES_PASSED, depthQuery);
+}
+
+// Restores color writes and switches to GL_EQUAL without depth writes for shading
+void DepthPrepass::EndDepth()
+{
+	if (measuring)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		glBeginQuery(GL_SAMPLES_PASSED, shadingQuery);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+}
+
+// Restores GL_LESS and depth writes after the shading pass
+void DepthPrepass::EndShading()
+{
+	if (measuring)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		pending = true;
+		framesSinceMeasurement = 0;
+	}
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+// Debug overdraw counter: every fragment passing the depth test increments the stencil
+// buffer of its pixel until EndCounting reads it back and clears it
+void DepthPrepass::BeginCounting()
+{
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+void DepthPrepass::EndCounting(int width, int height)
+{
+	glDisable(GL_STENCIL_TEST);
+	stencil.resize((size_t)width * height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, stencil.data());
+	size_t fragments = 0, pixels = 0;
+	for (GLubyte layers : stencil)
+	{
+		fragments += layers;
+		pixels += layers > 0 ? 1 : 0;
+		maxLayers = std::max(maxLayers, (int)layers);
+	}
+	countedFragments += fragments;
+	countedPixels += pixels;
+	countedFrames++;
+	// The mirror pass expects a clear stencil buffer
+	glClear(GL_STENCIL_BUFFER_BIT);
+}
+
+// Prints how often the pre-pass ran and the measured and counted overdraw
+void DepthPrepass::PrintStats() const
+{
+	if (mode != PREPASS_OFF)
+		std::cout << "Depth pre-pass: " << prepassFrames << " of " << frames << " frames, overdraw "
+			<< overdraw << " at the last of " << measurements << " measurements" << std::endl;
+	if (countedFrames > 0)
+		std::cout << "Overdraw counter: " << (countedPixels > 0.0 ? countedFragments / countedPixels : 0.0)
+			<< " shaded fragments per covered pixel, at most " << maxLayers << " in one pixel ("
+			<< countedFragments / countedFrames << " fragments per frame)" << std::endl;
+}
+
+// Deletes the queries
+void DepthPrepass::Delete()
+{
+	glDeleteQueries(1, &depthQuery);
+	glDeleteQueries(1, &shadingQuery);
+}
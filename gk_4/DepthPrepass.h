@@ -0,0 +1,75 @@
+#pragma once
+#include<glad/glad.h>
+#include<vector>
+#include<iostream>
+
+// When the opaque objects get a depth-only pass before they are shaded
+enum PrepassMode { PREPASS_OFF, PREPASS_ON, PREPASS_AUTO };
+
+// Depth pre-pass for the opaque objects: they are first drawn with the depth-only scene
+// variants and color writes masked, then shaded with GL_EQUAL and depth writes off, so the
+// lighting shader runs once per visible pixel whatever the draw order.
+// Frames with the pre-pass also measure overdraw with two GL_SAMPLES_PASSED queries: samples
+// passing the depth-only pass are the fragments a plain pass would shade, samples passing the
+// GL_EQUAL pass are the visible pixels. PREPASS_AUTO repeats that measurement every
+// MeasureInterval frames and keeps the pre-pass only while the ratio exceeds AutoThreshold.
+// Results are read once available, so the CPU never waits.
+// The overdraw counter (a debug mode) instead counts the shaded fragments of every pixel in
+// the stencil buffer and reads it back, which stalls but needs no pre-pass.
+class DepthPrepass
+{
+public:
+	// Overdraw above which PREPASS_AUTO enables the pre-pass
+	static constexpr float AutoThreshold = 1.5f;
+	// Frames between two measurements of PREPASS_AUTO
+	static const int MeasureInterval = 30;
+
+	DepthPrepass(PrepassMode mode);
+
+	// Collects finished measurements and returns whether this frame uses the pre-pass
+	bool BeginFrame();
+	// Masks color writes (and starts the depth pass query of a measured frame)
+	void BeginDepth();
+	// Restores color writes and switches to GL_EQUAL without depth writes for shading
+	void EndDepth();
+	// Restores GL_LESS and depth writes after the shading pass
+	void EndShading();
+
+	// Debug overdraw counter: every fragment passing the depth test increments the stencil
+	// buffer of its pixel until EndCounting reads it back and clears it
+	void BeginCounting();
+	void EndCounting(int width, int height);
+
+	// Last measured overdraw (fragments shaded per visible pixel without the pre-pass), 0 before the first
+	float Overdraw() const { return overdraw; }
+	// Prints how often the pre-pass ran and the measured and counted overdraw
+	void PrintStats() const;
+
+	// Deletes the queries
+	void Delete();
+
+private:
+	PrepassMode mode;
+	// Pre-pass state chosen by the last PREPASS_AUTO measurement
+	bool autoEnabled = false;
+	// This frame runs the pre-pass, and measures it
+	bool active = false;
+	bool measuring = false;
+	// Queries of the measurement still waiting for results
+	bool pending = false;
+	GLuint depthQuery = 0;
+	GLuint shadingQuery = 0;
+	int framesSinceMeasurement = MeasureInterval;
+	float overdraw = 0.0f;
+
+	unsigned frames = 0;
+	unsigned prepassFrames = 0;
+	unsigned measurements = 0;
+
+	// Stencil readback of the overdraw counter
+	std::vector<GLubyte> stencil;
+	unsigned countedFrames = 0;
+	double countedFragments = 0.0;
+	double countedPixels = 0.0;
+	int maxLayers = 0;
+};
@@ -0,0 +1,94 @@
+#include"FrameProfiler.h"
+#include<algorithm>
+
+FrameProfiler::FrameProfiler()
+{
+	glGenQueries(QueryLatency, queries);
+}
+
+// Starts timing a frame
+void FrameProfiler::BeginFrame()
+{
+	// The query slot is reused, so the result from QueryLatency frames ago has to be read first
+	if (frameIndex >= QueryLatency)
+		CollectQuery(frameIndex - QueryLatency);
+
+	cpuStart = std::chrono::steady_clock::now();
+	glBeginQuery(GL_TIME_ELAPSED, queries[frameIndex % QueryLatency]);
+}
+
+// Stops timing the current frame
+void FrameProfiler::EndFrame()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	std::chrono::duration<double, std::milli> cpuTime = std::chrono::steady_clock::now() - cpuStart;
+	timings.push_back({ frameIndex, cpuTime.count(), 0.0 });
+	frameIndex++;
+}
+
+// Waits for all outstanding GPU queries and collects their results
+void FrameProfiler::Finish()
+{
+	for (int frame = std::max(0, frameIndex - QueryLatency); frame < frameIndex; frame++)
+		CollectQuery(frame);
+}
+
+// Reads the GPU result of the given frame into its timing entry
+void FrameProfiler::CollectQuery(int frame)
+{
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[frame % QueryLatency], GL_QUERY_RESULT, &elapsed);
+	timings[frame].gpuMs = elapsed / 1.0e6;
+}
+
+// Writes "frame,cpu_ms,gpu_ms" rows for every recorded frame
+bool FrameProfiler::WriteCSV(const std::string& path) const
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+	out << "frame,cpu_ms,gpu_ms\n";
+	for (const FrameTiming& t : timings)
+		out << t.frame << "," << t.cpuMs << "," << t.gpuMs << "\n";
+	return true;
+}
+
+static double Average(const std::vector<double>& values)
+{
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+	return values.empty() ? 0.0 : sum / values.size();
+}
+
+static double Percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+	return values[index];
+}
+
+// Prints average and percentile timings to stdout
+void FrameProfiler::PrintSummary(const char* label) const
+{
+	std::vector<double> cpu, gpu;
+	for (const FrameTiming& t : timings)
+	{
+		cpu.push_back(t.cpuMs);
+		gpu.push_back(t.gpuMs);
+	}
+	std::cout << label << ": " << timings.size() << " frames\n"
+		<< "  cpu ms  avg " << Average(cpu) << "  p50 " << Percentile(cpu, 0.5) << "  p95 " << Percentile(cpu, 0.95) << "\n"
+		<< "  gpu ms  avg " << Average(gpu) << "  p50 " << Percentile(gpu, 0.5) << "  p95 " << Percentile(gpu, 0.95) << std::endl;
+}
+
+// Deletes the query objects
+void FrameProfiler::Delete()
+{
+	glDeleteQueries(QueryLatency, queries);
+}
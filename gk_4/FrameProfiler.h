@@ -0,0 +1,49 @@
+#pragma once
+#include<glad/glad.h>
+#include<chrono>
+#include<vector>
+#include<string>
+#include<fstream>
+#include<iostream>
+
+// Timings of a single frame in milliseconds
+struct FrameTiming
+{
+	int frame;
+	double cpuMs;
+	double gpuMs;
+};
+
+// Measures CPU time and GPU time (GL_TIME_ELAPSED queries) of every frame.
+// GPU results are read a few frames late so the queries never stall the pipeline.
+class FrameProfiler
+{
+public:
+	// Number of frames a GPU query is kept in flight before its result is read
+	static const int QueryLatency = 4;
+
+	FrameProfiler();
+
+	// Starts timing a frame
+	void BeginFrame();
+	// Stops timing the current frame
+	void EndFrame();
+	// Waits for all outstanding GPU queries and collects their results
+	void Finish();
+
+	// Writes "frame,cpu_ms,gpu_ms" rows for every recorded frame
+	bool WriteCSV(const std::string& path) const;
+	// Prints average and percentile timings to stdout
+	void PrintSummary(const char* label) const;
+	// Deletes the query objects
+	void Delete();
+
+private:
+	GLuint queries[QueryLatency];
+	int frameIndex = 0;
+	std::chrono::steady_clock::time_point cpuStart;
+	std::vector<FrameTiming> timings;
+
+	// Reads the GPU result of the given frame into its timing entry
+	void CollectQuery(int frame);
+};
@@ -0,0 +1,138 @@
+#include"Frustum.h"
+
+#if defined(__AVX__)
+#include<immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include<emmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+// Extracts the planes from a projection * view matrix (Gribb/Hartmann)
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+{
+	// glm is column major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[LEFT_PLANE] = row[3] + row[0];
+	frustum.planes[RIGHT_PLANE] = row[3] - row[0];
+	frustum.planes[BOTTOM_PLANE] = row[3] + row[1];
+	frustum.planes[TOP_PLANE] = row[3] - row[1];
+	frustum.planes[NEAR_PLANE] = row[3] + row[2];
+	frustum.planes[FAR_PLANE] = row[3] - row[2];
+	for (glm::vec4& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+	return frustum;
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::Intersects(const AABB& box) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		// Corner of the box farthest along the plane normal
+		glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+// Forgets all objects of the previous frame (the storage is kept)
+void CullingBatch::Clear()
+{
+	count = 0;
+	boxes.clear();
+}
+
+// Adds an object with its local bounds and world transform, returns its index
+size_t CullingBatch::Add(const Bounds& bounds, const glm::mat4& model)
+{
+	size_t padded = (count + 8) & ~(size_t)7;
+	if (centerX.size() < padded)
+	{
+		for (std::vector<float>* lane : { &centerX, &centerY, &centerZ, &radius })
+			lane->resize(padded, 0.0f);
+	}
+
+	BoundingSphere sphere = bounds.sphere.Transformed(model);
+	centerX[count] = sphere.center.x;
+	centerY[count] = sphere.center.y;
+	centerZ[count] = sphere.center.z;
+	radius[count] = sphere.radius;
+	boxes.push_back(bounds.box.Transformed(model));
+	return count++;
+}
+
+// Tests all spheres against the frustum with SIMD, then refines the survivors with their boxes
+size_t CullingBatch::Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+	// Padded like the sphere lanes, so the vector loops may write past count
+	visible.resize(centerX.size());
+	size_t i = 0;
+#if defined(__AVX__)
+	for (; i < count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&centerX[i]);
+		__m256 y = _mm256_loadu_ps(&centerY[i]);
+		__m256 z = _mm256_loadu_ps(&centerZ[i]);
+		__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++)
+			visible[i + lane] = (mask >> lane) & 1;
+	}
+#elif defined(FRUSTUM_SSE)
+	for (; i < count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&centerX[i]);
+		__m128 y = _mm_loadu_ps(&centerY[i]);
+		__m128 z = _mm_loadu_ps(&centerZ[i]);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++)
+			visible[i + lane] = (mask >> lane) & 1;
+	}
+#endif
+	// Without SIMD support every sphere is tested on its own (the padded lanes cover any tail otherwise)
+	for (; i < count; i++)
+		visible[i] = frustum.Intersects(BoundingSphere{ glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i] });
+
+	// Spheres are loose for long thin objects, the box test rejects some more
+	size_t visibleCount = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (visible[i] && !frustum.Intersects(boxes[i]))
+			visible[i] = 0;
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+
+#include"Bounds.h"
+
+// View frustum as six normalized planes (xyz = inward normal, w = distance),
+// a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum
+{
+	// Plane order (NEAR/FAR are macros in windows.h)
+	enum { LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE };
+	glm::vec4 planes[6];
+
+	// Extracts the planes from a projection * view matrix (Gribb/Hartmann)
+	static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+	bool Intersects(const BoundingSphere& sphere) const;
+	bool Intersects(const AABB& box) const;
+};
+
+// Bounds of the objects drawn in one frame, kept as structure of arrays so the culling
+// pass can test 4 (SSE) or 8 (AVX) spheres per iteration. Objects are added with their
+// world transform each frame and can then be culled against any number of frusta.
+class CullingBatch
+{
+public:
+	// Forgets all objects of the previous frame (the storage is kept)
+	void Clear();
+	// Adds an object with its local bounds and world transform, returns its index
+	size_t Add(const Bounds& bounds, const glm::mat4& model);
+
+	// Tests all spheres against the frustum with SIMD, then refines the survivors with their boxes.
+	// visible[i] is set for every object i that may be visible, returns how many are.
+	size_t Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+	size_t Size() const { return count; }
+	// World space boxes of the added objects, by index
+	const std::vector<AABB>& Boxes() const { return boxes; }
+
+private:
+	size_t count = 0;
+	// Sphere centers and radii, padded to a multiple of 8 for the vector loops
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<AABB> boxes;
+};
@@ -0,0 +1,66 @@
+#include"GLExtensions.h"
+
+GLExtensions glExt;
+
+// Loads the optional entry points with the loader the context was created with
+void GLExtensions::Load(GLADloadproc loader)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	version = major * 10 + minor;
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	extensions.clear();
+	for (GLint i = 0; i < count; i++)
+		extensions.push_back((const char*)glGetStringi(GL_EXTENSIONS, i));
+
+	if (version >= 41 || Has("GL_ARB_get_program_binary"))
+	{
+		GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+		ProgramBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+		ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+		// Drivers may expose the functions while supporting no binary format at all
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		programBinary = GetProgramBinary && ProgramBinary && ProgramParameteri && formats > 0;
+	}
+
+	if (Has("GL_KHR_parallel_shader_compile"))
+		MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC)loader("glMaxShaderCompilerThreadsKHR");
+	else if (Has("GL_ARB_parallel_shader_compile"))
+		MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC)loader("glMaxShaderCompilerThreadsARB");
+	parallelShaderCompile = MaxShaderCompilerThreads != nullptr;
+
+	if (version >= 42 || Has("GL_ARB_base_instance"))
+		DrawElementsInstancedBaseVertexBaseInstance = (PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)loader("glDrawElementsInstancedBaseVertexBaseInstance");
+	baseInstance = DrawElementsInstancedBaseVertexBaseInstance != nullptr;
+
+	if (version >= 43)
+	{
+		MultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+		GetProgramResourceIndex = (PFNGLGETPROGRAMRESOURCEINDEXPROC)loader("glGetProgramResourceIndex");
+		ShaderStorageBlockBinding = (PFNGLSHADERSTORAGEBLOCKBINDINGPROC)loader("glShaderStorageBlockBinding");
+		shaderStorage = GetProgramResourceIndex && ShaderStorageBlockBinding;
+		multiDrawIndirect = shaderStorage && MultiDrawElementsIndirect;
+	}
+	if (version >= 44 || Has("GL_ARB_buffer_storage"))
+		BufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+	bufferStorage = BufferStorage != nullptr;
+
+	// 0xFFFFFFFF lets the driver pick as many threads as it likes
+	if (parallelShaderCompile)
+		MaxShaderCompilerThreads(0xFFFFFFFF);
+}
+
+// Checks whether the driver advertises the extension
+bool GLExtensions::Has(const char* extension) const
+{
+	for (const std::string& name : extensions)
+	{
+		if (name == extension)
+			return true;
+	}
+	return false;
+}
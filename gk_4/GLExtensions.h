@@ -0,0 +1,93 @@
+#pragma once
+#include<glad/glad.h>
+#include<string>
+#include<vector>
+
+// glad was generated for the OpenGL 3.3 core profile only. Entry points from newer
+// versions or extensions are loaded here at runtime and stay null when the driver
+// lacks them, so every feature built on them must check its flag and fall back.
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BLOCK 0x92E6
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef GLuint (APIENTRYP PFNGLGETPROGRAMRESOURCEINDEXPROC)(GLuint program, GLenum programInterface, const GLchar* name);
+typedef void (APIENTRYP PFNGLSHADERSTORAGEBLOCKBINDINGPROC)(GLuint program, GLuint storageBlockIndex, GLuint storageBlockBinding);
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLint basevertex, GLuint baseinstance);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+class GLExtensions
+{
+public:
+	// GL 4.1 / GL_ARB_get_program_binary with at least one binary format
+	bool programBinary = false;
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+	// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile: GL_COMPLETION_STATUS_KHR
+	// can be polled without blocking and the driver compiles on its own threads
+	bool parallelShaderCompile = false;
+	PFNGLMAXSHADERCOMPILERTHREADSPROC MaxShaderCompilerThreads = nullptr;
+
+	// GL 4.2 / GL_ARB_base_instance: instanced draws that start reading the per-instance
+	// attributes at baseInstance, so one instance buffer can feed several draws
+	bool baseInstance = false;
+	PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC DrawElementsInstancedBaseVertexBaseInstance = nullptr;
+
+	// GL 4.3: shader storage buffers (GLSL 4.30 buffer blocks), used by the multi-draw path
+	// and clustered lighting
+	bool shaderStorage = false;
+	// GL 4.3: glMultiDrawElementsIndirect with baseInstance (implies shaderStorage)
+	bool multiDrawIndirect = false;
+	PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+	PFNGLGETPROGRAMRESOURCEINDEXPROC GetProgramResourceIndex = nullptr;
+	PFNGLSHADERSTORAGEBLOCKBINDINGPROC ShaderStorageBlockBinding = nullptr;
+
+	// GL 4.4 / GL_ARB_buffer_storage: immutable buffers that can stay mapped while the GPU
+	// reads them (GL_MAP_PERSISTENT_BIT), used by RingBuffer
+	bool bufferStorage = false;
+	PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+	// Context version, e.g. 33 or 46
+	int version = 0;
+
+	// Loads the optional entry points with the loader the context was created with
+	void Load(GLADloadproc loader);
+	// Checks whether the driver advertises the extension
+	bool Has(const char* extension) const;
+
+private:
+	std::vector<std::string> extensions;
+};
+
+// Optional entry points of the current context
+extern GLExtensions glExt;
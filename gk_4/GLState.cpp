@@ -0,0 +1,177 @@
+#include"GLState.h"
+
+GLStateCache glState;
+
+// Updates the cached value and counters, returns true when the GL call has to be made
+bool GLStateCache::change(GLuint& cached, GLuint value)
+{
+	if (cached == value)
+	{
+		frame.avoided++;
+		return false;
+	}
+	cached = value;
+	frame.issued++;
+	return true;
+}
+
+// glUseProgram
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (change(this->program, program))
+		glUseProgram(program);
+}
+
+// glBindVertexArray
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (change(vertexArray, vao))
+	{
+		glBindVertexArray(vao);
+		elementBuffer = Unknown;
+	}
+}
+
+// glBindBuffer for GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* cached = nullptr;
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: cached = &arrayBuffer; break;
+	case GL_ELEMENT_ARRAY_BUFFER: cached = &elementBuffer; break;
+	case GL_UNIFORM_BUFFER: cached = &uniformBuffer; break;
+	}
+	if (!cached || change(*cached, buffer))
+		glBindBuffer(target, buffer);
+}
+
+// glBindBufferBase on a GL_UNIFORM_BUFFER binding point
+void GLStateCache::BindUniformBufferBase(GLuint binding, GLuint buffer)
+{
+	BindUniformBufferRange(binding, buffer, 0, 0);
+}
+
+// glBindBufferRange on a GL_UNIFORM_BUFFER binding point, size 0 binds the whole buffer
+void GLStateCache::BindUniformBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (binding < MaxUniformBindings)
+	{
+		UniformBinding& cached = uniformBindings[binding];
+		if (cached.buffer == buffer && cached.offset == offset && cached.size == size)
+		{
+			frame.avoided++;
+			return;
+		}
+		cached = { buffer, offset, size };
+	}
+	frame.issued++;
+	if (size == 0)
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	else
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+	// Indexed binds also replace the generic GL_UNIFORM_BUFFER binding
+	uniformBuffer = buffer;
+}
+
+// glActiveTexture
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	if (change(activeUnit, unit - GL_TEXTURE0))
+		glActiveTexture(unit);
+}
+
+// glBindTexture on the active unit
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	if (activeUnit >= MaxTextureUnits)
+	{
+		frame.issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+	// Units hold one texture per target; only the last used target is tracked
+	if (textureTargets[activeUnit] != target)
+	{
+		textureTargets[activeUnit] = target;
+		textures[activeUnit] = Unknown;
+	}
+	if (change(textures[activeUnit], texture))
+		glBindTexture(target, texture);
+}
+
+// glBindFramebuffer(GL_FRAMEBUFFER, ...)
+void GLStateCache::BindFramebuffer(GLuint framebuffer)
+{
+	if (change(this->framebuffer, framebuffer))
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+// Drops cached bindings of deleted objects (GL unbinds them on delete)
+void GLStateCache::ForgetBuffer(GLuint buffer)
+{
+	for (GLuint* cached : { &arrayBuffer, &elementBuffer, &uniformBuffer })
+	{
+		if (*cached == buffer)
+			*cached = 0;
+	}
+	for (UniformBinding& binding : uniformBindings)
+	{
+		if (binding.buffer == buffer)
+			binding = UniformBinding();
+	}
+}
+
+void GLStateCache::ForgetVertexArray(GLuint vao)
+{
+	if (vertexArray == vao)
+	{
+		vertexArray = 0;
+		elementBuffer = Unknown;
+	}
+}
+
+void GLStateCache::ForgetTexture(GLuint texture)
+{
+	for (GLuint& cached : textures)
+	{
+		if (cached == texture)
+			cached = 0;
+	}
+}
+
+void GLStateCache::ForgetFramebuffer(GLuint framebuffer)
+{
+	if (this->framebuffer == framebuffer)
+		this->framebuffer = 0;
+}
+
+// Forgets everything, the next bind of every kind goes to the driver
+void GLStateCache::Invalidate()
+{
+	program = vertexArray = arrayBuffer = elementBuffer = uniformBuffer = framebuffer = activeUnit = Unknown;
+	for (int i = 0; i < MaxTextureUnits; i++)
+		textures[i] = Unknown;
+	for (UniformBinding& binding : uniformBindings)
+		binding.buffer = Unknown;
+}
+
+// Adds the frame counters to the totals and starts a new frame
+void GLStateCache::EndFrame()
+{
+	totalIssued += frame.issued;
+	totalAvoided += frame.avoided;
+	frames++;
+	frame = Counters();
+}
+
+// Prints average issued/avoided calls per frame
+void GLStateCache::PrintSummary() const
+{
+	if (frames == 0)
+		return;
+	double issued = (double)totalIssued / frames;
+	double avoided = (double)totalAvoided / frames;
+	std::cout << "GL state cache: " << issued << " binds issued, " << avoided << " redundant binds skipped per frame ("
+		<< 100.0 * avoided / (issued + avoided) << "%)" << std::endl;
+}
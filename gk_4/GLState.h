@@ -0,0 +1,88 @@
+#pragma once
+#include<glad/glad.h>
+#include<iostream>
+
+// Shadow copy of the bindings the renderer changes most often. Every bind goes through here
+// and is only forwarded to the driver when it actually changes something; skipped calls are
+// counted so the savings are visible.
+// Code that binds with raw gl* calls must call Invalidate() afterwards.
+class GLStateCache
+{
+public:
+	// Texture units and uniform buffer binding points that are tracked
+	static const int MaxTextureUnits = 16;
+	static const int MaxUniformBindings = 16;
+
+	// Call counters of the current frame
+	struct Counters
+	{
+		unsigned issued = 0;
+		unsigned avoided = 0;
+	};
+
+	// glUseProgram
+	void UseProgram(GLuint program);
+	// glBindVertexArray
+	void BindVertexArray(GLuint vao);
+	// glBindBuffer for GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER,
+	// other targets are passed through
+	void BindBuffer(GLenum target, GLuint buffer);
+	// glBindBufferBase / glBindBufferRange on GL_UNIFORM_BUFFER binding points
+	void BindUniformBufferBase(GLuint binding, GLuint buffer);
+	void BindUniformBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	// glActiveTexture
+	void ActiveTexture(GLenum unit);
+	// glBindTexture on the active unit
+	void BindTexture(GLenum target, GLuint texture);
+	// glBindFramebuffer(GL_FRAMEBUFFER, ...)
+	void BindFramebuffer(GLuint framebuffer);
+
+	// Drops cached bindings of deleted objects (GL unbinds them on delete)
+	void ForgetBuffer(GLuint buffer);
+	void ForgetVertexArray(GLuint vao);
+	void ForgetTexture(GLuint texture);
+	void ForgetFramebuffer(GLuint framebuffer);
+	// Forgets everything, the next bind of every kind goes to the driver
+	void Invalidate();
+
+	// Adds the frame counters to the totals and starts a new frame
+	void EndFrame();
+	const Counters& FrameCounters() const { return frame; }
+	// Prints average issued/avoided calls per frame
+	void PrintSummary() const;
+
+private:
+	// Value that never matches a real object name
+	static const GLuint Unknown = 0xFFFFFFFF;
+
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint arrayBuffer = 0;
+	// Part of the VAO state, so unknown after every VAO change
+	GLuint elementBuffer = 0;
+	GLuint uniformBuffer = 0;
+	GLuint framebuffer = 0;
+	GLuint activeUnit = 0;
+	GLuint textures[MaxTextureUnits] = {};
+	GLenum textureTargets[MaxTextureUnits] = {};
+
+	// Buffer, offset and size bound to each uniform block binding point (size 0 = whole buffer)
+	struct UniformBinding
+	{
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+	UniformBinding uniformBindings[MaxUniformBindings];
+
+	Counters frame;
+	unsigned long long totalIssued = 0;
+	unsigned long long totalAvoided = 0;
+	unsigned frames = 0;
+
+	// Updates the cached value and counters, returns true when the GL call has to be made
+	bool change(GLuint& cached, GLuint value);
+};
+
+// Binding state of the current context
+extern GLStateCache glState;
@@ -0,0 +1,306 @@
+#include"GeometryArena.h"
+#include<algorithm>
+#include<cstring>
+
+// Makes the whole range one free block
+void RangeAllocator::Reset(GLuint capacity)
+{
+	this->capacity = capacity;
+	used = 0;
+	freeBlocks.clear();
+	if (capacity > 0)
+		freeBlocks.push_back({ 0, capacity });
+}
+
+// Takes size elements from the first free block that fits, returns the offset or Invalid
+GLuint RangeAllocator::Allocate(GLuint size)
+{
+	for (size_t i = 0; i < freeBlocks.size(); i++)
+	{
+		Block& block = freeBlocks[i];
+		if (block.size < size)
+			continue;
+		GLuint offset = block.offset;
+		block.offset += size;
+		block.size -= size;
+		if (block.size == 0)
+			freeBlocks.erase(freeBlocks.begin() + i);
+		used += size;
+		return offset;
+	}
+	return Invalid;
+}
+
+// Returns a range taken by Allocate
+void RangeAllocator::Free(GLuint offset, GLuint size)
+{
+	if (size == 0)
+		return;
+	used -= size;
+	// First free block after the range; merge with it and with the block before
+	auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset,
+		[](const Block& block, GLuint offset) { return block.offset < offset; });
+	if (next != freeBlocks.begin())
+	{
+		Block& previous = *(next - 1);
+		if (previous.offset + previous.size == offset)
+		{
+			previous.size += size;
+			if (next != freeBlocks.end() && previous.offset + previous.size == next->offset)
+			{
+				previous.size += next->size;
+				freeBlocks.erase(next);
+			}
+			return;
+		}
+	}
+	if (next != freeBlocks.end() && offset + size == next->offset)
+	{
+		next->offset = offset;
+		next->size += size;
+		return;
+	}
+	freeBlocks.insert(next, { offset, size });
+}
+
+GLuint RangeAllocator::LargestFreeBlock() const
+{
+	GLuint largest = 0;
+	for (const Block& block : freeBlocks)
+		largest = std::max(largest, block.size);
+	return largest;
+}
+
+// 1 - largest free block / all free space: 0 while the free space is in one piece
+float RangeAllocator::Fragmentation() const
+{
+	GLuint freeSpace = capacity - used;
+	return freeSpace ? 1.0f - (float)LargestFreeBlock() / freeSpace : 0.0f;
+}
+
+// Constructor that allocates both buffers with room for the given number of elements
+GeometryArena::GeometryArena(GLuint vertexCapacity, GLuint indexCapacity, VertexFormat format, bool splitStreams)
+	: format(format), layout(FormatLayout(format)), splitStreams(splitStreams), vertexSize(VertexSize(format))
+{
+	reallocate(std::max(vertexCapacity, 1u), std::max(indexCapacity, 1u));
+}
+
+// Copies a mesh of 11-float vertices into the buffers (converting them to the arena's
+// format); without indices the vertices are drawn in order. lods are the ranges of the
+// detail levels in the indices, without them the whole list is level 0. Returns the mesh id.
+uint32_t GeometryArena::Add(const GLfloat* vertices, size_t floatCount, const GLuint* indices, size_t indexCount, const std::vector<MeshLod>& lods)
+{
+	GLuint vertexCount = (GLuint)(floatCount / FloatsPerVertex);
+	std::vector<GLuint> sequential;
+	if (!indices)
+	{
+		sequential.resize(vertexCount);
+		for (GLuint i = 0; i < vertexCount; i++)
+			sequential[i] = i;
+		indices = sequential.data();
+		indexCount = vertexCount;
+	}
+
+	GLuint baseVertex = vertexSpace.Allocate(vertexCount);
+	GLuint firstIndex = indexSpace.Allocate((GLuint)indexCount);
+	if (baseVertex == RangeAllocator::Invalid || firstIndex == RangeAllocator::Invalid)
+	{
+		// Give back whatever did fit, grow for both ranges and take them again
+		if (baseVertex != RangeAllocator::Invalid)
+			vertexSpace.Free(baseVertex, vertexCount);
+		if (firstIndex != RangeAllocator::Invalid)
+			indexSpace.Free(firstIndex, (GLuint)indexCount);
+		makeRoom(vertexCount, (GLuint)indexCount);
+		baseVertex = vertexSpace.Allocate(vertexCount);
+		firstIndex = indexSpace.Allocate((GLuint)indexCount);
+	}
+
+	glm::mat4 decode(1.0f);
+	const void* vertexData = vertices;
+	if (format == VERTEX_PACKED)
+	{
+		packed.resize(vertexCount);
+		VertexQuantization meshQuantization = PackVertices(vertices, vertexCount, packed.data());
+		quantization.Accumulate(meshQuantization);
+		decode = meshQuantization.Decode();
+		vertexData = packed.data();
+	}
+	writeVertices(baseVertex, vertexCount, vertexData);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(GLuint), (GLsizeiptr)indexCount * sizeof(GLuint), indices);
+
+	Slot slot = { { (GLint)baseVertex, vertexCount, firstIndex, (GLuint)indexCount }, decode, lods };
+	if (slot.lods.empty())
+		slot.lods.push_back(MeshLod{ 0, (GLuint)indexCount, 0.0f });
+	meshes.push_back(slot);
+	return (uint32_t)meshes.size() - 1;
+}
+
+// Uploads vertexCount interleaved vertices in the arena's format to baseVertex, one
+// attribute at a time with split streams
+void GeometryArena::writeVertices(GLuint baseVertex, GLuint vertexCount, const void* vertices)
+{
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+	if (!splitStreams)
+	{
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)baseVertex * vertexSize, (GLsizeiptr)vertexCount * vertexSize, vertices);
+		return;
+	}
+	const uint8_t* source = (const uint8_t*)vertices;
+	GLintptr capacity = vertexSpace.Capacity();
+	for (size_t i = 0; i < layout.count; i++)
+	{
+		const VertexAttribute& attribute = layout.attributes[i];
+		stream.resize((size_t)vertexCount * attribute.size);
+		for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+			std::memcpy(&stream[(size_t)vertex * attribute.size], source + (size_t)vertex * vertexSize + attribute.offset, attribute.size);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, capacity * attribute.offset + (GLintptr)baseVertex * attribute.size, (GLsizeiptr)stream.size(), stream.data());
+	}
+}
+
+// Grows the buffers until the given number of elements fits behind the meshes
+void GeometryArena::makeRoom(GLuint vertexCount, GLuint indexCount)
+{
+	// Doubling keeps the number of copies logarithmic in the final size
+	GLuint vertexCapacity = vertexSpace.Capacity();
+	while (vertexCapacity - vertexSpace.Used() < vertexCount)
+		vertexCapacity *= 2;
+	GLuint indexCapacity = indexSpace.Capacity();
+	while (indexCapacity - indexSpace.Used() < indexCount)
+		indexCapacity *= 2;
+	reallocate(vertexCapacity, indexCapacity);
+	grows++;
+}
+
+// Replaces the buffers with new ones of the given capacities and copies every mesh to
+// them, packed from offset 0
+void GeometryArena::reallocate(GLuint vertexCapacity, GLuint indexCapacity)
+{
+	GLuint newBuffers[2];
+	glGenBuffers(2, newBuffers);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, newBuffers[0]);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * vertexSize, nullptr, GL_STATIC_DRAW);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, newBuffers[1]);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+	// A fresh first-fit list hands out consecutive ranges
+	GLintptr oldVertexCapacity = vertexSpace.Capacity();
+	vertexSpace.Reset(vertexCapacity);
+	indexSpace.Reset(indexCapacity);
+
+	for (Slot& slot : meshes)
+	{
+		MeshRange moved = slot.range;
+		moved.baseVertex = (GLint)vertexSpace.Allocate(moved.vertexCount);
+		moved.firstIndex = indexSpace.Allocate(moved.indexCount);
+		glState.BindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, newBuffers[0]);
+		if (splitStreams)
+		{
+			// Every stream starts at capacity * attribute offset, in the old and the new buffer
+			for (size_t i = 0; i < layout.count; i++)
+			{
+				const VertexAttribute& attribute = layout.attributes[i];
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, oldVertexCapacity * attribute.offset + (GLintptr)slot.range.baseVertex * attribute.size,
+					(GLintptr)vertexCapacity * attribute.offset + (GLintptr)moved.baseVertex * attribute.size, (GLsizeiptr)moved.vertexCount * attribute.size);
+			}
+		}
+		else
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)slot.range.baseVertex * vertexSize, (GLintptr)moved.baseVertex * vertexSize, (GLsizeiptr)moved.vertexCount * vertexSize);
+		glState.BindBuffer(GL_COPY_READ_BUFFER, indexBuffer);
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, newBuffers[1]);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, slot.range.firstIndex * sizeof(GLuint), moved.firstIndex * sizeof(GLuint), moved.indexCount * sizeof(GLuint));
+		slot.range = moved;
+	}
+
+	for (GLuint* buffer : { &vertexBuffer, &indexBuffer })
+	{
+		if (*buffer)
+		{
+			glState.ForgetBuffer(*buffer);
+			glDeleteBuffers(1, buffer);
+		}
+	}
+	vertexBuffer = newBuffers[0];
+	indexBuffer = newBuffers[1];
+	linkBuffers();
+}
+
+// Points the VAO's vertex attributes and element buffer at the current buffers
+void GeometryArena::linkBuffers()
+{
+	vao.Bind();
+	glState.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	if (splitStreams)
+		layout.LinkSplit(vertexSpace.Capacity());
+	else
+		layout.LinkInterleaved();
+	glState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	vao.Unbind();
+}
+
+// Binds the VAO
+void GeometryArena::Bind()
+{
+	vao.Bind();
+}
+
+// Range of one detail level of a mesh (level 0 is the full mesh)
+GeometryArena::MeshRange GeometryArena::Lod(uint32_t mesh, size_t level) const
+{
+	const Slot& slot = meshes[mesh];
+	const MeshLod& lod = slot.lods[level];
+	return { slot.range.baseVertex, slot.range.vertexCount, slot.range.firstIndex + lod.firstIndex, lod.indexCount };
+}
+
+// Draws a detail level of a mesh with glDrawElementsBaseVertex (the VAO must be bound)
+void GeometryArena::Draw(uint32_t mesh, size_t level) const
+{
+	MeshRange range = Lod(mesh, level);
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(GLuint)), range.baseVertex);
+}
+
+GeometryArena::Stats GeometryArena::GetStats() const
+{
+	Stats stats;
+	stats.meshes = meshes.size();
+	stats.verticesUsed = vertexSpace.Used();
+	stats.vertexCapacity = vertexSpace.Capacity();
+	stats.indicesUsed = indexSpace.Used();
+	stats.indexCapacity = indexSpace.Capacity();
+	stats.freeVertexBlocks = vertexSpace.FreeBlocks();
+	stats.freeIndexBlocks = indexSpace.FreeBlocks();
+	stats.vertexFragmentation = vertexSpace.Fragmentation();
+	stats.indexFragmentation = indexSpace.Fragmentation();
+	stats.grows = grows;
+	stats.vertexSize = vertexSize;
+	stats.splitStreams = splitStreams;
+	return stats;
+}
+
+// Prints occupancy and fragmentation, and the quantization error of packed vertices
+void GeometryArena::PrintStats() const
+{
+	Stats stats = GetStats();
+	std::cout << "Geometry arena: " << stats.meshes << " meshes, vertices " << stats.verticesUsed << "/" << stats.vertexCapacity
+		<< " (" << stats.freeVertexBlocks << " free blocks, " << stats.vertexFragmentation * 100.0f << "% fragmented), indices "
+		<< stats.indicesUsed << "/" << stats.indexCapacity << " (" << stats.freeIndexBlocks << " free blocks, "
+		<< stats.indexFragmentation * 100.0f << "% fragmented), " << stats.grows << " grows" << std::endl;
+	std::cout << "Vertex format: " << VertexFormatName(format) << (stats.splitStreams ? " in split streams" : " interleaved") << ", " << stats.vertexSize << " bytes per vertex ("
+		<< (size_t)stats.verticesUsed * stats.vertexSize / 1024.0 << " KiB of vertices)";
+	if (format == VERTEX_PACKED)
+		std::cout << ", max error position " << quantization.positionError << ", normal " << quantization.normalError
+			<< " degrees, texCoord " << quantization.texCoordError;
+	std::cout << std::endl;
+}
+
+// Deletes the buffers and the VAO
+void GeometryArena::Delete()
+{
+	for (GLuint* buffer : { &vertexBuffer, &indexBuffer })
+	{
+		glState.ForgetBuffer(*buffer);
+		glDeleteBuffers(1, buffer);
+	}
+	vao.Delete();
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include<glad/glad.h>
+#include<vector>
+#include<cstdint>
+#include<iostream>
+
+#include"VAO.h"
+#include"GLState.h"
+#include"VertexFormat.h"
+#include"MeshOptimizer.h"
+
+// First-fit free list over the element range [0, capacity). Free blocks are kept sorted by
+// offset and merged with their neighbours when a range is returned.
+class RangeAllocator
+{
+public:
+	// Offset returned when no free block is large enough
+	static const GLuint Invalid = 0xFFFFFFFF;
+
+	// Makes the whole range one free block
+	void Reset(GLuint capacity);
+	// Takes size elements from the first free block that fits, returns the offset or Invalid
+	GLuint Allocate(GLuint size);
+	// Returns a range taken by Allocate
+	void Free(GLuint offset, GLuint size);
+
+	GLuint Capacity() const { return capacity; }
+	GLuint Used() const { return used; }
+	size_t FreeBlocks() const { return freeBlocks.size(); }
+	GLuint LargestFreeBlock() const;
+	// 1 - largest free block / all free space: 0 while the free space is in one piece
+	float Fragmentation() const;
+
+private:
+	struct Block
+	{
+		GLuint offset;
+		GLuint size;
+	};
+
+	std::vector<Block> freeBlocks;
+	GLuint capacity = 0;
+	GLuint used = 0;
+};
+
+// Vertex and index storage shared by the static meshes: one vertex buffer and one index buffer
+// in the layout of a VertexFormat, sub-allocated with a free list each and drawn
+// through a single VAO. A mesh is a (baseVertex, firstIndex, indexCount) range; its indices
+// stay relative to its first vertex, so moving the vertices only changes baseVertex.
+// Full buffers grow (meshes are never freed, so the free space stays one block at the end).
+// A mesh's index range holds all of its detail levels (MeshSimplifier); draws pick one
+// through Lod.
+// With VERTEX_PACKED the meshes are converted to 16-byte vertices when they are added; their
+// positions are then relative to a per-mesh box, and draws have to multiply the model matrix
+// by Decode(mesh).
+// With split streams every attribute has its own tightly packed stream in the vertex buffer
+// (all positions, then all of the next attribute, ...) instead of interleaved vertices, so a
+// pass whose program only reads positions, like the depth pre-pass, only fetches those.
+class GeometryArena
+{
+public:
+	// Floats per vertex of the meshes passed to Add (position, color, texCoord, normal)
+	static const GLuint FloatsPerVertex = 11;
+
+	// Where a mesh lives in the shared buffers (indexCount covers every detail level)
+	struct MeshRange
+	{
+		GLint baseVertex;
+		GLuint vertexCount;
+		GLuint firstIndex;
+		GLuint indexCount;
+	};
+
+	// Occupancy and fragmentation of both buffers
+	struct Stats
+	{
+		size_t meshes;
+		GLuint verticesUsed, vertexCapacity;
+		GLuint indicesUsed, indexCapacity;
+		size_t freeVertexBlocks, freeIndexBlocks;
+		float vertexFragmentation, indexFragmentation;
+		unsigned grows;
+		GLsizei vertexSize;
+		bool splitStreams;
+	};
+
+	// VAO every arena mesh is drawn with
+	VAO vao;
+
+	// Constructor that allocates both buffers with room for the given number of elements,
+	// storing vertices in the given format, interleaved or as one stream per attribute
+	GeometryArena(GLuint vertexCapacity, GLuint indexCapacity, VertexFormat format = VERTEX_FLOAT, bool splitStreams = false);
+
+	// Copies a mesh of 11-float vertices into the buffers (converting them to the arena's
+	// format); without indices the vertices are drawn in order. lods are the ranges of the
+	// detail levels in the indices, without them the whole list is level 0. Returns the mesh id.
+	uint32_t Add(const GLfloat* vertices, size_t floatCount, const GLuint* indices, size_t indexCount, const std::vector<MeshLod>& lods = {});
+
+	// Current range of a mesh (changes when the buffers grow)
+	const MeshRange& Range(uint32_t mesh) const { return meshes[mesh].range; }
+	// Range of one detail level of a mesh (level 0 is the full mesh)
+	MeshRange Lod(uint32_t mesh, size_t level) const;
+	size_t LodCount(uint32_t mesh) const { return meshes[mesh].lods.size(); }
+	// Matrix to multiply the mesh's model matrix by (identity unless the vertices are packed)
+	const glm::mat4& Decode(uint32_t mesh) const { return meshes[mesh].decode; }
+	VertexFormat Format() const { return format; }
+	// Attributes the VAO feeds, for checking programs against
+	const VertexLayoutView& Layout() const { return layout; }
+
+	// Binds the VAO
+	void Bind();
+	// Draws a detail level of a mesh with glDrawElementsBaseVertex (the VAO must be bound)
+	void Draw(uint32_t mesh, size_t level = 0) const;
+
+	Stats GetStats() const;
+	// Prints occupancy and fragmentation, and the quantization error of packed vertices
+	void PrintStats() const;
+
+	// Deletes the buffers and the VAO
+	void Delete();
+
+private:
+	struct Slot
+	{
+		MeshRange range;
+		glm::mat4 decode;
+		// Relative to range.firstIndex
+		std::vector<MeshLod> lods;
+	};
+
+	std::vector<Slot> meshes;
+	VertexFormat format;
+	VertexLayoutView layout;
+	bool splitStreams;
+	// Bytes per vertex in the buffer
+	GLsizei vertexSize;
+	// Largest errors of all packed meshes
+	VertexQuantization quantization;
+	// Conversion buffers of Add
+	std::vector<PackedVertex> packed;
+	std::vector<uint8_t> stream;
+	RangeAllocator vertexSpace;
+	RangeAllocator indexSpace;
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+	unsigned grows = 0;
+
+	// Grows the buffers until the given number of elements fits behind the meshes
+	void makeRoom(GLuint vertexCount, GLuint indexCount);
+	// Replaces the buffers with new ones of the given capacities and copies every mesh to
+	// them, packed from offset 0
+	void reallocate(GLuint vertexCapacity, GLuint indexCapacity);
+	// Uploads vertexCount interleaved vertices in the arena's format to baseVertex, one
+	// attribute at a time with split streams
+	void writeVertices(GLuint baseVertex, GLuint vertexCount, const void* vertices);
+	// Points the VAO's vertex attributes and element buffer at the current buffers
+	void linkBuffers();
+};
@@ -0,0 +1,190 @@
+#include"Headless.h"
+#include"GLState.h"
+
+#ifndef _WIN32
+#include<EGL/egl.h>
+#include<EGL/eglext.h>
+#endif
+
+// Creates the context, loads GL functions and builds the offscreen framebuffer; on failure
+// releases whatever was created so far
+bool HeadlessContext::Create(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	if (!CreateContext())
+	{
+		Destroy();
+		return false;
+	}
+
+	if (!gladLoadGLLoader(Loader()))
+	{
+		std::cout << "Failed to load OpenGL functions for headless context" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	if (!CreateFramebuffer())
+	{
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+#ifdef _WIN32
+
+// Windows has no surfaceless context, so an invisible window provides one
+bool HeadlessContext::CreateContext()
+{
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	hiddenWindow = glfwCreateWindow(width, height, "gk_4 headless", NULL, NULL);
+	if (!hiddenWindow)
+	{
+		std::cout << "Failed to create hidden GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(hiddenWindow);
+	return true;
+}
+
+GLADloadproc HeadlessContext::Loader() const
+{
+	return (GLADloadproc)glfwGetProcAddress;
+}
+
+#else
+
+// Surfaceless EGL context, preferring the Mesa surfaceless platform when the driver exposes it
+bool HeadlessContext::CreateContext()
+{
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		std::cout << "Failed to initialize EGL display" << std::endl;
+		return false;
+	}
+	// Kept from here on so Destroy can release a partly created context
+	display = eglDisplay;
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "EGL display does not support desktop OpenGL" << std::endl;
+		return false;
+	}
+
+	// EGL_SURFACE_TYPE defaults to EGL_WINDOW_BIT, which surfaceless displays never offer
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+	{
+		std::cout << "No EGL config with desktop OpenGL support" << std::endl;
+		return false;
+	}
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (eglContext == EGL_NO_CONTEXT)
+	{
+		std::cout << "Failed to create EGL context" << std::endl;
+		return false;
+	}
+	context = eglContext;
+	// No surface at all: everything is drawn into our own framebuffer
+	if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		std::cout << "Failed to make surfaceless EGL context current" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+GLADloadproc HeadlessContext::Loader() const
+{
+	return (GLADloadproc)eglGetProcAddress;
+}
+
+#endif
+
+// Builds the color + depth/stencil framebuffer used as the render target
+bool HeadlessContext::CreateFramebuffer()
+{
+	glGenRenderbuffers(1, &colorRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	// The mirror pass relies on the stencil buffer, so it has to be here as well
+	glGenRenderbuffers(1, &depthRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &FBO);
+	glState.BindFramebuffer(FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Headless framebuffer is not complete!" << std::endl;
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+// Deletes the framebuffer and releases the context
+void HeadlessContext::Destroy()
+{
+	// GL names only exist once the framebuffer was started, with the functions loaded
+	if (FBO || colorRBO || depthRBO)
+	{
+		glState.ForgetFramebuffer(FBO);
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &colorRBO);
+		glDeleteRenderbuffers(1, &depthRBO);
+		FBO = 0;
+		colorRBO = 0;
+		depthRBO = 0;
+	}
+#ifdef _WIN32
+	if (hiddenWindow)
+	{
+		glfwDestroyWindow(hiddenWindow);
+		glfwTerminate();
+		hiddenWindow = nullptr;
+	}
+#else
+	if (display)
+	{
+		eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context)
+			eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+		eglTerminate((EGLDisplay)display);
+		display = nullptr;
+		context = nullptr;
+	}
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include<glad/glad.h>
+#include<GLFW/glfw3.h>
+#include<iostream>
+
+// Offscreen OpenGL context used for benchmarking on machines without a display.
+// On Linux this is a surfaceless EGL context (Mesa llvmpipe works), on Windows a hidden GLFW window.
+// Rendering goes into FBO, which replaces the default framebuffer.
+class HeadlessContext
+{
+public:
+	// Framebuffer the scene is rendered into instead of the default framebuffer
+	GLuint FBO = 0;
+	int width = 0;
+	int height = 0;
+
+	// Creates the context, loads GL functions and builds the offscreen framebuffer; on failure
+	// releases whatever was created so far
+	bool Create(int width, int height);
+	// Returns the function loader matching the created context
+	GLADloadproc Loader() const;
+	// Deletes the framebuffer and releases the context
+	void Destroy();
+
+private:
+	GLuint colorRBO = 0;
+	GLuint depthRBO = 0;
+
+#ifdef _WIN32
+	GLFWwindow* hiddenWindow = nullptr;
+#else
+	void* display = nullptr;
+	void* context = nullptr;
+#endif
+
+	// Creates the platform specific context and makes it current
+	bool CreateContext();
+	// Builds the color + depth/stencil framebuffer used as the render target
+	bool CreateFramebuffer();
+};
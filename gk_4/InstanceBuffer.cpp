@@ -0,0 +1,42 @@
+#include"InstanceBuffer.h"
+
+// Constructor that allocates room for the given number of transforms
+InstanceBuffer::InstanceBuffer(GLsizei capacity)
+	: capacity(capacity)
+{
+	glGenBuffers(1, &ID);
+	glState.BindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+}
+
+// Replaces all transforms with one upload, growing the buffer when needed
+void InstanceBuffer::Update(const glm::mat4* transforms, GLsizei count)
+{
+	this->count = count;
+	glState.BindBuffer(GL_ARRAY_BUFFER, ID);
+	if (count > capacity)
+		capacity = count;
+	// Re-specifying the whole store lets the driver hand out fresh memory instead of
+	// waiting for draws that still read last frame's transforms
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+}
+
+// Binds the buffer
+void InstanceBuffer::Bind()
+{
+	glState.BindBuffer(GL_ARRAY_BUFFER, ID);
+}
+
+// Unbinds the buffer
+void InstanceBuffer::Unbind()
+{
+	glState.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Deletes the buffer
+void InstanceBuffer::Delete()
+{
+	glState.ForgetBuffer(ID);
+	glDeleteBuffers(1, &ID);
+}
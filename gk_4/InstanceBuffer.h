@@ -0,0 +1,33 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"GLState.h"
+
+// Per-instance model matrices for instanced draws, read by the vertex shader as
+// four vec4 attributes with divisor 1 (see VAO::LinkInstanceTransforms)
+class InstanceBuffer
+{
+public:
+	// Reference ID of the buffer
+	GLuint ID;
+	// Number of transforms uploaded by the last Update
+	GLsizei count = 0;
+	// Number of transforms the buffer storage can hold
+	GLsizei capacity;
+
+	// Constructor that allocates room for the given number of transforms
+	InstanceBuffer(GLsizei capacity);
+
+	// Replaces all transforms with one upload, growing the buffer when needed
+	void Update(const glm::mat4* transforms, GLsizei count);
+	void Update(const std::vector<glm::mat4>& transforms) { Update(transforms.data(), (GLsizei)transforms.size()); }
+
+	// Binds the buffer
+	void Bind();
+	// Unbinds the buffer
+	void Unbind();
+	// Deletes the buffer
+	void Delete();
+};
@@ -6,6 +6,7 @@
 #include <glm/gtx/vector_angle.hpp>
 
 #include "Shader.h"
+#include "UniformBlocks.h"
 
 // Directional light: sunlight
 // Point: lightbulb
@@ -22,6 +23,7 @@ public:
     glm::vec3 direction; // used for spotlight and directional light
     float cutOff;       // for spotlight (inner cutoff, cosine)
     float outerCutOff;  // for spotlight (outer cutoff, cosine)
+    float radius = 0.0f; // range of a clustered light (ClusteredLighting), unused by the three scene lights
 
     LightSource() {}
     LightSource(LightType t, const glm::vec3& pos, const glm::vec3& col)
@@ -31,32 +33,28 @@ public:
         outerCutOff(glm::cos(glm::radians(17.5f)))
     { }
 
-    // Set uniforms into the shader 
-    void setUniforms(Shader& shader, const std::string& namePrefix) {
-        // Set common properties.
-        glUniform3f(glGetUniformLocation(shader.ID, (namePrefix + ".position").c_str()),
-            position.x, position.y, position.z);
-        glUniform3f(glGetUniformLocation(shader.ID, (namePrefix + ".color").c_str()),
-            color.x, color.y, color.z);
+    // Packs the light into a LightBlock, one 48-byte Light of the std140 LightData block:
+    // every vec3 shares a 16-byte slot with the scalar after it (cutoffs, type). The shader
+    // branches on type; fields a type does not use are zero.
+    LightBlock toBlock() const {
+        LightBlock block;
+        block.position = position;
+        block.color = color;
+        block.direction = glm::vec3(0.0f);
+        block.cutOff = 0.0f;
+        block.outerCutOff = 0.0f;
+        block.type = type;
 
-        // SpotLight specific uniforms.
         if (type == SPOT_LIGHT) {
-            glm::vec3 normDirection = glm::normalize(direction); // Ensure direction is normalized.
-            glUniform3f(glGetUniformLocation(shader.ID, (namePrefix + ".direction").c_str()),
-                normDirection.x, normDirection.y, normDirection.z);
-            // Send the already computed cosine values directly.
-            glUniform1f(glGetUniformLocation(shader.ID, (namePrefix + ".cutOff").c_str()),
-                cutOff);
-            glUniform1f(glGetUniformLocation(shader.ID, (namePrefix + ".outerCutOff").c_str()),
-                outerCutOff);
+            // Ensure direction is normalized.
+            block.direction = glm::normalize(direction);
+            block.cutOff = cutOff;
+            block.outerCutOff = outerCutOff;
         }
-
-        // Directional Light specific uniforms.
         if (type == DIRECTIONAL_LIGHT) {
-            glm::vec3 normDirection = glm::normalize(direction);
-            glUniform3f(glGetUniformLocation(shader.ID, (namePrefix + ".direction").c_str()),
-                normDirection.x, normDirection.y, normDirection.z);
+            block.direction = glm::normalize(direction);
         }
+        return block;
     }
 };
 
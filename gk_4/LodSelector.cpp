@@ -0,0 +1,71 @@
+#include"LodSelector.h"
+#include<algorithm>
+#include<cmath>
+
+// Starts a frame: the camera position and the pixels per unit at distance 1 of the
+// perspective projection for a viewport of the given height
+void LodSelector::Begin(const glm::vec3& cameraPosition, const glm::mat4& projection, int viewportHeight)
+{
+	this->cameraPosition = cameraPosition;
+	// projection[1][1] is cot(fovy / 2): a unit at distance 1 covers that much of the half height
+	pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight;
+	totalTriangles += triangles;
+	totalFullTriangles += fullTriangles;
+	if (triangles || fullTriangles)
+		frames++;
+	triangles = fullTriangles = 0;
+	std::fill(levelCounts.begin(), levelCounts.end(), 0);
+}
+
+// Level to draw the object with id (any index that stays the object's from frame to frame)
+size_t LodSelector::Select(size_t id, const std::vector<MeshLod>& lods, const Bounds& bounds, const glm::mat4& model)
+{
+	if (id >= levels.size())
+		levels.resize(id + 1, Unselected);
+	// New objects start from level 0 and go as coarse as their error allows right away
+	size_t level = levels[id] == Unselected ? 0 : std::min<size_t>(levels[id], lods.size() - 1);
+	if (!Enabled())
+		level = 0;
+	else
+	{
+		// Errors scale with the largest axis of the model matrix, like the bounding sphere
+		float scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+		BoundingSphere sphere = bounds.sphere.Transformed(model);
+		float distance = std::max(glm::length(sphere.center - cameraPosition) - sphere.radius, 1e-3f);
+		float pixelsPerError = scale * pixelsPerUnit / distance;
+
+		while (level > 0 && lods[level].error * pixelsPerError > pixelError)
+			level--;
+		while (level + 1 < lods.size() && lods[level + 1].error * pixelsPerError <= pixelError * Hysteresis)
+			level++;
+	}
+
+	if (levels[id] != Unselected && level != levels[id])
+		switches++;
+	levels[id] = (uint8_t)level;
+	if (level >= levelCounts.size())
+		levelCounts.resize(level + 1, 0);
+	levelCounts[level]++;
+	triangles += lods[level].indexCount / 3;
+	fullTriangles += lods[0].indexCount / 3;
+	return level;
+}
+
+// Prints the triangles drawn over the ones at full detail and the level changes per frame
+// (not counting the first level of an object)
+void LodSelector::PrintStats() const
+{
+	if (!Enabled())
+	{
+		std::cout << "Mesh LOD: off, " << triangles << " triangles (last frame)" << std::endl;
+		return;
+	}
+	size_t drawn = totalTriangles + triangles, full = totalFullTriangles + fullTriangles;
+	int counted = frames + (triangles || fullTriangles ? 1 : 0);
+	std::cout << "Mesh LOD (" << pixelError << " px): " << (counted ? drawn / counted : 0) << " of " << (counted ? full / counted : 0)
+		<< " triangles per frame (" << (full ? 100.0 * drawn / full : 100.0) << "%), "
+		<< (counted ? (double)switches / counted : 0.0) << " level changes per frame, objects per level (last frame):";
+	for (size_t level = 0; level < levelCounts.size(); level++)
+		std::cout << " " << levelCounts[level];
+	std::cout << std::endl;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+#include<iostream>
+
+#include"Bounds.h"
+#include"MeshOptimizer.h"
+
+// Picks a detail level per object and frame: the coarsest level whose error, projected to
+// the screen at the nearest point of the object's bounding sphere, stays under a pixel
+// threshold. The level of every object is kept between frames and only moves to a coarser
+// one once its projected error is below Hysteresis times the threshold, so an object
+// resting near a switching distance does not pop back and forth.
+class LodSelector
+{
+public:
+	// Fraction of the threshold a coarser level's error has to get under
+	static constexpr float Hysteresis = 0.75f;
+
+	// Threshold in pixels; 0 always selects level 0
+	explicit LodSelector(float pixelError) : pixelError(pixelError) {}
+
+	// Starts a frame: the camera position and the pixels per unit at distance 1 of the
+	// perspective projection for a viewport of the given height
+	void Begin(const glm::vec3& cameraPosition, const glm::mat4& projection, int viewportHeight);
+	// Level to draw the object with id (any index that stays the object's from frame to frame)
+	size_t Select(size_t id, const std::vector<MeshLod>& lods, const Bounds& bounds, const glm::mat4& model);
+
+	// Level the object got at its last Select, 0 before the first
+	size_t Level(size_t id) const { return id < levels.size() && levels[id] != Unselected ? levels[id] : 0; }
+	bool Enabled() const { return pixelError > 0.0f; }
+	// Triangles of the levels selected this frame, and of level 0 for the same objects
+	size_t Triangles() const { return triangles; }
+	size_t FullTriangles() const { return fullTriangles; }
+
+	// Prints the triangles drawn over the ones at full detail and the level changes per frame
+	// (not counting the first level of an object)
+	void PrintStats() const;
+
+private:
+	float pixelError;
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	float pixelsPerUnit = 0.0f;
+	// Level of every id at its last Select, Unselected before the first
+	static constexpr uint8_t Unselected = 0xFF;
+	std::vector<uint8_t> levels;
+	// Objects per level this frame
+	std::vector<size_t> levelCounts;
+
+	size_t triangles = 0, fullTriangles = 0;
+	int frames = 0;
+	size_t totalTriangles = 0, totalFullTriangles = 0;
+	size_t switches = 0;
+};
@@ -0,0 +1,226 @@
+#include"MeshBenchmark.h"
+#include"MeshGenerator.h"
+#include<glm/glm.hpp>
+#include<glm/gtc/constants.hpp>
+#include<chrono>
+#include<cmath>
+#include<algorithm>
+#include<functional>
+#include<iostream>
+
+using BenchClock = std::chrono::steady_clock;
+
+static double MillisecondsSince(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// The scene's original sphere generator: push_back per float, cosf/sinf per vertex
+static void ReferenceSphere(float radius, unsigned int sectorCount, unsigned int stackCount,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	float lengthInv = 1.0f / radius;
+	float sectorStep = 2 * glm::pi<float>() / sectorCount;
+	float stackStep = glm::pi<float>() / stackCount;
+	for (unsigned int i = 0; i <= stackCount; ++i)
+	{
+		float stackAngle = glm::pi<float>() / 2 - i * stackStep;
+		float xy = radius * cosf(stackAngle);
+		float z = radius * sinf(stackAngle);
+		for (unsigned int j = 0; j <= sectorCount; ++j)
+		{
+			float sectorAngle = j * sectorStep;
+			float x = xy * cosf(sectorAngle);
+			float y = xy * sinf(sectorAngle);
+			float s = (float)j / sectorCount;
+			float t = (float)i / stackCount;
+			vertices.push_back(x);
+			vertices.push_back(y);
+			vertices.push_back(z);
+			vertices.push_back(1.0f);
+			vertices.push_back(1.0f);
+			vertices.push_back(1.0f);
+			vertices.push_back(s);
+			vertices.push_back(t);
+			vertices.push_back(x * lengthInv);
+			vertices.push_back(y * lengthInv);
+			vertices.push_back(z * lengthInv);
+		}
+	}
+	unsigned int k1, k2;
+	for (unsigned int i = 0; i < stackCount; ++i)
+	{
+		k1 = i * (sectorCount + 1);
+		k2 = k1 + sectorCount + 1;
+		for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+		{
+			if (i != 0)
+			{
+				indices.push_back(k1);
+				indices.push_back(k2);
+				indices.push_back(k1 + 1);
+			}
+			if (i != (stackCount - 1))
+			{
+				indices.push_back(k1 + 1);
+				indices.push_back(k2);
+				indices.push_back(k2 + 1);
+			}
+		}
+	}
+}
+
+// The scene's original torus generator: push_back per float, cos/sin and normalize per vertex
+static void ReferenceTorus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	float ringFactor = 2.0f * glm::pi<float>() / nrings;
+	float sideFactor = 2.0f * glm::pi<float>() / nsides;
+	float offsetY = 0.5f;
+	for (unsigned int ring = 0; ring <= nrings; ++ring)
+	{
+		float u = ring * ringFactor;
+		float cosU = cos(u);
+		float sinU = sin(u);
+		for (unsigned int side = 0; side <= nsides; ++side)
+		{
+			float v = side * sideFactor;
+			float cosV = cos(v);
+			float sinV = sin(v);
+			float r = outerRadius + innerRadius * cosV;
+			float x = r * cosU;
+			float y = r * sinU + offsetY;
+			float z = innerRadius * sinV;
+			vertices.push_back(x);
+			vertices.push_back(y);
+			vertices.push_back(z);
+			vertices.push_back(0.3f);
+			vertices.push_back(0.7f);
+			vertices.push_back(0.9f);
+			vertices.push_back((float)ring / nrings);
+			vertices.push_back((float)side / nsides);
+			float cx = outerRadius * cosU;
+			float cy = outerRadius * sinU + offsetY;
+			glm::vec3 normal = glm::normalize(glm::vec3(x - cx, y - cy, z));
+			vertices.push_back(normal.x);
+			vertices.push_back(normal.y);
+			vertices.push_back(normal.z);
+		}
+	}
+	for (unsigned int ring = 0; ring < nrings; ++ring)
+	{
+		unsigned int ringStart = ring * (nsides + 1);
+		unsigned int nextRingStart = (ring + 1) * (nsides + 1);
+		for (unsigned int side = 0; side < nsides; ++side)
+		{
+			indices.push_back(ringStart + side);
+			indices.push_back(nextRingStart + side);
+			indices.push_back(ringStart + side + 1);
+			indices.push_back(ringStart + side + 1);
+			indices.push_back(nextRingStart + side);
+			indices.push_back(nextRingStart + side + 1);
+		}
+	}
+}
+
+// Best time of repeated runs, repeated for at least 200 ms and 3 runs
+static double BestMilliseconds(const std::function<void()>& generate)
+{
+	double best = 1e30, total = 0.0;
+	for (int run = 0; run < 3 || total < 200.0; run++)
+	{
+		BenchClock::time_point start = BenchClock::now();
+		generate();
+		double ms = MillisecondsSince(start);
+		best = std::min(best, ms);
+		total += ms;
+	}
+	return best;
+}
+
+// Largest difference between two vertex arrays, and the number of differing indices
+static void Compare(const std::vector<float>& expected, const std::vector<unsigned int>& expectedIndices,
+	const std::vector<float>& vertices, const std::vector<unsigned int>& indices, float& maxError, size_t& indexMismatches)
+{
+	maxError = expected.size() == vertices.size() ? 0.0f : INFINITY;
+	for (size_t i = 0; i < std::min(expected.size(), vertices.size()); i++)
+		maxError = std::max(maxError, std::abs(expected[i] - vertices[i]));
+	indexMismatches = expectedIndices.size() == indices.size() ? 0 : std::max(expectedIndices.size(), indices.size());
+	for (size_t i = 0; i < std::min(expectedIndices.size(), indices.size()); i++)
+		indexMismatches += expectedIndices[i] != indices[i];
+}
+
+static void BenchmarkMesh(const char* name, bool torus, unsigned int columns, unsigned int rows,
+	MeshGenerator& single, MeshGenerator& parallel)
+{
+	const float radius = 0.5f, innerRadius = 0.2f;
+	MeshGenerator::MeshSize size = torus ? MeshGenerator::TorusSize(columns, rows) : MeshGenerator::SphereSize(columns, rows);
+
+	// The reference starts from empty vectors each time, as the scene setup does
+	std::vector<float> expected;
+	std::vector<unsigned int> expectedIndices;
+	double referenceMs = BestMilliseconds([&]
+	{
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;
+		if (torus)
+			ReferenceTorus(innerRadius, radius, columns, rows, vertices, indices);
+		else
+			ReferenceSphere(radius, columns, rows, vertices, indices);
+		expected.swap(vertices);
+		expectedIndices.swap(indices);
+	});
+
+	// The generators write into storage allocated once, like a mapped buffer
+	std::vector<float> vertices(size.FloatCount());
+	std::vector<unsigned int> indices(size.indexCount);
+	auto timeGenerator = [&](MeshGenerator& generator)
+	{
+		return BestMilliseconds([&]
+		{
+			if (torus)
+				generator.Torus(innerRadius, radius, columns, rows, vertices.data(), indices.data());
+			else
+				generator.Sphere(radius, columns, rows, vertices.data(), indices.data());
+		});
+	};
+	double singleMs = timeGenerator(single);
+	float singleError;
+	size_t singleMismatches;
+	Compare(expected, expectedIndices, vertices, indices, singleError, singleMismatches);
+	std::fill(vertices.begin(), vertices.end(), 0.0f);
+	std::fill(indices.begin(), indices.end(), 0u);
+	double parallelMs = timeGenerator(parallel);
+	float parallelError;
+	size_t parallelMismatches;
+	Compare(expected, expectedIndices, vertices, indices, parallelError, parallelMismatches);
+
+	double megaVertices = size.vertexCount / 1e6;
+	std::cout << name << " " << columns << "x" << rows << " (" << size.vertexCount << " vertices, " << size.indexCount
+		<< " indices): reference " << referenceMs << " ms, generator " << singleMs << " ms ("
+		<< referenceMs / singleMs << "x, " << megaVertices / (singleMs / 1000.0) << " Mvertices/s), pool "
+		<< parallelMs << " ms (" << referenceMs / parallelMs << "x)\n"
+		<< "  max difference " << std::max(singleError, parallelError) << ", "
+		<< singleMismatches + parallelMismatches << " index mismatches" << std::endl;
+}
+
+// Times MeshGenerator against the original push_back sphere and torus generators, on one
+// thread and on the thread pool, from the scene's meshes up to millions of vertices, checks
+// that the outputs agree and prints the timings (no GL context needed)
+void RunMeshBenchmark()
+{
+	ThreadPool pool;
+	MeshGenerator single;
+	MeshGenerator parallel(&pool);
+	std::cout << "Mesh generation, pool of " << pool.Threads() << " threads" << std::endl;
+	BenchmarkMesh("sphere", false, 36, 18, single, parallel);
+	BenchmarkMesh("torus", true, 24, 24, single, parallel);
+	BenchmarkMesh("sphere", false, 512, 256, single, parallel);
+	BenchmarkMesh("torus", true, 512, 512, single, parallel);
+	BenchmarkMesh("sphere", false, 2048, 1024, single, parallel);
+	BenchmarkMesh("torus", true, 2048, 1024, single, parallel);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Times MeshGenerator against the original push_back sphere and torus generators, on one
+// thread and on the thread pool, from the scene's meshes up to millions of vertices, checks
+// that the outputs agree and prints the timings (no GL context needed)
+void RunMeshBenchmark();
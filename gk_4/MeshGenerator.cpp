@@ -0,0 +1,187 @@
+#include"MeshGenerator.h"
+#include<glm/glm.hpp>
+#include<glm/gtc/constants.hpp>
+#include<algorithm>
+#include<cmath>
+
+// Generator running large meshes on the given pool (nullptr: always on the calling thread)
+MeshGenerator::MeshGenerator(ThreadPool* pool)
+	: pool(pool)
+{
+}
+
+MeshGenerator::MeshSize MeshGenerator::SphereSize(unsigned int sectorCount, unsigned int stackCount)
+{
+	// The first and last stacks are fans of one triangle per sector
+	size_t indexCount = stackCount > 0 ? (size_t)6 * sectorCount * (stackCount - 1) : 0;
+	return { (size_t)(sectorCount + 1) * (stackCount + 1), indexCount };
+}
+
+MeshGenerator::MeshSize MeshGenerator::TorusSize(unsigned int nsides, unsigned int nrings)
+{
+	return { (size_t)(nsides + 1) * (nrings + 1), (size_t)6 * nsides * nrings };
+}
+
+// Fills the row or column tables for angles start + i * step, i = 0..steps
+void MeshGenerator::fillTable(std::vector<float>& cosines, std::vector<float>& sines, std::vector<float>& coords,
+	float start, float step, unsigned int steps)
+{
+	cosines.resize(steps + 1);
+	sines.resize(steps + 1);
+	coords.resize(steps + 1);
+	for (unsigned int i = 0; i <= steps; i++)
+	{
+		float angle = start + i * step;
+		cosines[i] = std::cos(angle);
+		sines[i] = std::sin(angle);
+		coords[i] = (float)i / steps;
+	}
+}
+
+// Calls generateRows(begin, end) over [0, rowCount), on the pool when the mesh is large
+template<typename RowTask>
+void MeshGenerator::forRows(size_t rowCount, size_t vertexCount, size_t rowVertices, RowTask&& generateRows)
+{
+	if (pool == nullptr || vertexCount < ParallelVertices)
+		generateRows(0, rowCount);
+	else
+		pool->ParallelFor(rowCount, std::max<size_t>(1, ChunkVertices / rowVertices), generateRows);
+}
+
+// UV sphere around the origin with its poles on the z axis, white; writes
+// SphereSize().FloatCount() floats and SphereSize().indexCount indices
+void MeshGenerator::Sphere(float radius, unsigned int sectorCount, unsigned int stackCount, float* vertices, unsigned int* indices)
+{
+	float lengthInv = 1.0f / radius;
+	fillTable(rowCos, rowSin, rowCoord, glm::pi<float>() / 2, -glm::pi<float>() / stackCount, stackCount);
+	fillTable(columnCos, columnSin, columnCoord, 0.0f, 2 * glm::pi<float>() / sectorCount, sectorCount);
+	const unsigned int columns = sectorCount + 1;
+
+	// Row i holds the vertices of stack i and the triangles between stacks i and i + 1
+	forRows(stackCount + 1, SphereSize(sectorCount, stackCount).vertexCount, columns, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			float xy = radius * rowCos[i];
+			float z = radius * rowSin[i];
+			float t = rowCoord[i];
+			float* vertex = vertices + i * columns * FloatsPerVertex;
+			for (unsigned int j = 0; j < columns; j++, vertex += FloatsPerVertex)
+			{
+				float x = xy * columnCos[j];
+				float y = xy * columnSin[j];
+				vertex[0] = x;
+				vertex[1] = y;
+				vertex[2] = z;
+				vertex[3] = 1.0f;
+				vertex[4] = 1.0f;
+				vertex[5] = 1.0f;
+				vertex[6] = columnCoord[j];
+				vertex[7] = t;
+				vertex[8] = x * lengthInv;
+				vertex[9] = y * lengthInv;
+				vertex[10] = z * lengthInv;
+			}
+
+			if (i >= stackCount)
+				continue;
+			// Stack 0 only has its lower triangles, every later one 6 indices per sector
+			unsigned int* index = indices + (i == 0 ? 0 : (size_t)sectorCount * (6 * i - 3));
+			unsigned int k1 = (unsigned int)i * columns;
+			unsigned int k2 = k1 + columns;
+			for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+			{
+				if (i != 0)
+				{
+					index[0] = k1;
+					index[1] = k2;
+					index[2] = k1 + 1;
+					index += 3;
+				}
+				if (i != (stackCount - 1))
+				{
+					index[0] = k1 + 1;
+					index[1] = k2;
+					index[2] = k2 + 1;
+					index += 3;
+				}
+			}
+		}
+	});
+}
+
+// Torus in the xy plane centered at (0, 0.5, 0), light blue; writes TorusSize().FloatCount()
+// floats and TorusSize().indexCount indices
+void MeshGenerator::Torus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings, float* vertices, unsigned int* indices)
+{
+	const float offsetY = 0.5f;
+	fillTable(rowCos, rowSin, rowCoord, 0.0f, 2.0f * glm::pi<float>() / nrings, nrings);
+	fillTable(columnCos, columnSin, columnCoord, 0.0f, 2.0f * glm::pi<float>() / nsides, nsides);
+	const unsigned int columns = nsides + 1;
+
+	// Row ring holds the vertices of that ring and the quads between it and the next one
+	forRows(nrings + 1, TorusSize(nsides, nrings).vertexCount, columns, [&](size_t begin, size_t end)
+	{
+		for (size_t ring = begin; ring < end; ring++)
+		{
+			float cosU = rowCos[ring];
+			float sinU = rowSin[ring];
+			float s = rowCoord[ring];
+			float* vertex = vertices + ring * columns * FloatsPerVertex;
+			for (unsigned int side = 0; side < columns; side++, vertex += FloatsPerVertex)
+			{
+				float cosV = columnCos[side];
+				float sinV = columnSin[side];
+				// The distance from the center of the torus tube to the current point
+				float r = outerRadius + innerRadius * cosV;
+				vertex[0] = r * cosU;
+				vertex[1] = r * sinU + offsetY;
+				vertex[2] = innerRadius * sinV;
+				vertex[3] = 0.3f;
+				vertex[4] = 0.7f;
+				vertex[5] = 0.9f;
+				vertex[6] = s;
+				vertex[7] = columnCoord[side];
+				// Direction from the tube center, already of unit length
+				vertex[8] = cosV * cosU;
+				vertex[9] = cosV * sinU;
+				vertex[10] = sinV;
+			}
+
+			if (ring >= nrings)
+				continue;
+			unsigned int* index = indices + ring * nsides * 6;
+			unsigned int ringStart = (unsigned int)ring * columns;
+			unsigned int nextRingStart = ringStart + columns;
+			for (unsigned int side = 0; side < nsides; ++side, index += 6)
+			{
+				// Two triangles per quad
+				index[0] = ringStart + side;
+				index[1] = nextRingStart + side;
+				index[2] = ringStart + side + 1;
+				index[3] = ringStart + side + 1;
+				index[4] = nextRingStart + side;
+				index[5] = nextRingStart + side + 1;
+			}
+		}
+	});
+}
+
+// Same, resizing the vectors to the exact sizes first
+void MeshGenerator::Sphere(float radius, unsigned int sectorCount, unsigned int stackCount,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+	MeshSize size = SphereSize(sectorCount, stackCount);
+	vertices.resize(size.FloatCount());
+	indices.resize(size.indexCount);
+	Sphere(radius, sectorCount, stackCount, vertices.data(), indices.data());
+}
+
+void MeshGenerator::Torus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+	MeshSize size = TorusSize(nsides, nrings);
+	vertices.resize(size.FloatCount());
+	indices.resize(size.indexCount);
+	Torus(innerRadius, outerRadius, nsides, nrings, vertices.data(), indices.data());
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include<vector>
+#include<cstddef>
+
+#include"ThreadPool.h"
+
+// Procedural sphere and torus meshes in the Object vertex layout (11 floats: position, color,
+// texCoord, normal). The exact output sizes are known up front, so the generators write
+// straight into memory the caller provides (a vector sized with SphereSize/TorusSize, or a
+// mapped buffer) and never reallocate.
+// The meshes are grids of rows and columns whose vertices only need the sine and cosine of
+// the row angle and of the column angle, so both are tabulated once per call and the inner
+// loops are multiplies and adds. Meshes of at least ParallelVertices vertices are split
+// across rows on the thread pool; every row knows its vertex and index offsets, so the
+// threads write disjoint ranges. The tables are kept between calls and only grow.
+class MeshGenerator
+{
+public:
+	// Floats per vertex (position, color, texCoord, normal)
+	static const size_t FloatsPerVertex = 11;
+	// Vertex count from which rows are generated on the thread pool
+	static const size_t ParallelVertices = 32768;
+	// Vertices per chunk of rows handed to one thread
+	static const size_t ChunkVertices = 8192;
+
+	// Number of vertices and indices a mesh is generated with
+	struct MeshSize
+	{
+		size_t vertexCount;
+		size_t indexCount;
+		size_t FloatCount() const { return vertexCount * FloatsPerVertex; }
+	};
+
+	// Generator running large meshes on the given pool (nullptr: always on the calling thread)
+	MeshGenerator(ThreadPool* pool = nullptr);
+
+	static MeshSize SphereSize(unsigned int sectorCount, unsigned int stackCount);
+	static MeshSize TorusSize(unsigned int nsides, unsigned int nrings);
+
+	// UV sphere around the origin with its poles on the z axis, white; writes
+	// SphereSize().FloatCount() floats and SphereSize().indexCount indices
+	void Sphere(float radius, unsigned int sectorCount, unsigned int stackCount, float* vertices, unsigned int* indices);
+	// Torus in the xy plane centered at (0, 0.5, 0), light blue; writes TorusSize().FloatCount()
+	// floats and TorusSize().indexCount indices
+	void Torus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings, float* vertices, unsigned int* indices);
+
+	// Same, resizing the vectors to the exact sizes first
+	void Sphere(float radius, unsigned int sectorCount, unsigned int stackCount,
+		std::vector<float>& vertices, std::vector<unsigned int>& indices);
+	void Torus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings,
+		std::vector<float>& vertices, std::vector<unsigned int>& indices);
+
+private:
+	ThreadPool* pool;
+	// Cosine, sine and texture coordinate of every row and column of the last mesh
+	std::vector<float> rowCos, rowSin, rowCoord;
+	std::vector<float> columnCos, columnSin, columnCoord;
+
+	// Fills the row or column tables for angles start + i * step, i = 0..steps
+	static void fillTable(std::vector<float>& cosines, std::vector<float>& sines, std::vector<float>& coords,
+		float start, float step, unsigned int steps);
+	// Calls generateRows(begin, end) over [0, rowCount), on the pool when the mesh is large
+	template<typename RowTask>
+	void forRows(size_t rowCount, size_t vertexCount, size_t rowVertices, RowTask&& generateRows);
+};
@@ -0,0 +1,434 @@
+#include"MeshOptimizer.h"
+#include<glm/glm.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<iostream>
+
+static const GLuint InvalidIndex = 0xFFFFFFFF;
+
+// Copies a mesh from arrays (indices may be nullptr)
+MeshData::MeshData(const GLfloat* vertices, size_t floatCount, const GLuint* indices, size_t indexCount)
+	: vertices(vertices, vertices + floatCount)
+{
+	if (indices)
+		this->indices.assign(indices, indices + indexCount);
+}
+
+// FIFO cache over ids, kept as the insertion time of every id: an id is cached while fewer
+// than size ids were inserted after it
+class FifoCache
+{
+public:
+	FifoCache(size_t ids, GLuint size) : inserted(ids, 0), size(size), time(size + 1) {}
+
+	// Inserts the id on a miss, returns whether it missed
+	bool Access(GLuint id)
+	{
+		if (time - inserted[id] <= size)
+			return false;
+		inserted[id] = time++;
+		return true;
+	}
+	// Empties the cache
+	void Flush() { time += size + 1; }
+
+private:
+	std::vector<GLuint> inserted;
+	GLuint size;
+	GLuint time;
+};
+
+// Runs every step on the mesh, whose vertices have floatsPerVertex floats each
+void MeshOptimizer::Optimize(const char* name, MeshData& mesh, GLuint floatsPerVertex)
+{
+	auto start = std::chrono::steady_clock::now();
+	GLsizei vertexSize = floatsPerVertex * sizeof(GLfloat);
+	MeshStats stats;
+	stats.name = name;
+	stats.verticesBefore = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+	if (mesh.indices.empty())
+	{
+		mesh.indices.resize(stats.verticesBefore);
+		for (GLuint i = 0; i < stats.verticesBefore; i++)
+			mesh.indices[i] = i;
+	}
+	stats.triangles = mesh.indices.size() / 3;
+	stats.before = Analyze(mesh.indices, stats.verticesBefore, vertexSize);
+
+	GLuint vertexCount = Weld(mesh, floatsPerVertex);
+	// Bytes the welded input order fetches, which the kept order must not exceed
+	auto fetchedBytes = [&](const MeshData& candidate) {
+		GLuint count = (GLuint)(candidate.vertices.size() / floatsPerVertex);
+		return Analyze(candidate.indices, count, vertexSize).overfetch * count * vertexSize;
+	};
+	float inputBytes = fetchedBytes(mesh);
+	stats.orderCacheSize = 0;
+	stats.overdraw = false;
+	for (GLuint cacheSize = CacheSize; cacheSize >= MinOrderCacheSize && stats.orderCacheSize == 0; cacheSize /= 2)
+	{
+		std::vector<GLuint> ordered = mesh.indices;
+		OptimizeVertexCache(ordered, vertexCount, cacheSize);
+		for (int overdraw = 1; overdraw >= 0 && stats.orderCacheSize == 0; overdraw--)
+		{
+			MeshData candidate;
+			candidate.vertices = mesh.vertices;
+			candidate.indices = ordered;
+			if (overdraw)
+				OptimizeOverdraw(candidate, floatsPerVertex);
+			OptimizeVertexFetch(candidate, floatsPerVertex);
+			if (fetchedBytes(candidate) <= inputBytes)
+			{
+				mesh = std::move(candidate);
+				stats.orderCacheSize = cacheSize;
+				stats.overdraw = overdraw != 0;
+			}
+		}
+	}
+	if (stats.orderCacheSize == 0)
+	{
+		MeshData candidate = mesh;
+		OptimizeVertexFetch(candidate, floatsPerVertex);
+		if (fetchedBytes(candidate) <= inputBytes)
+			mesh = std::move(candidate);
+	}
+
+	stats.verticesAfter = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+	stats.after = Analyze(mesh.indices, stats.verticesAfter, vertexSize);
+	meshes.push_back(stats);
+	milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Merges equal vertices (indices are generated first for a triangle list), returns the
+// vertex count
+GLuint MeshOptimizer::Weld(MeshData& mesh, GLuint floatsPerVertex)
+{
+	GLuint vertexCount = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+	if (mesh.indices.empty())
+	{
+		mesh.indices.resize(vertexCount);
+		for (GLuint i = 0; i < vertexCount; i++)
+			mesh.indices[i] = i;
+	}
+
+	// Open addressing table of the welded vertices, hashed on their bits (FNV-1a)
+	size_t bucketCount = 1;
+	while (bucketCount < 2 * (size_t)vertexCount)
+		bucketCount *= 2;
+	std::vector<GLuint> buckets(bucketCount, InvalidIndex);
+	std::vector<GLuint> remap(vertexCount);
+	std::vector<GLfloat> welded;
+	welded.reserve(mesh.vertices.size());
+	const size_t vertexBytes = floatsPerVertex * sizeof(GLfloat);
+	GLuint weldedCount = 0;
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		const GLfloat* data = &mesh.vertices[(size_t)vertex * floatsPerVertex];
+		const unsigned char* bytes = (const unsigned char*)data;
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < vertexBytes; i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+
+		size_t bucket = hash & (bucketCount - 1);
+		while (buckets[bucket] != InvalidIndex
+			&& std::memcmp(&welded[(size_t)buckets[bucket] * floatsPerVertex], data, vertexBytes) != 0)
+			bucket = (bucket + 1) & (bucketCount - 1);
+		if (buckets[bucket] == InvalidIndex)
+		{
+			buckets[bucket] = weldedCount++;
+			welded.insert(welded.end(), data, data + floatsPerVertex);
+		}
+		remap[vertex] = buckets[bucket];
+	}
+
+	for (GLuint& index : mesh.indices)
+		index = remap[index];
+	mesh.vertices.swap(welded);
+	return weldedCount;
+}
+
+// Reorders the triangles for a post-transform cache of cacheSize vertices (Tipsify):
+// triangles are emitted as fans around one vertex at a time, and the next fan vertex is the
+// one just emitted that stays in the cache longest while its remaining triangles are emitted.
+// Without one, the most recent vertex with triangles left (dead-end stack) or the next in
+// index order is taken.
+void MeshOptimizer::OptimizeVertexCache(std::vector<GLuint>& indices, GLuint vertexCount, GLuint cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// Triangles using each vertex, and how many of them are still to be emitted
+	std::vector<GLuint> liveTriangles(vertexCount, 0);
+	for (GLuint index : indices)
+		liveTriangles[index]++;
+	std::vector<GLuint> firstTriangle(vertexCount + 1, 0);
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+		firstTriangle[vertex + 1] = firstTriangle[vertex] + liveTriangles[vertex];
+	std::vector<GLuint> adjacency(indices.size());
+	std::vector<GLuint> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+			adjacency[filled[indices[triangle * 3 + corner]]++] = (GLuint)triangle;
+	}
+
+	std::vector<GLuint> cacheTime(vertexCount, 0);
+	GLuint time = cacheSize + 1;
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<GLuint> deadEnds, candidates;
+	std::vector<GLuint> ordered;
+	ordered.reserve(indices.size());
+	GLuint cursor = 0;
+	GLint fan = 0;
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (GLuint i = firstTriangle[fan]; i < firstTriangle[fan + 1]; i++)
+		{
+			GLuint triangle = adjacency[i];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				GLuint vertex = indices[triangle * 3 + corner];
+				ordered.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (time - cacheTime[vertex] > cacheSize)
+					cacheTime[vertex] = time++;
+			}
+		}
+
+		// A candidate whose fan still fits in the cache scores by its age in the cache
+		fan = -1;
+		GLint bestPriority = -1;
+		for (GLuint vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+			GLint age = (GLint)(time - cacheTime[vertex]);
+			GLint priority = age + 2 * (GLint)liveTriangles[vertex] <= (GLint)cacheSize ? age : 0;
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fan = (GLint)vertex;
+			}
+		}
+		while (fan < 0 && !deadEnds.empty())
+		{
+			GLuint vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0)
+				fan = (GLint)vertex;
+		}
+		while (fan < 0 && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				fan = (GLint)cursor;
+			cursor++;
+		}
+	}
+	indices.swap(ordered);
+}
+
+// Reorders clusters of a cache optimized triangle order so triangles facing away from
+// the mesh's center come first and hide the ones behind them (Sander et al. 2007). Runs
+// start where every vertex of a triangle misses the cache (a Tipsify jump) and are cut
+// again wherever the run so far is within threshold of the whole run's ACMR.
+void MeshOptimizer::OptimizeOverdraw(MeshData& mesh, GLuint floatsPerVertex, float threshold)
+{
+	std::vector<GLuint>& indices = mesh.indices;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+	GLuint vertexCount = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+	FifoCache cache(vertexCount, CacheSize);
+	auto misses = [&](size_t triangle) {
+		int count = 0;
+		for (int corner = 0; corner < 3; corner++)
+			count += cache.Access(indices[triangle * 3 + corner]);
+		return count;
+	};
+
+	std::vector<size_t> runs;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		if (misses(triangle) == 3 || triangle == 0)
+			runs.push_back(triangle);
+	}
+	runs.push_back(triangleCount);
+
+	std::vector<size_t> clusters;
+	for (size_t run = 0; run + 1 < runs.size(); run++)
+	{
+		size_t begin = runs[run], end = runs[run + 1];
+		cache.Flush();
+		int runMisses = 0;
+		for (size_t triangle = begin; triangle < end; triangle++)
+			runMisses += misses(triangle);
+		float limit = threshold * runMisses / (end - begin);
+
+		cache.Flush();
+		clusters.push_back(begin);
+		size_t clusterBegin = begin;
+		int clusterMisses = 0;
+		for (size_t triangle = begin; triangle + 1 < end; triangle++)
+		{
+			clusterMisses += misses(triangle);
+			if (clusterMisses <= limit * (triangle + 1 - clusterBegin))
+			{
+				clusterBegin = triangle + 1;
+				clusters.push_back(clusterBegin);
+				clusterMisses = 0;
+				cache.Flush();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	auto position = [&](GLuint vertex) { return glm::make_vec3(&mesh.vertices[(size_t)vertex * floatsPerVertex]); };
+	glm::vec3 meshCenter(0.0f);
+	for (GLuint index : indices)
+		meshCenter += position(index);
+	meshCenter /= (float)indices.size();
+
+	// Occlusion potential: how far the cluster lies out along its own average normal
+	struct Cluster
+	{
+		size_t begin, end;
+		float potential;
+	};
+	std::vector<Cluster> sorted;
+	for (size_t cluster = 0; cluster + 1 < clusters.size(); cluster++)
+	{
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+		{
+			glm::vec3 a = position(indices[triangle * 3]), b = position(indices[triangle * 3 + 1]), c = position(indices[triangle * 3 + 2]);
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(cross);
+			center += (a + b + c) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		float length = glm::length(normal);
+		float potential = area > 0.0f && length > 0.0f ? glm::dot(center / area - meshCenter, normal / length) : 0.0f;
+		sorted.push_back({ clusters[cluster], clusters[cluster + 1], potential });
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.potential > b.potential; });
+
+	std::vector<GLuint> ordered;
+	ordered.reserve(indices.size());
+	for (const Cluster& cluster : sorted)
+		ordered.insert(ordered.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	indices.swap(ordered);
+}
+
+// Renumbers the vertices in the order the indices first use them, dropping unused ones.
+// Vertices the post-transform cache misses again later (the edges of Tipsify's strips) are
+// usually fetched again long after their lines were evicted; numbered after all others,
+// they share lines with each other, so such a fetch reads neighbours that are fetched again
+// soon after instead of vertices that are never read again. Whichever of the two numberings
+// fetches less is kept.
+void MeshOptimizer::OptimizeVertexFetch(MeshData& mesh, GLuint floatsPerVertex)
+{
+	GLuint vertexCount = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+	std::vector<GLuint> firstUse;
+	std::vector<uint8_t> fetchedAgain(vertexCount, 0), used(vertexCount, 0);
+	FifoCache cache(vertexCount, CacheSize);
+	for (GLuint index : mesh.indices)
+	{
+		if (!cache.Access(index))
+			continue;
+		if (used[index])
+			fetchedAgain[index] = 1;
+		else
+		{
+			used[index] = 1;
+			firstUse.push_back(index);
+		}
+	}
+
+	auto numbering = [&](bool split, std::vector<GLuint>& remap, std::vector<GLuint>& indices) {
+		remap.assign(vertexCount, InvalidIndex);
+		GLuint next = 0;
+		for (uint8_t again = 0; again < 2; again++)
+		{
+			for (GLuint vertex : firstUse)
+			{
+				if (remap[vertex] == InvalidIndex && (!split || fetchedAgain[vertex] == again))
+					remap[vertex] = next++;
+			}
+		}
+		indices.resize(mesh.indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+			indices[i] = remap[mesh.indices[i]];
+	};
+	std::vector<GLuint> remap, indices, splitRemap, splitIndices;
+	GLsizei vertexSize = floatsPerVertex * sizeof(GLfloat);
+	numbering(false, remap, indices);
+	numbering(true, splitRemap, splitIndices);
+	GLuint usedCount = (GLuint)firstUse.size();
+	if (Analyze(splitIndices, usedCount, vertexSize).overfetch < Analyze(indices, usedCount, vertexSize).overfetch)
+	{
+		remap.swap(splitRemap);
+		indices.swap(splitIndices);
+	}
+
+	std::vector<GLfloat> ordered((size_t)usedCount * floatsPerVertex);
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		if (remap[vertex] != InvalidIndex)
+			std::copy_n(&mesh.vertices[(size_t)vertex * floatsPerVertex], floatsPerVertex, &ordered[(size_t)remap[vertex] * floatsPerVertex]);
+	}
+	mesh.indices.swap(indices);
+	mesh.vertices.swap(ordered);
+}
+
+// Simulates both caches over the indices: every post-transform cache miss fetches the
+// vertex, which reads the 64-byte lines it spans that the fetch cache does not hold
+VertexCacheStats MeshOptimizer::Analyze(const std::vector<GLuint>& indices, GLuint vertexCount, GLsizei vertexSize)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertexCount == 0)
+		return stats;
+	const size_t lineSize = 64;
+	FifoCache vertexCache(vertexCount, CacheSize);
+	FifoCache fetchCache(((size_t)vertexCount * vertexSize + lineSize - 1) / lineSize, FetchCacheLines);
+	size_t misses = 0, fetchedLines = 0;
+	for (GLuint index : indices)
+	{
+		if (!vertexCache.Access(index))
+			continue;
+		misses++;
+		size_t firstByte = (size_t)index * vertexSize;
+		for (size_t line = firstByte / lineSize; line <= (firstByte + vertexSize - 1) / lineSize; line++)
+			fetchedLines += fetchCache.Access((GLuint)line);
+	}
+	stats.acmr = (float)misses / (indices.size() / 3);
+	stats.atvr = (float)misses / vertexCount;
+	stats.overfetch = (float)(fetchedLines * lineSize) / ((size_t)vertexCount * vertexSize);
+	return stats;
+}
+
+// Prints the vertex counts and cache stats of every optimized mesh, before and after
+void MeshOptimizer::PrintStats() const
+{
+	std::cout << "Mesh optimizer: " << meshes.size() << " meshes in " << milliseconds << " ms (" << CacheSize
+		<< " vertex cache, " << FetchCacheLines << " line fetch cache), before -> after" << std::endl;
+	for (const MeshStats& mesh : meshes)
+	{
+		std::cout << "  " << mesh.name << ": " << mesh.triangles << " triangles, vertices " << mesh.verticesBefore << " -> " << mesh.verticesAfter
+			<< ", ACMR " << mesh.before.acmr << " -> " << mesh.after.acmr << ", ATVR " << mesh.before.atvr << " -> " << mesh.after.atvr
+			<< ", overfetch " << mesh.before.overfetch << " -> " << mesh.after.overfetch << ", order ";
+		if (mesh.orderCacheSize == 0)
+			std::cout << "input" << std::endl;
+		else
+			std::cout << "Tipsify " << mesh.orderCacheSize << (mesh.overdraw ? " + overdraw" : "") << std::endl;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include<glad/glad.h>
+#include<vector>
+#include<cstddef>
+#include<cstdint>
+
+// One detail level of a mesh: a range of its indices and the largest distance of that
+// surface from the full detail one, in the mesh's local units
+struct MeshLod
+{
+	GLuint firstIndex;
+	GLuint indexCount;
+	float error;
+};
+
+// Interleaved vertices (position first) and triangle list indices of one mesh. Without
+// indices the vertices themselves are the triangle list. Once MeshSimplifier has built the
+// detail levels, the indices of every level follow each other and lods holds their ranges,
+// finest first.
+struct MeshData
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	std::vector<MeshLod> lods;
+
+	MeshData() = default;
+	// Copies a mesh from arrays (indices may be nullptr)
+	MeshData(const GLfloat* vertices, size_t floatCount, const GLuint* indices, size_t indexCount);
+	template<size_t VSize, size_t ISize>
+	MeshData(const GLfloat(&vertices)[VSize], const GLuint(&indices)[ISize]) : MeshData(vertices, VSize, indices, ISize) {}
+	template<size_t VSize>
+	MeshData(const GLfloat(&vertices)[VSize]) : MeshData(vertices, VSize, nullptr, 0) {}
+};
+
+// How an index buffer uses the post-transform cache and the vertex fetch cache
+struct VertexCacheStats
+{
+	// Average cache misses per triangle: 3 with no reuse, about 0.5 at best on a grid
+	float acmr = 0.0f;
+	// Average transforms per vertex: cache misses per vertex, 1 at best
+	float atvr = 0.0f;
+	// Bytes fetched in 64-byte lines over the size of the vertex buffer, 1 at best
+	float overfetch = 0.0f;
+};
+
+// At-load optimization of the meshes before they go into a vertex and an index buffer,
+// in the order of the steps:
+//   weld          vertices equal in every float are merged; unindexed meshes get indices
+//   vertex cache  triangles reordered with Tipsify (Sander et al. 2007) for a FIFO
+//                 post-transform cache of CacheSize vertices
+//   overdraw      that order is cut into clusters where it costs little cache efficiency,
+//                 and the clusters are sorted to draw the outward facing ones first
+//   vertex fetch  vertices renumbered in the order the indices first use them, the ones
+//                 transformed again later in a run of their own
+// A cache optimized order transforms fewer vertices, but it comes back to the vertices on
+// the edge of a strip a whole strip later, after their lines have left the fetch cache, and
+// the overdraw clusters break it up further. So the steps are tried for CacheSize, then for
+// ever smaller caches (narrower strips), with and without the overdraw step, and the first
+// order that fetches no more bytes than the welded input is kept; if none does, the input
+// order is. The cache stats of every mesh before and after are kept for PrintStats.
+class MeshOptimizer
+{
+public:
+	// Post-transform cache size the triangles are ordered for and measured with
+	static const GLuint CacheSize = 16;
+	// 64-byte lines of the simulated vertex fetch cache
+	static const GLuint FetchCacheLines = 64;
+	// Smallest cache the triangles are ordered for when larger ones fetch more than the input
+	static const GLuint MinOrderCacheSize = 4;
+	// A cluster ends once its ACMR so far is within this factor of its whole run's ACMR
+	static constexpr float OverdrawThreshold = 1.05f;
+
+	// Runs every step on the mesh, whose vertices have floatsPerVertex floats each
+	void Optimize(const char* name, MeshData& mesh, GLuint floatsPerVertex = 11);
+
+	// Merges equal vertices (indices are generated first for a triangle list), returns the
+	// vertex count
+	static GLuint Weld(MeshData& mesh, GLuint floatsPerVertex);
+	// Reorders the triangles for a post-transform cache of cacheSize vertices (Tipsify)
+	static void OptimizeVertexCache(std::vector<GLuint>& indices, GLuint vertexCount, GLuint cacheSize = CacheSize);
+	// Reorders clusters of a cache optimized triangle order so triangles facing away from
+	// the mesh's center come first and hide the ones behind them
+	static void OptimizeOverdraw(MeshData& mesh, GLuint floatsPerVertex, float threshold = OverdrawThreshold);
+	// Renumbers the vertices in the order the indices first use them, those the post-transform
+	// cache misses again later after all others, dropping unused ones
+	static void OptimizeVertexFetch(MeshData& mesh, GLuint floatsPerVertex);
+	// Simulates both caches over the indices
+	static VertexCacheStats Analyze(const std::vector<GLuint>& indices, GLuint vertexCount, GLsizei vertexSize);
+
+	// Prints the vertex counts and cache stats of every optimized mesh, before and after
+	void PrintStats() const;
+
+private:
+	struct MeshStats
+	{
+		const char* name;
+		GLuint verticesBefore, verticesAfter;
+		size_t triangles;
+		VertexCacheStats before, after;
+		// Cache size the kept order was made for and whether it went through the overdraw
+		// step; 0 when the input order was kept
+		GLuint orderCacheSize;
+		bool overdraw;
+	};
+
+	std::vector<MeshStats> meshes;
+	double milliseconds = 0.0;
+};
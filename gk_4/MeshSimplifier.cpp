@@ -0,0 +1,541 @@
+#include"MeshSimplifier.h"
+#include<glm/glm.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdint>
+#include<iostream>
+
+static const GLuint InvalidIndex = 0xFFFFFFFF;
+// Vertices closer than this fraction of the mesh's size share a position (seams generated
+// from 0 and 2 pi differ in the last bits)
+static const double PositionTolerance = 1e-5;
+// Smallest cosine between a triangle's normal before and after a collapse
+static const double MinNormalCos = 0.2;
+
+// Sum of the squared distances to a set of planes, each weighted by its triangle's area:
+// Q(p) = p.A.p + 2 b.p + c with a symmetric A
+struct Quadric
+{
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+
+	// Plane through p with the unit normal n
+	static Quadric Plane(const glm::dvec3& n, const glm::dvec3& p, double weight)
+	{
+		double d = -glm::dot(n, p);
+		Quadric q;
+		q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z;
+		q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z; q.a22 = weight * n.z * n.z;
+		q.b0 = weight * d * n.x; q.b1 = weight * d * n.y; q.b2 = weight * d * n.z;
+		q.c = weight * d * d;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& o)
+	{
+		a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+		b0 += o.b0; b1 += o.b1; b2 += o.b2;
+		c += o.c;
+		return *this;
+	}
+
+	double Evaluate(const glm::dvec3& p) const
+	{
+		double q = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+			+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+			+ 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+		return std::max(q, 0.0);
+	}
+};
+
+// Edge collapse state of one mesh, kept from level to level. Collapses work on positions:
+// every vertex belongs to the position it shares with its copies, and triangles keep the
+// vertices of their original corners to pick the copies of the output from.
+class Collapser
+{
+public:
+	Collapser(const MeshData& mesh, GLuint floatsPerVertex)
+		: mesh(mesh), floatsPerVertex(floatsPerVertex)
+	{
+		weldPositions();
+		buildTriangles();
+		lockBorders();
+	}
+
+	size_t LiveTriangles() const { return liveTriangles; }
+
+	// Collapses the cheapest edges until at most target triangles are left, in passes that
+	// touch every position at most once; returns early when a pass finds nothing to collapse
+	void Simplify(size_t target)
+	{
+		std::vector<Candidate> candidates;
+		std::vector<bool> touched(positions.size());
+		while (liveTriangles > target)
+		{
+			collectCandidates(candidates);
+			std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+			std::fill(touched.begin(), touched.end(), false);
+			size_t collapsed = 0;
+			for (const Candidate& candidate : candidates)
+			{
+				if (liveTriangles <= target)
+					break;
+				if (touched[candidate.from] || touched[candidate.to] || !canCollapse(candidate.from, candidate.to))
+					continue;
+				collapse(candidate.from, candidate.to);
+				touched[candidate.from] = touched[candidate.to] = true;
+				collapsed++;
+			}
+			if (collapsed == 0)
+				break;
+		}
+	}
+
+	// Indices of the live triangles: each corner uses the copy of its position whose other
+	// attributes are closest to the original corner's
+	void Emit(std::vector<GLuint>& indices) const
+	{
+		for (const Triangle& triangle : triangles)
+		{
+			if (!triangle.live)
+				continue;
+			for (int k = 0; k < 3; k++)
+				indices.push_back(closestCopy(triangle.position[k], triangle.corner[k]));
+		}
+	}
+
+	// Largest distance from an original position to the level's surface, the nearest of its
+	// live triangles. Live positions are on the surface.
+	float Error() const
+	{
+		// Bounding sphere of every live triangle, to skip the ones that cannot be nearer
+		std::vector<glm::dvec4> bounds;
+		std::vector<const Triangle*> live;
+		for (const Triangle& triangle : triangles)
+		{
+			if (!triangle.live)
+				continue;
+			glm::dvec3 center = (positions[triangle.position[0]] + positions[triangle.position[1]] + positions[triangle.position[2]]) / 3.0;
+			double radius = 0.0;
+			for (int k = 0; k < 3; k++)
+				radius = std::max(radius, glm::length(positions[triangle.position[k]] - center));
+			bounds.push_back(glm::dvec4(center, radius));
+			live.push_back(&triangle);
+		}
+
+		double error = 0.0;
+		for (GLuint position = 0; position < positions.size(); position++)
+		{
+			GLuint target = find(position);
+			if (target == position)
+				continue;
+			const glm::dvec3& p = positions[position];
+			// The triangles around the position it was collapsed into are usually the nearest
+			double nearest = glm::length(p - positions[target]);
+			for (GLuint t : positionTriangles[target])
+			{
+				if (triangles[t].live)
+					nearest = std::min(nearest, triangleDistance(p, triangles[t]));
+			}
+			for (size_t i = 0; i < live.size() && nearest > 0.0; i++)
+			{
+				if (glm::length(p - glm::dvec3(bounds[i])) - bounds[i].w < nearest)
+					nearest = std::min(nearest, triangleDistance(p, *live[i]));
+			}
+			error = std::max(error, nearest);
+		}
+		return (float)error;
+	}
+
+private:
+	struct Triangle
+	{
+		GLuint position[3];
+		GLuint corner[3];
+		bool live;
+	};
+	struct Candidate
+	{
+		double cost;
+		GLuint from, to;
+	};
+
+	const MeshData& mesh;
+	GLuint floatsPerVertex;
+	// Position of every vertex, and the vertices at every position
+	std::vector<GLuint> vertexPosition;
+	std::vector<std::vector<GLuint>> copies;
+	std::vector<glm::dvec3> positions;
+	std::vector<Quadric> quadrics;
+	// Triangles around every position (dead ones are skipped)
+	std::vector<std::vector<GLuint>> positionTriangles;
+	// Position a collapsed position moved onto, InvalidIndex while it is live
+	std::vector<GLuint> collapsedInto;
+	// Open border or non-manifold edge: never moves
+	std::vector<bool> locked;
+	std::vector<Triangle> triangles;
+	size_t liveTriangles = 0;
+	// Scratch lists of canCollapse
+	mutable std::vector<GLuint> neighboursFrom, neighboursTo;
+
+	// Groups the vertices by position with a sweep along x
+	void weldPositions()
+	{
+		GLuint vertexCount = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+		glm::dvec3 low(0.0), high(0.0);
+		for (GLuint v = 0; v < vertexCount; v++)
+		{
+			glm::dvec3 p = vertexAt(v);
+			low = v == 0 ? p : glm::min(low, p);
+			high = v == 0 ? p : glm::max(high, p);
+		}
+		double tolerance = PositionTolerance * std::max(glm::length(high - low), 1e-12);
+
+		std::vector<GLuint> order(vertexCount);
+		for (GLuint v = 0; v < vertexCount; v++)
+			order[v] = v;
+		std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b) { return mesh.vertices[a * floatsPerVertex] < mesh.vertices[b * floatsPerVertex]; });
+
+		vertexPosition.assign(vertexCount, InvalidIndex);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			GLuint v = order[i];
+			if (vertexPosition[v] != InvalidIndex)
+				continue;
+			GLuint position = (GLuint)positions.size();
+			glm::dvec3 p = vertexAt(v);
+			positions.push_back(p);
+			copies.push_back({ v });
+			vertexPosition[v] = position;
+			for (size_t j = i + 1; j < order.size() && vertexAt(order[j]).x - p.x <= tolerance; j++)
+			{
+				GLuint other = order[j];
+				if (vertexPosition[other] == InvalidIndex && glm::length(vertexAt(other) - p) <= tolerance)
+				{
+					vertexPosition[other] = position;
+					copies.back().push_back(other);
+				}
+			}
+		}
+		quadrics.resize(positions.size());
+		positionTriangles.resize(positions.size());
+		collapsedInto.assign(positions.size(), InvalidIndex);
+		locked.assign(positions.size(), false);
+	}
+
+	// Triangles over positions, and the quadrics of their planes (level 0 only)
+	void buildTriangles()
+	{
+		for (size_t i = 0; i + 2 < mesh.lods[0].indexCount; i += 3)
+		{
+			Triangle triangle;
+			for (int k = 0; k < 3; k++)
+			{
+				triangle.corner[k] = mesh.indices[mesh.lods[0].firstIndex + i + k];
+				triangle.position[k] = vertexPosition[triangle.corner[k]];
+			}
+			triangle.live = triangle.position[0] != triangle.position[1] && triangle.position[1] != triangle.position[2] && triangle.position[0] != triangle.position[2];
+			if (!triangle.live)
+				continue;
+			GLuint t = (GLuint)triangles.size();
+			triangles.push_back(triangle);
+			liveTriangles++;
+
+			glm::dvec3 normal = triangleNormal(triangle.position[0], triangle.position[1], triangle.position[2]);
+			double length = glm::length(normal);
+			for (int k = 0; k < 3; k++)
+			{
+				positionTriangles[triangle.position[k]].push_back(t);
+				if (length > 0.0)
+					quadrics[triangle.position[k]] += Quadric::Plane(normal / length, positions[triangle.position[0]], 0.5 * length);
+			}
+		}
+	}
+
+	// Locks the ends of every edge that does not have exactly two triangles
+	void lockBorders()
+	{
+		std::vector<uint64_t> edges;
+		for (const Triangle& triangle : triangles)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint a = triangle.position[k], b = triangle.position[(k + 1) % 3];
+				edges.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i;
+			while (j < edges.size() && edges[j] == edges[i])
+				j++;
+			if (j - i != 2)
+			{
+				locked[(GLuint)(edges[i] >> 32)] = true;
+				locked[(GLuint)(edges[i] & 0xFFFFFFFF)] = true;
+			}
+			i = j;
+		}
+	}
+
+	glm::dvec3 vertexAt(GLuint v) const
+	{
+		const GLfloat* p = &mesh.vertices[v * floatsPerVertex];
+		return glm::dvec3(p[0], p[1], p[2]);
+	}
+
+	// Unnormalized normal, twice the area long
+	glm::dvec3 triangleNormal(GLuint a, GLuint b, GLuint c) const
+	{
+		return glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+	}
+
+	// Distance from p to the closest point of the triangle (Ericson, Real-Time Collision
+	// Detection 5.1.5)
+	double triangleDistance(const glm::dvec3& p, const Triangle& triangle) const
+	{
+		const glm::dvec3& a = positions[triangle.position[0]];
+		const glm::dvec3& b = positions[triangle.position[1]];
+		const glm::dvec3& c = positions[triangle.position[2]];
+		glm::dvec3 ab = b - a, ac = c - a, ap = p - a;
+		double d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0 && d2 <= 0.0)
+			return glm::length(ap);
+		glm::dvec3 bp = p - b;
+		double d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0 && d4 <= d3)
+			return glm::length(bp);
+		double vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+			return glm::length(ap - ab * (d1 / (d1 - d3)));
+		glm::dvec3 cp = p - c;
+		double d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0 && d5 <= d6)
+			return glm::length(cp);
+		double vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+			return glm::length(ap - ac * (d2 / (d2 - d6)));
+		double va = d3 * d6 - d5 * d4;
+		if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+			return glm::length(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+		double denominator = va + vb + vc;
+		if (denominator <= 0.0)
+			return glm::length(ap);
+		return glm::length(ap - ab * (vb / denominator) - ac * (vc / denominator));
+	}
+
+	// Live position a position was collapsed into
+	GLuint find(GLuint position) const
+	{
+		while (collapsedInto[position] != InvalidIndex)
+			position = collapsedInto[position];
+		return position;
+	}
+
+	// Positions sharing a live triangle with the position, sorted
+	void neighbours(GLuint position, std::vector<GLuint>& out) const
+	{
+		out.clear();
+		for (GLuint t : positionTriangles[position])
+		{
+			const Triangle& triangle = triangles[t];
+			if (!triangle.live)
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				if (triangle.position[k] != position)
+					out.push_back(triangle.position[k]);
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	// A seam position (more than one vertex) keeps its copies apart only while it stays on
+	// the seam; other positions can move onto any neighbour
+	bool isSeam(GLuint position) const { return copies[position].size() > 1; }
+
+	// Every edge of the live triangles, in the cheaper allowed direction
+	void collectCandidates(std::vector<Candidate>& candidates) const
+	{
+		std::vector<uint64_t> edges;
+		for (const Triangle& triangle : triangles)
+		{
+			if (!triangle.live)
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint a = triangle.position[k], b = triangle.position[(k + 1) % 3];
+				edges.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		candidates.clear();
+		for (uint64_t edge : edges)
+		{
+			GLuint a = (GLuint)(edge >> 32), b = (GLuint)(edge & 0xFFFFFFFF);
+			Quadric sum = quadrics[a];
+			sum += quadrics[b];
+			double costAB = allowed(a, b) ? sum.Evaluate(positions[b]) : -1.0;
+			double costBA = allowed(b, a) ? sum.Evaluate(positions[a]) : -1.0;
+			if (costAB >= 0.0 && (costBA < 0.0 || costAB <= costBA))
+				candidates.push_back({ costAB, a, b });
+			else if (costBA >= 0.0)
+				candidates.push_back({ costBA, b, a });
+		}
+	}
+
+	bool allowed(GLuint from, GLuint to) const
+	{
+		return !locked[from] && (!isSeam(from) || isSeam(to));
+	}
+
+	// Checks that moving from onto to neither pinches the surface (the two positions may
+	// only share the neighbours of their common triangles) nor turns a triangle over
+	bool canCollapse(GLuint from, GLuint to) const
+	{
+		neighbours(from, neighboursFrom);
+		neighbours(to, neighboursTo);
+		size_t shared = 0, sharedTriangles = 0;
+		for (GLuint n : neighboursFrom)
+			shared += std::binary_search(neighboursTo.begin(), neighboursTo.end(), n) ? 1 : 0;
+		for (GLuint t : positionTriangles[from])
+		{
+			const Triangle& triangle = triangles[t];
+			if (!triangle.live)
+				continue;
+			bool hasTo = triangle.position[0] == to || triangle.position[1] == to || triangle.position[2] == to;
+			if (hasTo)
+			{
+				sharedTriangles++;
+				continue;
+			}
+			GLuint moved[3];
+			for (int k = 0; k < 3; k++)
+				moved[k] = triangle.position[k] == from ? to : triangle.position[k];
+			glm::dvec3 before = triangleNormal(triangle.position[0], triangle.position[1], triangle.position[2]);
+			glm::dvec3 after = triangleNormal(moved[0], moved[1], moved[2]);
+			double lengths = glm::length(before) * glm::length(after);
+			if (lengths <= 0.0 || glm::dot(before, after) < MinNormalCos * lengths)
+				return false;
+		}
+		return sharedTriangles > 0 && shared <= sharedTriangles;
+	}
+
+	// Moves every triangle of from onto to, dropping the ones that lose an edge
+	void collapse(GLuint from, GLuint to)
+	{
+		quadrics[to] += quadrics[from];
+		collapsedInto[from] = to;
+		for (GLuint t : positionTriangles[from])
+		{
+			Triangle& triangle = triangles[t];
+			if (!triangle.live)
+				continue;
+			bool hasTo = false;
+			for (int k = 0; k < 3; k++)
+			{
+				hasTo = hasTo || triangle.position[k] == to;
+				if (triangle.position[k] == from)
+					triangle.position[k] = to;
+			}
+			if (hasTo)
+			{
+				triangle.live = false;
+				liveTriangles--;
+			}
+			else
+				positionTriangles[to].push_back(t);
+		}
+		positionTriangles[from].clear();
+		std::vector<GLuint>& around = positionTriangles[to];
+		around.erase(std::remove_if(around.begin(), around.end(), [&](GLuint t) { return !triangles[t].live; }), around.end());
+	}
+
+	// Copy of the position whose floats after the position are closest to the vertex's
+	GLuint closestCopy(GLuint position, GLuint vertex) const
+	{
+		const std::vector<GLuint>& candidates = copies[position];
+		if (candidates.size() == 1 || vertexPosition[vertex] == position)
+			return candidates.size() == 1 ? candidates[0] : vertex;
+		const GLfloat* reference = &mesh.vertices[vertex * floatsPerVertex];
+		GLuint best = candidates[0];
+		float bestDistance = -1.0f;
+		for (GLuint candidate : candidates)
+		{
+			const GLfloat* attributes = &mesh.vertices[candidate * floatsPerVertex];
+			float distance = 0.0f;
+			for (GLuint i = 3; i < floatsPerVertex; i++)
+				distance += (attributes[i] - reference[i]) * (attributes[i] - reference[i]);
+			if (bestDistance < 0.0f || distance < bestDistance)
+			{
+				best = candidate;
+				bestDistance = distance;
+			}
+		}
+		return best;
+	}
+};
+
+// Builds the levels of an optimized indexed mesh whose vertices have floatsPerVertex
+// floats each; mesh.lods gets at least level 0, the mesh itself
+void MeshSimplifier::BuildLods(const char* name, MeshData& mesh, GLuint floatsPerVertex)
+{
+	auto start = std::chrono::steady_clock::now();
+	mesh.lods.assign(1, MeshLod{ 0, (GLuint)mesh.indices.size(), 0.0f });
+	MeshStats stats;
+	stats.name = name;
+	stats.triangles.push_back(mesh.indices.size() / 3);
+	stats.errors.push_back(0.0f);
+
+	if (mesh.indices.size() / 3 >= 2 * MinTriangles)
+	{
+		GLuint vertexCount = (GLuint)(mesh.vertices.size() / floatsPerVertex);
+		Collapser collapser(mesh, floatsPerVertex);
+		std::vector<GLuint> level;
+		while (mesh.lods.size() < MaxLevels)
+		{
+			size_t previous = mesh.lods.back().indexCount / 3;
+			size_t target = (size_t)(previous * LevelRatio);
+			if (target < MinTriangles)
+				break;
+			collapser.Simplify(target);
+			if (collapser.LiveTriangles() > previous * MinReduction)
+				break;
+
+			level.clear();
+			collapser.Emit(level);
+			MeshOptimizer::OptimizeVertexCache(level, vertexCount);
+			// LodSelector walks the levels in order, so the error never shrinks (the distances
+			// measured on the scene's meshes grow from level to level on their own)
+			float error = std::max(collapser.Error(), mesh.lods.back().error);
+			mesh.lods.push_back(MeshLod{ (GLuint)mesh.indices.size(), (GLuint)level.size(), error });
+			mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+			stats.triangles.push_back(level.size() / 3);
+			stats.errors.push_back(error);
+		}
+	}
+	meshes.push_back(stats);
+	milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Prints the triangle counts and errors of every mesh's levels
+void MeshSimplifier::PrintStats() const
+{
+	std::cout << "Mesh LODs: " << meshes.size() << " meshes in " << milliseconds << " ms, triangles (error) per level" << std::endl;
+	for (const MeshStats& mesh : meshes)
+	{
+		if (mesh.triangles.size() < 2)
+			continue;
+		std::cout << "  " << mesh.name << ":";
+		for (size_t level = 0; level < mesh.triangles.size(); level++)
+			std::cout << (level ? ", " : " ") << mesh.triangles[level] << " (" << mesh.errors[level] << ")";
+		std::cout << std::endl;
+	}
+}
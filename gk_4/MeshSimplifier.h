@@ -0,0 +1,49 @@
+#pragma once
+#include<glad/glad.h>
+#include<vector>
+#include<cstddef>
+
+#include"MeshOptimizer.h"
+
+// Builds the detail levels of a mesh at load time with quadric error edge collapses
+// (Garland and Heckbert 1997). A collapse moves one vertex onto a neighbour, so every level
+// reuses the mesh's vertices and only needs its own indices; the levels are appended to the
+// mesh's index list and their ranges go to MeshData::lods.
+//   positions     vertices at one position (texture seams, poles) collapse as one
+//   quadrics      every position sums the area weighted planes of its triangles; a
+//                 collapse adds both sums, so the error keeps growing from level to level
+//   constraints   open borders stay, a seam vertex only moves onto another seam vertex,
+//                 and collapses that fold a triangle over or pinch the surface are skipped
+// Each level halves the triangles of the previous one and is reordered for the vertex
+// cache. The chain ends at MinTriangles, at MaxLevels, or when the constraints leave too
+// few collapses.
+class MeshSimplifier
+{
+public:
+	// Levels per mesh, level 0 included
+	static const size_t MaxLevels = 8;
+	// No level has fewer triangles, so meshes with less than twice as many keep level 0 only
+	static const size_t MinTriangles = 32;
+	// Triangles of a level over the ones of the previous level
+	static constexpr float LevelRatio = 0.5f;
+	// A level keeping more than this fraction of the previous one's triangles ends the chain
+	static constexpr float MinReduction = 0.8f;
+
+	// Builds the levels of an optimized indexed mesh whose vertices have floatsPerVertex
+	// floats each; mesh.lods gets at least level 0, the mesh itself
+	void BuildLods(const char* name, MeshData& mesh, GLuint floatsPerVertex = 11);
+
+	// Prints the triangle counts and errors of every mesh's levels
+	void PrintStats() const;
+
+private:
+	struct MeshStats
+	{
+		const char* name;
+		std::vector<size_t> triangles;
+		std::vector<float> errors;
+	};
+
+	std::vector<MeshStats> meshes;
+	double milliseconds = 0.0;
+};
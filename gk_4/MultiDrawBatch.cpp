@@ -0,0 +1,96 @@
+#include"MultiDrawBatch.h"
+#include<numeric>
+
+// Creates the draw index buffer and links it to the arena's VAO
+void MultiDrawBatch::Init(GeometryArena& arena)
+{
+	this->arena = &arena;
+	std::vector<GLuint> drawIndices(InitialCapacity);
+	std::iota(drawIndices.begin(), drawIndices.end(), 0u);
+	arena.vao.Bind();
+	// VBO only copies bytes, the attribute reads them as unsigned integers
+	VBO drawIndexVBO((GLfloat*)drawIndices.data(), drawIndices.size() * sizeof(GLuint));
+	drawIndexBuffer = drawIndexVBO.ID;
+	arena.vao.LinkInstanceIndex(drawIndexVBO, DrawIndexLocation);
+	arena.vao.Unbind();
+	capacity = InitialCapacity;
+}
+
+// Connects a MULTI_DRAW program's DrawDataBuffer block to DrawDataBinding and points
+// materialTextures[i] at texture unit i (activates the program)
+void MultiDrawBatch::PrepareShader(Shader& shader)
+{
+	shader.Activate();
+	GLuint blockIndex = glExt.GetProgramResourceIndex(shader.ID, GL_SHADER_STORAGE_BLOCK, "DrawDataBuffer");
+	if (blockIndex != GL_INVALID_INDEX)
+		glExt.ShaderStorageBlockBinding(shader.ID, blockIndex, DrawDataBinding);
+
+	// The uniform table only knows the first element, so the whole array is set at once
+	GLint units[MaxMaterials];
+	for (GLint unit = 0; unit < MaxMaterials; unit++)
+		units[unit] = unit;
+	glUniform1iv(shader.FindUniform("materialTextures"), MaxMaterials, units);
+}
+
+// Forgets the draws of the previous frame
+void MultiDrawBatch::Begin()
+{
+	draws.clear();
+	commands.clear();
+	lastMesh = UINT32_MAX;
+	lastLevel = 0;
+}
+
+// Queues one draw of a detail level of the mesh with its transform and material index
+void MultiDrawBatch::Add(uint32_t mesh, const glm::mat4& model, uint32_t material, size_t level)
+{
+	GLuint drawIndex = (GLuint)draws.size();
+	// Packed arena vertices are decoded by the transform
+	glm::mat4 meshModel = model * arena->Decode(mesh);
+	draws.push_back({ meshModel, glm::mat4(glm::transpose(glm::inverse(glm::mat3(meshModel)))), glm::uvec4(material, 0, 0, 0) });
+	if (mesh == lastMesh && level == lastLevel)
+	{
+		commands.back().instanceCount++;
+		return;
+	}
+	// Read now, the range moves when the arena is compacted
+	GeometryArena::MeshRange range = arena->Lod(mesh, level);
+	commands.push_back({ range.indexCount, 1, range.firstIndex, range.baseVertex, drawIndex });
+	lastMesh = mesh;
+	lastLevel = level;
+}
+
+// Writes commands and draw data to this frame's section of the ring buffer and issues
+// one glMultiDrawElementsIndirect
+void MultiDrawBatch::Draw(RingBuffer& ring)
+{
+	if (commands.empty())
+		return;
+
+	if (draws.size() > capacity)
+	{
+		// Grow to the next power of two; the VAO keeps pointing at the same buffer name
+		while (capacity < draws.size())
+			capacity *= 2;
+		std::vector<GLuint> drawIndices(capacity);
+		std::iota(drawIndices.begin(), drawIndices.end(), 0u);
+		glState.BindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+	}
+	arena->Bind();
+
+	// Both live in the ring buffer; the indirect pointer is an offset into it
+	RingBuffer::Range commandRange = ring.Write(commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+	RingBuffer::Range drawRange = ring.Write(draws.data(), draws.size() * sizeof(DrawData));
+	RingBuffer::BindStorage(DrawDataBinding, drawRange);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRange.buffer);
+
+	glExt.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandRange.offset, (GLsizei)commands.size(), 0);
+}
+
+// Deletes the draw index buffer (the arena owns the VAO)
+void MultiDrawBatch::Delete()
+{
+	glState.ForgetBuffer(drawIndexBuffer);
+	glDeleteBuffers(1, &drawIndexBuffer);
+}
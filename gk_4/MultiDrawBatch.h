@@ -0,0 +1,82 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+
+#include"Shader.h"
+#include"VAO.h"
+#include"VBO.h"
+#include"GeometryArena.h"
+#include"GLExtensions.h"
+#include"RingBuffer.h"
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Meshes of a GeometryArena drawn with a single glMultiDrawElementsIndirect call per frame. Each queued draw gets an entry in a shader
+// storage buffer (transform, normal matrix, material); the MULTI_DRAW scene shader finds
+// its entry through an instance attribute offset by the command's baseInstance.
+// Consecutive draws of the same mesh and detail level share one command with instanceCount > 1.
+// Needs GL 4.3 (glExt.multiDrawIndirect).
+class MultiDrawBatch
+{
+public:
+	// Texture units / materials the MULTI_DRAW shader can pick from
+	static const int MaxMaterials = 4;
+	// Attribute location of the draw index (aDrawIndex in default.vert)
+	static const GLuint DrawIndexLocation = 8;
+	// Shader storage binding of DrawDataBuffer
+	static const GLuint DrawDataBinding = 0;
+	// Draws the draw index buffer has room for before it first grows
+	static const size_t InitialCapacity = 64;
+
+	// std430 mirror of DrawData in default.vert
+	struct DrawData
+	{
+		glm::mat4 model;
+		glm::mat4 normalMatrix;
+		glm::uvec4 material;
+	};
+
+	// Creates the draw index buffer and links it to the arena's VAO
+	void Init(GeometryArena& arena);
+	// Connects a MULTI_DRAW program's DrawDataBuffer block to DrawDataBinding and points
+	// materialTextures[i] at texture unit i (activates the program)
+	static void PrepareShader(Shader& shader);
+
+	// Forgets the draws of the previous frame
+	void Begin();
+	// Queues one draw of a detail level of an arena mesh with its transform and material index
+	void Add(uint32_t mesh, const glm::mat4& model, uint32_t material, size_t level = 0);
+	// Writes commands and draw data to this frame's section of the ring buffer and issues
+	// one glMultiDrawElementsIndirect
+	void Draw(RingBuffer& ring);
+
+	// Draws queued this frame, and the commands they were packed into
+	size_t DrawCount() const { return draws.size(); }
+	size_t CommandCount() const { return commands.size(); }
+
+	// Deletes the draw index buffer (the arena owns the VAO)
+	void Delete();
+
+private:
+	GeometryArena* arena = nullptr;
+	std::vector<DrawData> draws;
+	std::vector<DrawElementsIndirectCommand> commands;
+	// Mesh and level of the last command, so a repeated draw only bumps its instance count
+	uint32_t lastMesh = UINT32_MAX;
+	size_t lastLevel = 0;
+
+	// 0, 1, 2, ... read per instance, so instance i of a command gets baseInstance + i
+	GLuint drawIndexBuffer = 0;
+	// Draws the draw index buffer has room for
+	size_t capacity = 0;
+};
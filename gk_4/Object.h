@@ -4,6 +4,8 @@
 #include "VBO.h"
 #include "EBO.h"
 #include "Texture.h"
+#include "Bounds.h"
+#include "MeshOptimizer.h"
 
 class Object {
 public:
@@ -11,16 +13,33 @@ public:
     VBO ObjectVBO;
     std::optional<EBO> ObjectEBO;
     Texture ObjTexture;
+    // Local space bounding sphere and box, used for frustum culling
+    Bounds bounds;
+    // Index ranges of the detail levels in the EBO, finest first (MeshSimplifier)
+    std::vector<MeshLod> lods;
 
+    // Links the VBO's vertices to the VAO, by default in the 11-float scene layout
+    // (position, color, texCoord, normal)
+    template<typename Layout = ObjectLayout>
     void LinkAttributes() {
-        // Position attribute
-        ObjectVAO.LinkAttrib(ObjectVBO, 0, 3, GL_FLOAT, 11 * sizeof(float), (void*)0);
-        // Color attribute
-        ObjectVAO.LinkAttrib(ObjectVBO, 1, 3, GL_FLOAT, 11 * sizeof(float), (void*)(3 * sizeof(float)));
-        // Texture coordinates attribute
-        ObjectVAO.LinkAttrib(ObjectVBO, 2, 2, GL_FLOAT, 11 * sizeof(float), (void*)(6 * sizeof(float)));
-        // Normal attribute
-        ObjectVAO.LinkAttrib(ObjectVBO, 3, 3, GL_FLOAT, 11 * sizeof(float), (void*)(8 * sizeof(float)));
+        ObjectVAO.LinkLayout(ObjectVBO, Layout::View());
+    }
+
+    // Computes the bounds from the interleaved vertex data (position first)
+    template<typename Layout = ObjectLayout>
+    void ComputeBounds(const GLfloat* vertices, size_t floatCount) {
+        static_assert(Layout::template OffsetOf<Position>() == 0, "bounds need the position first");
+        bounds = Bounds::FromVertices(vertices, floatCount, Layout::Stride / sizeof(GLfloat));
+    }
+
+    // First attribute location of the per-instance model matrix (aInstanceModel in default.vert)
+    static const GLuint InstanceTransformLocation = 4;
+
+    // Makes the per-instance transforms in the buffer available to instanced draws
+    void LinkInstances(InstanceBuffer& instances) {
+        ObjectVAO.Bind();
+        ObjectVAO.LinkInstanceTransforms(instances, InstanceTransformLocation);
+        ObjectVAO.Unbind();
     }
 
     Object(VAO& vao, VBO& vbo)
@@ -34,14 +53,10 @@ public:
         ObjectEBO = ebo;
     }
 
-    // Unified Bind method
+    // Unified Bind method (the VAO already references the VBO attributes and the EBO)
     void Bind()
     {
         ObjectVAO.Bind();
-        ObjectVBO.Bind();
-        if (ObjectEBO.has_value()) {
-            ObjectEBO.value().Bind();
-        }
     }
 
     void SetTexture(Texture& texture)
@@ -68,22 +83,4 @@ public:
             ObjectEBO.value().Delete();
         }
     }
-    void Draw(glm::vec3 pos, Shader& shader, GLuint indicesCount)
-    {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, pos);
-        shader.setMatrix4("model", model);
-        ObjTexture.Bind();
-        ObjectVAO.Bind();
-        glDrawElements(GL_TRIANGLES, indicesCount, GL_UNSIGNED_INT, 0);
-    }
-
-    void Draw(glm::vec3 pos, Shader& shader, GLint first, GLsizei count)
-    {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, pos);
-        shader.setMatrix4("model", model);
-        ObjectVAO.Bind();
-        glDrawArrays(GL_TRIANGLES, first, count);
-    }
 };
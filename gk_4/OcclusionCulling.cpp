@@ -0,0 +1,172 @@
+#include"OcclusionCulling.h"
+#include"UniformBlocks.h"
+
+// Unit cube corners, scaled onto each tested box in occlusion.vert
+static GLfloat unitCubeVertices[] = {
+	0.0f, 0.0f, 0.0f,
+	1.0f, 0.0f, 0.0f,
+	1.0f, 1.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f
+};
+static GLuint unitCubeIndices[] = {
+	0, 2, 1,  0, 3, 2,  // Back face
+	4, 5, 6,  4, 6, 7,  // Front face
+	0, 1, 5,  0, 5, 4,  // Bottom face
+	3, 7, 6,  3, 6, 2,  // Top face
+	0, 4, 7,  0, 7, 3,  // Left face
+	1, 2, 6,  1, 6, 5   // Right face
+};
+
+// Builds the box program (occlusion.vert/.frag) and the unit cube it draws
+OcclusionCuller::OcclusionCuller(ProgramCache* cache)
+	: boxShader("occlusion.vert", "occlusion.frag", cache),
+	cubeVBO(unitCubeVertices, sizeof(unitCubeVertices)),
+	cubeEBO(unitCubeIndices, sizeof(unitCubeIndices))
+{
+	// The element buffer is VAO state, so it is bound again with the VAO bound
+	cubeVAO.Bind();
+	cubeEBO.Bind();
+	cubeVAO.LinkLayout(cubeVBO, PositionLayout::View());
+	cubeVAO.Unbind();
+	boxShader.BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+}
+
+// Starts a frame for objectCount objects seen from the camera with the given perspective
+// projection: collects every query result that is ready
+void OcclusionCuller::BeginFrame(size_t objectCount, const glm::vec3& cameraPosition, const glm::mat4& projection)
+{
+	// The near distance is -P[3][2] / (1 - P[2][2]) in a GL perspective projection, and the
+	// near plane's half width and height are that over P[0][0] and P[1][1]
+	this->cameraPosition = cameraPosition;
+	float nearDistance = projection[3][2] / (projection[2][2] - 1.0f);
+	nearReach = nearDistance * glm::sqrt(1.0f + 1.0f / (projection[0][0] * projection[0][0]) + 1.0f / (projection[1][1] * projection[1][1]));
+
+	// Slots dropped when the count shrinks take their queries with them
+	for (size_t object = objectCount; object < slots.size(); object++)
+	{
+		if (slots[object].query)
+			glDeleteQueries(1, &slots[object].query);
+	}
+	if (slots.size() != objectCount)
+		slots.resize(objectCount);
+	frames++;
+
+	for (Slot& slot : slots)
+	{
+		if (!slot.pending)
+			continue;
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint anySamples = GL_TRUE;
+		glGetQueryObjectuiv(slot.query, GL_QUERY_RESULT, &anySamples);
+		slot.pending = false;
+		slot.occluded = anySamples == GL_FALSE;
+		resultsRead++;
+		occludedResults += slot.occluded;
+	}
+}
+
+// True when the box, as it is queried, comes closer to the camera than the corners of the near plane
+bool OcclusionCuller::ReachesNearPlane(const AABB& box) const
+{
+	AABB queried = QueryBox(box);
+	glm::vec3 closest = glm::clamp(cameraPosition, queried.min, queried.max);
+	return glm::length(closest - cameraPosition) <= nearReach;
+}
+
+// The box grown a little, as it is drawn for the query: flat objects (the mirror quad) still
+// rasterize and depth ties pass
+AABB OcclusionCuller::QueryBox(const AABB& box)
+{
+	glm::vec3 margin = glm::abs(box.max - box.min) * 0.01f + glm::vec3(0.001f);
+	return { box.min - margin, box.max + margin };
+}
+
+// Query object of the object, valid for the whole run (for conditional draws queued before Query)
+GLuint OcclusionCuller::QueryObject(size_t object)
+{
+	Slot& slot = slots[object];
+	if (!slot.query)
+		glGenQueries(1, &slot.query);
+	return slot.query;
+}
+
+// Masks color and depth writes and activates the box program
+void OcclusionCuller::BeginQueries()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	// Boxes that coincide with the object surface (a cube's own faces) must still count as visible
+	glDepthFunc(GL_LEQUAL);
+	boxShader.Activate();
+	// Resolved on first use so constructing the culler does not wait for the program
+	if (!boxMin.IsValid())
+	{
+		boxMin = boxShader.GetUniform<glm::vec3>("boxMin");
+		boxMax = boxShader.GetUniform<glm::vec3>("boxMax");
+	}
+	cubeVAO.Bind();
+}
+
+// Draws the box against the current depth buffer inside a query and returns the query.
+// While the object's previous query is still in flight no new one is issued, and that one is returned.
+// A box reaching the near plane is not queried, counts as visible from now on and returns 0.
+GLuint OcclusionCuller::Query(size_t object, const AABB& box)
+{
+	Slot& slot = slots[object];
+	if (ReachesNearPlane(box))
+	{
+		slot.occluded = false;
+		nearPlaneBoxes++;
+		return 0;
+	}
+	if (slot.pending)
+		return slot.query;
+	QueryObject(object);
+
+	AABB queried = QueryBox(box);
+	boxShader.set(boxMin, queried.min);
+	boxShader.set(boxMax, queried.max);
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, slot.query);
+	glDrawElements(GL_TRIANGLES, sizeof(unitCubeIndices) / sizeof(GLuint), GL_UNSIGNED_INT, 0);
+	glEndQuery(GL_ANY_SAMPLES_PASSED);
+	slot.pending = true;
+	queriesIssued++;
+	return slot.query;
+}
+
+// Restores color and depth writes
+void OcclusionCuller::EndQueries()
+{
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Prints issued queries and occluded objects of the frames so far
+void OcclusionCuller::PrintStats() const
+{
+	std::cout << "Occlusion culling: " << (frames ? (double)queriesIssued / frames : 0.0) << " queries per frame, "
+		<< occludedResults << " of " << resultsRead << " results occluded, " << nearPlaneBoxes << " boxes not queried at the near plane" << std::endl;
+}
+
+// Deletes the queries, the box program and the cube
+void OcclusionCuller::Delete()
+{
+	for (Slot& slot : slots)
+	{
+		if (slot.query)
+			glDeleteQueries(1, &slot.query);
+	}
+	slots.clear();
+	boxShader.Delete();
+	cubeVAO.Delete();
+	cubeVBO.Delete();
+	cubeEBO.Delete();
+}
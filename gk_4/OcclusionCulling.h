@@ -0,0 +1,79 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+#include<iostream>
+
+#include"Shader.h"
+#include"VAO.h"
+#include"VBO.h"
+#include"EBO.h"
+#include"Bounds.h"
+
+// Hardware occlusion culling with GL_ANY_SAMPLES_PASSED queries on bounding boxes.
+// Results are only read once the driver reports them available, so the CPU never waits:
+// an object's visibility lags its query by a frame or more. Draws that depend on a query
+// issued in the same frame are wrapped in glBeginConditionalRender by the caller.
+// A box that reaches the camera's near plane loses the front faces the query would draw, so
+// it could read as hidden while the camera is inside the object: such boxes count as visible
+// and are not queried.
+class OcclusionCuller
+{
+public:
+	// Builds the box program (occlusion.vert/.frag) and the unit cube it draws
+	OcclusionCuller(ProgramCache* cache);
+
+	// Starts a frame for objectCount objects seen from the camera with the given perspective
+	// projection: collects every query result that is ready
+	void BeginFrame(size_t objectCount, const glm::vec3& cameraPosition, const glm::mat4& projection);
+	// True when the last finished query of the object found its box hidden and the box does
+	// not reach the near plane
+	bool WasOccluded(size_t object, const AABB& box) const { return slots[object].occluded && !ReachesNearPlane(box); }
+	// True when the box, as it is queried, comes closer to the camera than the corners of the near plane
+	bool ReachesNearPlane(const AABB& box) const;
+
+	// Query object of the object, valid for the whole run (for conditional draws queued before Query)
+	GLuint QueryObject(size_t object);
+
+	// Masks color and depth writes and activates the box program
+	void BeginQueries();
+	// Draws the box against the current depth buffer inside a query and returns the query.
+	// While the object's previous query is still in flight no new one is issued, and that one is returned.
+	// A box reaching the near plane is not queried, counts as visible from now on and returns 0.
+	GLuint Query(size_t object, const AABB& box);
+	// Restores color and depth writes
+	void EndQueries();
+
+	// Prints issued queries and occluded objects of the frames so far
+	void PrintStats() const;
+	// Deletes the queries, the box program and the cube
+	void Delete();
+
+private:
+	struct Slot
+	{
+		GLuint query = 0;
+		bool pending = false;
+		bool occluded = false;
+	};
+
+	std::vector<Slot> slots;
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	// Distance from the camera to the corners of the near plane
+	float nearReach = 0.0f;
+	Shader boxShader;
+	Uniform<glm::vec3> boxMin;
+	Uniform<glm::vec3> boxMax;
+	VAO cubeVAO;
+	VBO cubeVBO;
+	EBO cubeEBO;
+
+	int frames = 0;
+	size_t queriesIssued = 0;
+	size_t occludedResults = 0;
+	size_t resultsRead = 0;
+	size_t nearPlaneBoxes = 0;
+
+	// The box grown a little, as it is drawn for the query
+	static AABB QueryBox(const AABB& box);
+};
@@ -0,0 +1,246 @@
+#include"PlanarMirror.h"
+#include<algorithm>
+#include<cmath>
+
+// Mirror in the plane dot(plane.xyz, p) + plane.w = 0, facing the side where it is positive,
+// seen in a viewport of the given size. textureScale is the number of reflection texels per
+// mirror pixel along each axis (0 draws the reflection straight into the scene every frame).
+PlanarMirror::PlanarMirror(const glm::vec4& plane, int width, int height, float textureScale, int updateInterval)
+	: plane(plane), viewportWidth(width), viewportHeight(height), textureScale(textureScale), updateInterval(updateInterval)
+{
+	// p' = p - 2 (dot(n, p) + d) n
+	glm::vec3 n = glm::vec3(plane);
+	reflection = glm::mat4(1.0f);
+	for (int column = 0; column < 3; column++)
+	{
+		for (int row = 0; row < 3; row++)
+			reflection[column][row] -= 2.0f * n[row] * n[column];
+	}
+	reflection[3] = glm::vec4(-2.0f * plane.w * n, 1.0f);
+
+	if (!UsesTexture())
+		return;
+	// Large enough for a mirror covering the whole viewport
+	textureWidth = std::max((int)std::ceil(width * textureScale), 1);
+	textureHeight = std::max((int)std::ceil(height * textureScale), 1);
+
+	glGenTextures(1, &texture);
+	glState.BindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, textureWidth, textureHeight);
+
+	glGenFramebuffers(1, &fbo);
+	glState.BindFramebuffer(fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Reflection framebuffer is not complete!" << std::endl;
+	glState.BindFramebuffer(0);
+}
+
+// Computes the reflected view, its oblique projection, the screen rectangle of the
+// surface's world box and the reflected frustum for the camera; forgets tracked objects
+void PlanarMirror::Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const AABB& surface)
+{
+	const int width = viewportWidth, height = viewportHeight;
+	reflectedView = view * reflection;
+	reflectedCameraPos = glm::vec3(reflection * glm::vec4(cameraPos, 1.0f));
+	cameraMatrix = projection * view;
+	trackedModels.clear();
+	frames++;
+	framesSinceRender++;
+
+	// Mirror plane in the eye space of the reflected view, the eye is on its negative side.
+	// A reduced resolution texture keeps a little of what lies behind the mirror, so the texels
+	// straddling the edge of the surface are not filtered against the empty clear color.
+	glm::vec4 clipWorld = plane + glm::vec4(0.0f, 0.0f, 0.0f, UsesTexture() ? TextureClipOffset : 0.0f);
+	glm::vec4 clipPlane = glm::transpose(glm::inverse(reflectedView)) * clipWorld;
+	// Replace the near plane with it (Lengyel): the corner of the view volume opposite the
+	// plane stays on the far plane, so the depth range is used as well as it can be
+	glm::vec4 corner = glm::inverse(projection) * glm::vec4(glm::sign(clipPlane.x), glm::sign(clipPlane.y), 1.0f, 1.0f);
+	glm::vec4 scaledPlane = clipPlane * (2.0f / glm::dot(clipPlane, corner));
+	obliqueProjection = projection;
+	for (int column = 0; column < 4; column++)
+		obliqueProjection[column][2] = scaledPlane[column] - projection[column][3];
+
+	// Bounds of the projected box corners; a corner behind the camera leaves the whole viewport
+	glm::vec2 low(1.0f), high(-1.0f);
+	bool clipped = false;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 point((corner & 1) ? surface.max.x : surface.min.x, (corner & 2) ? surface.max.y : surface.min.y,
+			(corner & 4) ? surface.max.z : surface.min.z);
+		glm::vec4 clip = cameraMatrix * glm::vec4(point, 1.0f);
+		if (clip.w <= 0.0f)
+		{
+			clipped = true;
+			break;
+		}
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		low = glm::min(low, ndc);
+		high = glm::max(high, ndc);
+	}
+	if (clipped)
+	{
+		low = glm::vec2(-1.0f);
+		high = glm::vec2(1.0f);
+	}
+	rectX = std::max((int)std::floor((low.x * 0.5f + 0.5f) * width), 0);
+	rectY = std::max((int)std::floor((low.y * 0.5f + 0.5f) * height), 0);
+	rectWidth = std::max(std::min((int)std::ceil((high.x * 0.5f + 0.5f) * width), width) - rectX, 0);
+	rectHeight = std::max(std::min((int)std::ceil((high.y * 0.5f + 0.5f) * height), height) - rectY, 0);
+
+	// Crop matrix: the pixel rectangle becomes the whole clip space
+	crop = glm::mat4(1.0f);
+	if (rectWidth > 0 && rectHeight > 0)
+	{
+		glm::vec2 center((rectX + 0.5f * rectWidth) / width * 2.0f - 1.0f, (rectY + 0.5f * rectHeight) / height * 2.0f - 1.0f);
+		glm::vec2 halfSize((float)rectWidth / width, (float)rectHeight / height);
+		crop[0][0] = 1.0f / halfSize.x;
+		crop[1][1] = 1.0f / halfSize.y;
+		crop[3][0] = -center.x / halfSize.x;
+		crop[3][1] = -center.y / halfSize.y;
+	}
+
+	// The near plane of these frustum planes is the mirror plane, the side planes pass
+	// through the edges of the surface's rectangle
+	frustum = Frustum::FromMatrix(crop * obliqueProjection * reflectedView);
+}
+
+// The camera sees the reflecting side (the mirror is skipped from behind)
+bool PlanarMirror::Faces(const glm::vec3& cameraPos) const
+{
+	return glm::dot(glm::vec3(plane), cameraPos) + plane.w > 0.0f;
+}
+
+// Step 1: the mirror surface drawn next writes stencil only, where it passes the depth test
+void PlanarMirror::BeginMask()
+{
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(rectX, rectY, rectWidth, rectHeight);
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_ALWAYS, 1, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+}
+
+// Step 2: the mirror surface drawn next resets the marked pixels to the far plane and to
+// black, the clear color of the scene (any program, the blend function discards its output)
+void PlanarMirror::BeginClear()
+{
+	glStencilFunc(GL_EQUAL, 1, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_ALWAYS);
+	glDepthRange(1.0, 1.0);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ZERO, GL_ZERO);
+}
+
+// Step 3: the reflected scene drawn next is limited to the marked pixels
+void PlanarMirror::BeginReflection()
+{
+	glDisable(GL_BLEND);
+	glDepthRange(0.0, 1.0);
+	glDepthFunc(GL_LESS);
+}
+
+// Step 4: the mirror surface drawn next is blended over the marked pixels and writes its depth
+void PlanarMirror::BeginSurface()
+{
+	glDepthFunc(GL_ALWAYS);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Restores the depth test, disables blending and the stencil and scissor tests
+void PlanarMirror::End()
+{
+	glDisable(GL_BLEND);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+// The texture has to be rendered this frame (interval elapsed, or something moved)
+bool PlanarMirror::TextureDue() const
+{
+	if (!rendered)
+		return true;
+	if (updateInterval > 0)
+		return framesSinceRender >= updateInterval;
+	return cameraMatrix != renderedCamera || trackedModels != renderedModels;
+}
+
+// Binds the reflection framebuffer, sets the viewport to the part of the texture rendered
+// this frame and clears it
+void PlanarMirror::BeginTexture()
+{
+	// Only the texels covering the mirror's rectangle at the chosen scale are rendered
+	usedWidth = std::min(std::max((int)std::ceil(rectWidth * textureScale), 1), textureWidth);
+	usedHeight = std::min(std::max((int)std::ceil(rectHeight * textureScale), 1), textureHeight);
+	glState.BindFramebuffer(fbo);
+	glViewport(0, 0, usedWidth, usedHeight);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, usedWidth, usedHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+// Restores the target framebuffer and viewport, remembers what the texture shows
+void PlanarMirror::EndTexture(GLuint targetFBO)
+{
+	glState.BindFramebuffer(targetFBO);
+	glViewport(0, 0, viewportWidth, viewportHeight);
+
+	// Clip space of the cropped projection to the used part of the texture
+	glm::mat4 bias(1.0f);
+	bias[0][0] = 0.5f * usedWidth / textureWidth;
+	bias[1][1] = 0.5f * usedHeight / textureHeight;
+	bias[3][0] = 0.5f * usedWidth / textureWidth;
+	bias[3][1] = 0.5f * usedHeight / textureHeight;
+	textureTransform = bias * Projection() * reflectedView;
+
+	rendered = true;
+	framesSinceRender = 0;
+	renderedCamera = cameraMatrix;
+	renderedModels = trackedModels;
+	renders++;
+	renderedTexels += (double)usedWidth * usedHeight;
+}
+
+// Largest coordinates whose bilinear footprint stays inside the rendered part
+glm::vec2 PlanarMirror::TextureLimit() const
+{
+	return glm::vec2((usedWidth - 0.5f) / textureWidth, (usedHeight - 0.5f) / textureHeight);
+}
+
+// Prints the reflection texture size and how often it was rendered (nothing without one)
+void PlanarMirror::PrintStats() const
+{
+	if (fbo == 0)
+		return;
+	std::cout << "Mirror reflection texture: " << textureWidth << "x" << textureHeight << " allocated, last "
+		<< usedWidth << "x" << usedHeight << " used, rendered in " << renders << " of " << frames << " frames ("
+		<< (renders > 0 ? renderedTexels / renders : 0.0) << " texels on average)" << std::endl;
+}
+
+// Deletes the reflection framebuffer and texture
+void PlanarMirror::Delete()
+{
+	if (fbo == 0)
+		return;
+	glState.ForgetTexture(texture);
+	glDeleteTextures(1, &texture);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glState.ForgetFramebuffer(fbo);
+	glDeleteFramebuffers(1, &fbo);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+#include<iostream>
+
+#include"Frustum.h"
+#include"GLState.h"
+
+// Planar mirror rendered in one pass straight into the scene framebuffer:
+//   1. the mirror surface marks its visible pixels in the stencil buffer
+//   2. the surface is drawn again inside them at the far plane, resetting depth and color
+//   3. the reflected scene is drawn once, limited to the marked pixels
+//   4. the surface is blended over the reflection and writes its own depth back (depths of
+//      the oblique projection do not compare with the camera's)
+// The reflected view uses a projection whose near plane is the mirror plane (oblique near
+// plane clipping, Lengyel), so nothing behind the mirror is rasterized, and the reflected
+// objects are culled against the frustum of that same projection, narrowed to the screen
+// rectangle of the mirror surface. All three steps are scissored to that rectangle.
+//
+// With a texture scale the reflected scene is instead rendered into a reflection texture
+// of the mirror's screen rectangle times the scale, which the mirror surface samples
+// projectively. The texture is refreshed every updateInterval frames, or with an interval
+// of 0 only when the camera or a reflected object moved; in between the surface keeps
+// sampling the last one through the matrices it was rendered with.
+class PlanarMirror
+{
+public:
+	// Mirror in the plane dot(plane.xyz, p) + plane.w = 0, facing the side where it is positive,
+	// seen in a viewport of the given size. textureScale is the number of reflection texels per
+	// mirror pixel along each axis (0 draws the reflection straight into the scene every frame).
+	PlanarMirror(const glm::vec4& plane, int width, int height, float textureScale = 0.0f, int updateInterval = 1);
+
+	// Computes the reflected view, its oblique projection, the screen rectangle of the
+	// surface's world box and the reflected frustum for the camera; forgets tracked objects
+	void Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const AABB& surface);
+	// The camera sees the reflecting side (the mirror is skipped from behind)
+	bool Faces(const glm::vec3& cameraPos) const;
+
+	// Matrix reflecting world space across the plane
+	const glm::mat4& Reflection() const { return reflection; }
+	// Reflected view, the projection to render it with (cropped to the texture rectangle when
+	// there is a texture), the reflected frustum and the reflected camera position
+	const glm::mat4& View() const { return reflectedView; }
+	glm::mat4 Projection() const { return UsesTexture() ? crop * obliqueProjection : obliqueProjection; }
+	const Frustum& ReflectedFrustum() const { return frustum; }
+	const glm::vec3& CameraPosition() const { return reflectedCameraPos; }
+
+	// Step 1: the mirror surface drawn next writes stencil only, where it passes the depth test
+	void BeginMask();
+	// Step 2: the mirror surface drawn next resets the marked pixels to the far plane and to
+	// black, the clear color of the scene (any program, the blend function discards its output)
+	void BeginClear();
+	// Step 3: the reflected scene drawn next is limited to the marked pixels
+	void BeginReflection();
+	// Step 4: the mirror surface drawn next is blended over the marked pixels and writes its depth
+	void BeginSurface();
+	// Restores the depth test, disables blending and the stencil and scissor tests
+	void End();
+
+	// Reflection texture path: distance behind the mirror its near plane is moved
+	static constexpr float TextureClipOffset = 0.1f;
+	bool UsesTexture() const { return textureScale > 0.0f; }
+	// Records the model matrix of an object drawn in the reflection this frame
+	void Track(const glm::mat4& model) { trackedModels.push_back(model); }
+	// The texture has to be rendered this frame (interval elapsed, or something moved)
+	bool TextureDue() const;
+	// Binds the reflection framebuffer, sets the viewport to the part of the texture rendered
+	// this frame and clears it
+	void BeginTexture();
+	// Restores the target framebuffer and viewport, remembers what the texture shows
+	void EndTexture(GLuint targetFBO);
+	// Reflection texture and the matrix taking world positions to its coordinates
+	GLuint Texture() const { return texture; }
+	const glm::mat4& TextureTransform() const { return textureTransform; }
+	// Largest coordinates whose bilinear footprint stays inside the rendered part
+	glm::vec2 TextureLimit() const;
+
+	// Prints the reflection texture size and how often it was rendered (nothing without one)
+	void PrintStats() const;
+
+	// Deletes the reflection framebuffer and texture
+	void Delete();
+
+private:
+	glm::vec4 plane;
+	glm::mat4 reflection;
+	glm::mat4 reflectedView = glm::mat4(1.0f);
+	glm::mat4 obliqueProjection = glm::mat4(1.0f);
+	// Maps the surface's screen rectangle to the whole clip space
+	glm::mat4 crop = glm::mat4(1.0f);
+	Frustum frustum;
+	glm::vec3 reflectedCameraPos = glm::vec3(0.0f);
+	glm::mat4 cameraMatrix = glm::mat4(1.0f);
+	int viewportWidth;
+	int viewportHeight;
+	// Screen rectangle of the surface in pixels
+	int rectX = 0, rectY = 0, rectWidth = 0, rectHeight = 0;
+
+	float textureScale;
+	int updateInterval;
+	GLuint fbo = 0;
+	GLuint texture = 0;
+	GLuint depthBuffer = 0;
+	int textureWidth = 0, textureHeight = 0;
+	// Part of the texture rendered this frame
+	int usedWidth = 0, usedHeight = 0;
+	glm::mat4 textureTransform = glm::mat4(1.0f);
+	// What the texture was last rendered with, compared against the current frame
+	bool rendered = false;
+	int framesSinceRender = 0;
+	glm::mat4 renderedCamera = glm::mat4(1.0f);
+	std::vector<glm::mat4> trackedModels;
+	std::vector<glm::mat4> renderedModels;
+
+	unsigned frames = 0;
+	unsigned renders = 0;
+	double renderedTexels = 0.0;
+};
@@ -0,0 +1,154 @@
+#include"ProgramCache.h"
+#include<chrono>
+#include<fstream>
+#include<sstream>
+#include<vector>
+#include<filesystem>
+
+// Header written in front of every cached binary
+struct ProgramBinaryHeader
+{
+	uint32_t magic;
+	uint32_t binaryFormat;
+	uint32_t length;
+	// Time it took to compile and link from source, used to report the time saved
+	float buildMs;
+};
+
+static const uint32_t ProgramBinaryMagic = 0x42504B47; // "GKPB"
+
+// FNV-1a 64-bit hash continued from the given state
+static uint64_t hashBytes(const std::string& data, uint64_t hash = 14695981039346656037ull)
+{
+	for (unsigned char c : data)
+		hash = (hash ^ c) * 1099511628211ull;
+	return hash;
+}
+
+ProgramCache::ProgramCache(const std::string& directory, bool enabled)
+	: directory(directory), enabled(enabled && glExt.programBinary)
+{
+	driverId = std::string((const char*)glGetString(GL_VENDOR)) + "|"
+		+ (const char*)glGetString(GL_RENDERER) + "|"
+		+ (const char*)glGetString(GL_VERSION);
+
+	if (this->enabled)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+	}
+}
+
+// Hash of the program sources combined with the driver identity
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource) const
+{
+	uint64_t hash = hashBytes(driverId);
+	// Separators keep "ab" + "c" and "a" + "bc" from colliding
+	hash = hashBytes(vertexSource + '\0', hash);
+	return hashBytes(fragmentSource + '\0', hash);
+}
+
+std::string ProgramCache::PathFor(uint64_t key) const
+{
+	std::ostringstream name;
+	name << directory << "/" << std::hex << key << ".bin";
+	return name.str();
+}
+
+// Creates a program from the cached binary, returns 0 when there is no usable entry
+GLuint ProgramCache::Load(uint64_t key)
+{
+	if (!enabled)
+		return 0;
+
+	std::ifstream in(PathFor(key), std::ios::binary | std::ios::ate);
+	std::streamoff fileSize = in ? (std::streamoff)in.tellg() : 0;
+	ProgramBinaryHeader header;
+	// A truncated or corrupt entry misses like a missing one, before anything is allocated
+	if (!in || fileSize < (std::streamoff)sizeof(header) || !in.seekg(0).read((char*)&header, sizeof(header))
+		|| header.magic != ProgramBinaryMagic || fileSize != (std::streamoff)sizeof(header) + header.length)
+	{
+		misses++;
+		return 0;
+	}
+	std::vector<char> binary(header.length);
+	if (!in.read(binary.data(), binary.size()))
+	{
+		misses++;
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	GLuint program = glCreateProgram();
+	glExt.ProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+	// The driver is free to reject binaries (e.g. after an update); rebuild from source then
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		rejected++;
+		misses++;
+		return 0;
+	}
+
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - start;
+	hits++;
+	savedMs += header.buildMs - loadTime.count();
+	return program;
+}
+
+// Saves the binary of a freshly linked program together with the time it took to build
+void ProgramCache::Store(uint64_t key, GLuint program, double buildMs)
+{
+	compileMs += buildMs;
+	if (!enabled)
+		return;
+
+	GLint linked = GL_FALSE, length = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (linked == GL_FALSE || length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glExt.GetProgramBinary(program, length, &written, &format, binary.data());
+
+	// Written next to the entry and renamed over it, so a crash mid-write never leaves a
+	// torn entry behind
+	ProgramBinaryHeader header = { ProgramBinaryMagic, format, (uint32_t)written, (float)buildMs };
+	std::string path = PathFor(key), temporaryPath = path + ".tmp";
+	std::ofstream out(temporaryPath, std::ios::binary);
+	out.write((const char*)&header, sizeof(header));
+	out.write(binary.data(), written);
+	out.close();
+	std::error_code error;
+	if (out)
+		std::filesystem::rename(temporaryPath, path, error);
+	if (!out || error)
+		std::filesystem::remove(temporaryPath, error);
+}
+
+// Must be called before linking so the driver keeps the binary retrievable
+void ProgramCache::PrepareForLink(GLuint program) const
+{
+	if (enabled)
+		glExt.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// Prints hit/miss counts and the compile time the hits saved
+void ProgramCache::PrintStats() const
+{
+	if (!enabled)
+	{
+		std::cout << "Program binary cache: disabled (no driver support or turned off)" << std::endl;
+		return;
+	}
+	std::cout << "Program binary cache: " << hits << " hits, " << misses << " misses";
+	if (rejected > 0)
+		std::cout << " (" << rejected << " rejected by driver)";
+	std::cout << ", compiled in " << compileMs << " ms, saved ~" << savedMs << " ms" << std::endl;
+}
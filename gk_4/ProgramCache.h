@@ -0,0 +1,46 @@
+#pragma once
+#include<glad/glad.h>
+#include<string>
+#include<cstdint>
+#include<iostream>
+
+#include"GLExtensions.h"
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// Entries are keyed by a hash of the shader sources and the driver vendor, renderer
+// and version, so a driver update or a shader edit simply misses and recompiles.
+class ProgramCache
+{
+public:
+	// Directory the binaries are stored in
+	std::string directory;
+	// False when the driver has no program binary support or the cache was turned off
+	bool enabled;
+
+	// Statistics reported at startup
+	int hits = 0;
+	int misses = 0;
+	int rejected = 0;
+	double compileMs = 0.0;
+	double savedMs = 0.0;
+
+	ProgramCache(const std::string& directory, bool enabled = true);
+
+	// Hash of the program sources combined with the driver identity
+	uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource) const;
+	// Creates a program from the cached binary, returns 0 when there is no usable entry
+	GLuint Load(uint64_t key);
+	// Saves the binary of a freshly linked program together with the time it took to build
+	void Store(uint64_t key, GLuint program, double buildMs);
+	// Must be called before linking so the driver keeps the binary retrievable
+	void PrepareForLink(GLuint program) const;
+
+	// Prints hit/miss counts and the compile time the hits saved
+	void PrintStats() const;
+
+private:
+	// Vendor, renderer and version strings of the current driver
+	std::string driverId;
+
+	std::string PathFor(uint64_t key) const;
+};
@@ -0,0 +1,141 @@
+#include"RenderQueue.h"
+#include"GLExtensions.h"
+#include<algorithm>
+
+// Starts a frame: forgets the previous packets and sets the view used for depth keys
+void RenderQueue::Begin(const glm::mat4& view, float farPlane)
+{
+	this->view = view;
+	this->farPlane = farPlane;
+	packets.clear();
+	entries.clear();
+	programChanges = textureChanges = vertexArrayChanges = 0;
+}
+
+// Adds a packet to the given pass
+void RenderQueue::Submit(RenderPass pass, const DrawPacket& packet)
+{
+	entries.push_back({ makeKey(pass, packet), (uint32_t)packets.size() });
+	packets.push_back(packet);
+}
+
+// Builds the sort key of a packet
+uint64_t RenderQueue::makeKey(RenderPass pass, const DrawPacket& packet) const
+{
+	// View space distance of the object origin, quantized to 24 bits
+	float distance = -(view * packet.model[3]).z;
+	float normalized = std::min(std::max(distance / farPlane, 0.0f), 1.0f);
+	uint64_t depth = (uint64_t)(normalized * 0xFFFFFF);
+
+	uint64_t program = (packet.shader ? packet.shader->ID : 0) & 0x3FF;
+	uint64_t texture = packet.texture & 0xFFF;
+	uint64_t vao = packet.vao & 0xFFF;
+	uint64_t state = program << 24 | texture << 12 | vao;
+
+	if (pass == BLENDED_PASS)
+		return (uint64_t)pass << 62 | (0xFFFFFF - depth) << 34 | state;
+	return (uint64_t)pass << 62 | state << 24 | depth;
+}
+
+// Radix sorts all packets by key
+void RenderQueue::Sort()
+{
+	// LSD radix sort, 8 bits per pass. Passes where every key has the same byte are
+	// skipped, which with few programs/textures/VAOs is most of them.
+	scratch.resize(entries.size());
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {};
+		for (const SortEntry& entry : entries)
+			counts[(entry.key >> shift) & 0xFF]++;
+		if (counts[(entries.empty() ? 0 : entries[0].key >> shift) & 0xFF] == entries.size())
+			continue;
+
+		size_t offset = 0;
+		for (size_t& count : counts)
+		{
+			size_t bucket = count;
+			count = offset;
+			offset += bucket;
+		}
+		for (const SortEntry& entry : entries)
+			scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+		entries.swap(scratch);
+	}
+}
+
+// Draws the packets of one pass in sorted order (Sort must have been called)
+void RenderQueue::Draw(RenderPass pass, RingBuffer& objects)
+{
+	drawPass(pass, objects, nullptr);
+}
+
+// Draws the same packets for a depth pre-pass: depth-only siblings of the scene variants,
+// no texture binds (color writes are masked by the caller)
+void RenderQueue::DrawDepth(RenderPass pass, RingBuffer& objects, ShaderVariants& variants)
+{
+	drawPass(pass, objects, &variants);
+}
+
+// Draws one pass, with the depth-only programs of depthVariants when it is not null
+void RenderQueue::drawPass(RenderPass pass, RingBuffer& objects, ShaderVariants* depthVariants)
+{
+	// Entries are sorted by pass first, so the pass is one contiguous range
+	auto first = std::lower_bound(entries.begin(), entries.end(), (uint64_t)pass << 62,
+		[](const SortEntry& entry, uint64_t key) { return entry.key < key; });
+
+	if (pass == BLENDED_PASS && !depthVariants)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+
+	Shader* currentShader = nullptr;
+	GLuint currentTexture = 0, currentVAO = 0;
+	glState.ActiveTexture(GL_TEXTURE0);
+	for (auto entry = first; entry != entries.end() && (entry->key >> 62) == (uint64_t)pass; ++entry)
+	{
+		const DrawPacket& packet = packets[entry->packet];
+		Shader* shader = depthVariants ? &depthVariants->DepthOnly(*packet.shader) : packet.shader;
+		if (shader != currentShader)
+		{
+			currentShader = shader;
+			currentShader->Activate();
+			programChanges++;
+		}
+		if (packet.texture != 0 && packet.texture != currentTexture && !depthVariants)
+		{
+			currentTexture = packet.texture;
+			glState.BindTexture(GL_TEXTURE_2D, currentTexture);
+			textureChanges++;
+		}
+		if (packet.vao != currentVAO)
+		{
+			currentVAO = packet.vao;
+			glState.BindVertexArray(currentVAO);
+			vertexArrayChanges++;
+		}
+		if (packet.objectData)
+			RingBuffer::BindUniform(OBJECT_BLOCK_BINDING, objects.Write(ObjectBlock{ packet.model }));
+
+		// Without waiting, the draw still happens when the query has not finished yet
+		if (packet.conditionQuery)
+			glBeginConditionalRender(packet.conditionQuery, GL_QUERY_NO_WAIT);
+
+		if (packet.indexed && packet.instanceCount > 0 && packet.baseInstance > 0)
+			glExt.DrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, (void*)(packet.first * sizeof(GLuint)), packet.instanceCount, packet.baseVertex, packet.baseInstance);
+		else if (packet.indexed && packet.instanceCount > 0)
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, (void*)(packet.first * sizeof(GLuint)), packet.instanceCount, packet.baseVertex);
+		else if (packet.indexed)
+			glDrawElementsBaseVertex(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, (void*)(packet.first * sizeof(GLuint)), packet.baseVertex);
+		else if (packet.instanceCount > 0)
+			glDrawArraysInstanced(GL_TRIANGLES, packet.first, packet.count, packet.instanceCount);
+		else
+			glDrawArrays(GL_TRIANGLES, packet.first, packet.count);
+		if (packet.conditionQuery)
+			glEndConditionalRender();
+	}
+
+	if (pass == BLENDED_PASS && !depthVariants)
+		glDisable(GL_BLEND);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstdint>
+
+#include"Shader.h"
+#include"GLState.h"
+#include"RingBuffer.h"
+#include"UniformBlocks.h"
+#include"ShaderVariants.h"
+
+// Passes are drawn in this order; the pass is the top of the sort key.
+// OCCLUSION_TESTED_PASS holds opaque objects drawn after the occlusion queries of the frame.
+enum RenderPass { OPAQUE_PASS, OCCLUSION_TESTED_PASS, BLENDED_PASS };
+
+// Everything needed to issue one draw call
+struct DrawPacket
+{
+	Shader* shader = nullptr;
+	// Written to the ObjectData block before drawing unless objectData is false
+	// (instanced variants read their own transforms)
+	bool objectData = true;
+	glm::mat4 model = glm::mat4(1.0f);
+	// GL_TEXTURE_2D bound to unit 0, 0 leaves the current texture bound
+	GLuint texture = 0;
+	GLuint vao = 0;
+	// glDrawElements (indexed) or glDrawArrays range
+	bool indexed = true;
+	GLint first = 0;
+	GLsizei count = 0;
+	// Added to every index of an indexed draw (meshes sharing a GeometryArena)
+	GLint baseVertex = 0;
+	// Non-zero draws that many instances with one instanced call
+	GLsizei instanceCount = 0;
+	// First instance of an indexed instanced draw in the instance buffer (needs glExt.baseInstance)
+	GLuint baseInstance = 0;
+	// Non-zero wraps the draw in glBeginConditionalRender on this GL_ANY_SAMPLES_PASSED query
+	GLuint conditionQuery = 0;
+};
+
+// Collects draw packets for a frame, sorts them by a packed 64-bit key and submits
+// them with as few state changes as possible.
+//
+// Key layout, most significant bits first:
+//   opaque (and occlusion tested):  pass(2) | program(10) | texture(12) | vao(12) | depth(24) front-to-back
+//   blended:                        pass(2) | depth(24) back-to-front | program(10) | texture(12) | vao(12)
+// Object names are truncated to their field widths; a collision only costs a
+// state change, every packet still binds its own state.
+class RenderQueue
+{
+public:
+	// Starts a frame: forgets the previous packets and sets the view used for depth keys
+	void Begin(const glm::mat4& view, float farPlane);
+	// Adds a packet to the given pass
+	void Submit(RenderPass pass, const DrawPacket& packet);
+	// Radix sorts all packets by key
+	void Sort();
+	// Draws the packets of one pass in sorted order (Sort must have been called); model
+	// matrices go to this frame's section of the ring buffer
+	void Draw(RenderPass pass, RingBuffer& objects);
+	// Draws the same packets for a depth pre-pass: depth-only siblings of the scene variants,
+	// no texture binds (color writes are masked by the caller)
+	void DrawDepth(RenderPass pass, RingBuffer& objects, ShaderVariants& variants);
+
+	// Number of packets submitted this frame
+	size_t Size() const { return packets.size(); }
+	// State changes made by the last Draw calls of this frame
+	unsigned ProgramChanges() const { return programChanges; }
+	unsigned TextureChanges() const { return textureChanges; }
+	unsigned VertexArrayChanges() const { return vertexArrayChanges; }
+
+private:
+	// Key plus index of the packet it belongs to
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	std::vector<DrawPacket> packets;
+	// Sorted entries and the scratch buffer of the radix sort, kept between frames
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	glm::mat4 view = glm::mat4(1.0f);
+	float farPlane = 100.0f;
+
+	unsigned programChanges = 0;
+	unsigned textureChanges = 0;
+	unsigned vertexArrayChanges = 0;
+
+	// Builds the sort key of a packet
+	uint64_t makeKey(RenderPass pass, const DrawPacket& packet) const;
+	// Draws one pass, with the depth-only programs of depthVariants when it is not null
+	void drawPass(RenderPass pass, RingBuffer& objects, ShaderVariants* depthVariants);
+};
@@ -0,0 +1,164 @@
+#include"RingBuffer.h"
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+
+// Constructor that creates the buffer with room for frameSize bytes per frame; persistent
+// false forces the map-per-write path even when buffer storage is available
+RingBuffer::RingBuffer(GLsizeiptr frameSize, bool persistent)
+	: persistent(persistent && glExt.bufferStorage)
+{
+	// Every range may be bound as a uniform block or a storage block
+	GLint uniformAlignment = 256, storageAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	if (glExt.shaderStorage)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+	alignment = std::max<GLsizeiptr>({ uniformAlignment, storageAlignment, 16 });
+	allocate(frameSize);
+	// The first BeginFrame moves to section 0
+	section = FramesInFlight - 1;
+}
+
+// Moves to the next section, waiting for the GPU to finish the frame that last used it
+void RingBuffer::BeginFrame()
+{
+	// Everything bound last frame has been submitted, so replaced buffers can go
+	for (GLuint old : retired)
+	{
+		glState.ForgetBuffer(old);
+		glDeleteBuffers(1, &old);
+	}
+	retired.clear();
+
+	section = (section + 1) % FramesInFlight;
+	used = 0;
+	frameBytes = 0;
+	frames++;
+	GLsync fence = fences[section];
+	if (!fence)
+		return;
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		// The GPU is FramesInFlight frames behind: wait, flushing so the fence can signal
+		waits++;
+		auto start = std::chrono::steady_clock::now();
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+		std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - start;
+		waitMilliseconds += waited.count();
+	}
+	glDeleteSync(fence);
+	fences[section] = nullptr;
+}
+
+// Fences the commands that read this frame's section
+void RingBuffer::EndFrame()
+{
+	if (fences[section])
+		glDeleteSync(fences[section]);
+	fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	largestFrame = std::max(largestFrame, frameBytes);
+}
+
+// Copies data into this frame's section at an offset usable for uniform and storage
+// buffer bindings. A full section doubles the buffer; ranges written before stay valid.
+RingBuffer::Range RingBuffer::Write(const void* data, GLsizeiptr size)
+{
+	GLsizeiptr offset = (used + alignment - 1) / alignment * alignment;
+	if (offset + size > sectionSize)
+	{
+		GLsizeiptr newSectionSize = sectionSize * 2;
+		while (newSectionSize < size)
+			newSectionSize *= 2;
+		allocate(newSectionSize);
+		grows++;
+		offset = 0;
+	}
+	used = offset + size;
+	frameBytes += (size + alignment - 1) / alignment * alignment;
+
+	GLintptr start = section * sectionSize + offset;
+	if (mapped)
+		memcpy(mapped + start, data, size);
+	else
+	{
+		// The fences guarantee the GPU is done with this range, so the driver need not check
+		glState.BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		memcpy(target, data, size);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	return { buffer, start, size };
+}
+
+// glBindBufferRange of a written range to a uniform block binding point
+void RingBuffer::BindUniform(GLuint binding, const Range& range)
+{
+	glState.BindUniformBufferRange(binding, range.buffer, range.offset, range.size);
+}
+
+// glBindBufferRange of a written range to a shader storage block binding point
+void RingBuffer::BindStorage(GLuint binding, const Range& range)
+{
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, range.buffer, range.offset, range.size);
+}
+
+// Prints fence waits, growth and the largest frame
+void RingBuffer::PrintStats() const
+{
+	std::cout << "Ring buffer (" << (mapped ? "persistent mapping" : "map per write") << "): " << FramesInFlight << " x "
+		<< sectionSize / 1024 << " KB sections, largest frame " << largestFrame / 1024.0 << " KB, " << grows << " grows, "
+		<< waits << " fence waits in " << frames << " frames (" << waitMilliseconds << " ms)" << std::endl;
+}
+
+// Deletes the buffer and the fences
+void RingBuffer::Delete()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	retired.push_back(buffer);
+	for (GLuint old : retired)
+	{
+		glState.ForgetBuffer(old);
+		glDeleteBuffers(1, &old);
+	}
+	retired.clear();
+	mapped = nullptr;
+}
+
+// Creates (or replaces) the buffer with sections of the given size
+void RingBuffer::allocate(GLsizeiptr newSectionSize)
+{
+	// Ranges of the old buffer may already be bound for this frame; it is deleted next frame.
+	// The new buffer has never been used by the GPU, so the old fences no longer matter.
+	if (buffer)
+		retired.push_back(buffer);
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	sectionSize = (newSectionSize + alignment - 1) / alignment * alignment;
+	GLsizeiptr totalSize = sectionSize * FramesInFlight;
+	glGenBuffers(1, &buffer);
+	glState.BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (persistent)
+	{
+		// Mapped once for the lifetime of the buffer; coherent, so writes need no flush
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glExt.BufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+		mapped = nullptr;
+	}
+}
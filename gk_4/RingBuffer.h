@@ -0,0 +1,81 @@
+#pragma once
+#include<glad/glad.h>
+#include<vector>
+#include<iostream>
+
+#include"GLState.h"
+#include"GLExtensions.h"
+
+// Per-frame dynamic data (uniform blocks, draw data, indirect commands) written into one
+// buffer split into FramesInFlight sections. The CPU fills the section of frame N+1 while
+// the GPU still reads the sections of earlier frames; a fence per section makes BeginFrame
+// wait only when the GPU falls FramesInFlight frames behind, so nothing is orphaned and the
+// driver never synchronizes implicitly.
+// With GL 4.4 / GL_ARB_buffer_storage the buffer is mapped once, persistent and coherent;
+// otherwise each write maps its range with GL_MAP_UNSYNCHRONIZED_BIT (the fences keep that safe).
+class RingBuffer
+{
+public:
+	// Sections of the buffer, one per frame the GPU may still be reading
+	static const int FramesInFlight = 3;
+
+	// Part of the buffer written this frame, valid until the section comes around again
+	struct Range
+	{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	// Constructor that creates the buffer with room for frameSize bytes per frame; persistent
+	// false forces the map-per-write path even when buffer storage is available
+	RingBuffer(GLsizeiptr frameSize, bool persistent = true);
+
+	// Moves to the next section, waiting for the GPU to finish the frame that last used it
+	void BeginFrame();
+	// Fences the commands that read this frame's section
+	void EndFrame();
+
+	// Copies data into this frame's section at an offset usable for uniform and storage
+	// buffer bindings. A full section doubles the buffer; ranges written before stay valid.
+	Range Write(const void* data, GLsizeiptr size);
+	template <typename T>
+	Range Write(const T& value) { return Write(&value, sizeof(T)); }
+
+	// glBindBufferRange of a written range to a uniform block binding point
+	static void BindUniform(GLuint binding, const Range& range);
+	// glBindBufferRange of a written range to a shader storage block binding point
+	static void BindStorage(GLuint binding, const Range& range);
+
+	// True when the buffer is persistently mapped
+	bool Persistent() const { return mapped != nullptr; }
+	// Prints fence waits, growth and the largest frame
+	void PrintStats() const;
+
+	// Deletes the buffer and the fences
+	void Delete();
+
+private:
+	GLuint buffer = 0;
+	// Start of the persistent mapping, null on the map-per-write path
+	unsigned char* mapped = nullptr;
+	bool persistent;
+	GLsizeiptr sectionSize;
+	GLsizeiptr alignment = 256;
+	int section = 0;
+	GLsizeiptr used = 0;
+	// Aligned bytes written this frame, across a grow as well
+	GLsizeiptr frameBytes = 0;
+	GLsync fences[FramesInFlight] = {};
+	// Buffers replaced by a larger one this frame; ranges in them may still be bound
+	std::vector<GLuint> retired;
+
+	unsigned frames = 0;
+	unsigned waits = 0;
+	double waitMilliseconds = 0.0;
+	unsigned grows = 0;
+	GLsizeiptr largestFrame = 0;
+
+	// Creates (or replaces) the buffer with sections of the given size
+	void allocate(GLsizeiptr newSectionSize);
+};
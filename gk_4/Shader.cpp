@@ -1,4 +1,5 @@
 #include"Shader.h"
+#include<chrono>
 
 // Reads a text file and outputs a string with everything in the text file
 std::string get_file_contents(const char* filename)
@@ -18,11 +19,25 @@ std::string get_file_contents(const char* filename)
 }
 
 // Constructor that build the Shader Program from 2 different shaders
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+Shader::Shader(const char* vertexFile, const char* fragmentFile, ProgramCache* cache, const std::string& defines)
 {
 	// Read vertexFile and fragmentFile and store the strings
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	std::string vertexCode = injectDefines(get_file_contents(vertexFile), defines);
+	std::string fragmentCode = injectDefines(get_file_contents(fragmentFile), defines);
+
+	// Try the binary cache first, compiling is the slow part of startup
+	uint64_t cacheKey = 0;
+	if (cache)
+	{
+		cacheKey = cache->Key(vertexCode, fragmentCode);
+		ID = cache->Load(cacheKey);
+		if (ID != 0)
+		{
+			cacheUniforms();
+			return;
+		}
+	}
+	auto submitStart = std::chrono::steady_clock::now();
 
 	// Convert the shader source strings into character arrays
 	const char* vertexSource = vertexCode.c_str();
@@ -34,8 +49,6 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 	glShaderSource(vertexShader, 1, &vertexSource, NULL);
 	// Compile the Vertex Shader into machine code
 	glCompileShader(vertexShader);
-	// Checks if Shader compiled succesfully
-	compileErrors(vertexShader, "VERTEX");
 
 	// Create Fragment Shader Object and get its reference
 	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -43,59 +56,212 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
 	// Compile the Vertex Shader into machine code
 	glCompileShader(fragmentShader);
-	// Checks if Shader compiled succesfully
-	compileErrors(fragmentShader, "FRAGMENT");
 
 	// Create Shader Program Object and get its reference
 	ID = glCreateProgram();
 	// Attach the Vertex and Fragment Shaders to the Shader Program
 	glAttachShader(ID, vertexShader);
 	glAttachShader(ID, fragmentShader);
-	// Wrap-up/Link all the shaders together into the Shader Program
+	// Ask the driver to keep the binary around so it can be written to the cache
+	if (cache)
+		cache->PrepareForLink(ID);
+	// Wrap-up/Link all the shaders together into the Shader Program.
+	// No status is queried here, that would wait for the compile to finish.
 	glLinkProgram(ID);
-	// Checks if Shaders linked succesfully
+
+	std::chrono::duration<double, std::milli> submitTime = std::chrono::steady_clock::now() - submitStart;
+	build = { vertexShader, fragmentShader, cache, cacheKey, submitTime.count(), {} };
+	pending = true;
+}
+
+// True once the driver finished compiling and linking, never blocks
+bool Shader::IsReady() const
+{
+	if (!pending || !glExt.parallelShaderCompile)
+		return true;
+	GLint completed = GL_FALSE;
+	glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+	return completed == GL_TRUE;
+}
+
+// Waits for the build, reports errors and reads the uniform table. Called automatically on first use.
+void Shader::Finish() const
+{
+	if (!pending)
+		return;
+	pending = false;
+	auto waitStart = std::chrono::steady_clock::now();
+
+	// Checks if Shaders compiled and linked succesfully
+	compileErrors(build.vertexShader, "VERTEX");
+	compileErrors(build.fragmentShader, "FRAGMENT");
 	compileErrors(ID, "PROGRAM");
 
 	// Delete the now useless Vertex and Fragment Shader objects
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	glDeleteShader(build.vertexShader);
+	glDeleteShader(build.fragmentShader);
+
+	if (build.cache)
+	{
+		std::chrono::duration<double, std::milli> waitTime = std::chrono::steady_clock::now() - waitStart;
+		build.cache->Store(build.cacheKey, ID, build.submitMs + waitTime.count());
+	}
+
+	// Look up every uniform location once so setters never have to query the driver
+	cacheUniforms();
+
+	// Block bindings requested while the build was pending
+	for (const auto& [blockName, binding] : build.blockBindings)
+	{
+		GLuint blockIndex = glGetUniformBlockIndex(ID, blockName.c_str());
+		if (blockIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, blockIndex, binding);
+	}
+	build.blockBindings.clear();
+}
+
+// Inserts the define lines after the #version line, which has to stay first
+std::string Shader::injectDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return source;
+	size_t versionStart = source.find("#version");
+	size_t lineEnd = source.find('\n', versionStart);
+	// Defines that start with their own #version line replace the one in the file
+	if (defines.compare(0, 8, "#version") == 0 && versionStart != std::string::npos && lineEnd != std::string::npos)
+		return source.substr(0, versionStart) + defines + source.substr(lineEnd + 1);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + defines;
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+// Connects the named uniform block to a binding point, ignored when the program has no such block
+void Shader::BindUniformBlock(const char* blockName, GLuint binding)
+{
+	if (pending)
+	{
+		build.blockBindings.push_back({ blockName, binding });
+		return;
+	}
+	GLuint blockIndex = glGetUniformBlockIndex(ID, blockName);
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, blockIndex, binding);
+}
+
+// FNV-1a hash of a uniform name
+static uint32_t hashName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (; *name; name++)
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	return hash;
+}
+
+// Enumerates active uniforms with glGetActiveUniform and fills the uniform table
+void Shader::cacheUniforms() const
+{
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	// Keep the table at most half full (arrays add a second entry) so probe sequences stay short
+	size_t capacity = 16;
+	while (capacity < (size_t)count * 4)
+		capacity *= 2;
+	uniformTable.assign(capacity, UniformSlot());
+
+	std::vector<char> nameBuffer(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), length);
+		GLint location = glGetUniformLocation(ID, name.c_str());
+		// Uniforms inside uniform blocks have no location
+		if (location == -1)
+			continue;
+
+		insertUniform(name, location);
+		// Arrays are reported as "name[0]", but are usually addressed as "name"
+		if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			insertUniform(name.substr(0, name.size() - 3), location);
+	}
+}
 
+// Adds a name -> location pair to the uniform table
+void Shader::insertUniform(const std::string& name, GLint location) const
+{
+	uint32_t hash = hashName(name.c_str());
+	size_t mask = uniformTable.size() - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		if (uniformTable[i].location == -1)
+		{
+			uniformTable[i] = { hash, location, name };
+			return;
+		}
+	}
+}
+
+// Returns the location of an active uniform from the table built after linking, -1 if absent
+GLint Shader::FindUniform(const std::string& name) const
+{
+	Finish();
+	if (uniformTable.empty())
+		return -1;
+	uint32_t hash = hashName(name.c_str());
+	size_t mask = uniformTable.size() - 1;
+	for (size_t i = hash & mask; uniformTable[i].location != -1; i = (i + 1) & mask)
+	{
+		if (uniformTable[i].hash == hash && uniformTable[i].name == name)
+			return uniformTable[i].location;
+	}
+	return -1;
 }
 
 // Activates the Shader Program
 void Shader::Activate()
 {
-	glUseProgram(ID);
+	Finish();
+	glState.UseProgram(ID);
 }
 
 // Deletes the Shader Program
 void Shader::Delete()
 {
+	if (pending)
+	{
+		glDeleteShader(build.vertexShader);
+		glDeleteShader(build.fragmentShader);
+		pending = false;
+	}
 	glDeleteProgram(ID);
 }
 
 void Shader::setVec3(const std::string& name, glm::vec3 value) const
 {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform3fv(FindUniform(name), 1, &value[0]);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(FindUniform(name), value);
 }
 
 void Shader::setMatrix4(const std::string& name, const glm::mat4& matrix)
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(FindUniform(name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value)
 {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z, value.w);
+	glUniform4f(FindUniform(name), value.x, value.y, value.z, value.w);
 }
 
 // Checks if the different Shaders have compiled properly
-void Shader::compileErrors(unsigned int shader, const char* type)
+void Shader::compileErrors(unsigned int shader, const char* type) const
 {
 	// Stores status of compilation
 	GLint hasCompiled;
@@ -123,10 +289,10 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 
 void Shader::setInt(const std::string& name, int value) {
 	// Get the location of the uniform variable in the shader program
-	GLuint location = glGetUniformLocation(ID, name.c_str());
+	GLint location = FindUniform(name);
 
 	// Check if the uniform location is valid
-	if (location == GL_INVALID_INDEX) {
+	if (location == -1) {
 		std::cout << "Warning: Uniform '" << name << "' not found in shader program!" << std::endl;
 	}
 
@@ -136,5 +302,5 @@ void Shader::setInt(const std::string& name, int value) {
 
 void Shader::setBool(const std::string& name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform1i(FindUniform(name), (int)value);
 }
\ No newline at end of file
@@ -10,24 +10,68 @@
 #include<sstream>
 #include<iostream>
 #include<cerrno>
+#include<vector>
+#include<cstdint>
+
+#include"ProgramCache.h"
+#include"GLState.h"
 
 std::string get_file_contents(const char* filename);
 
+// Typed handle to a uniform location, resolved once after the program is linked.
+// Setting a value through a handle costs a single glUniform* call, no string lookup.
+template<typename T>
+struct Uniform
+{
+	GLint location = -1;
+
+	bool IsValid() const { return location != -1; }
+};
+
 class Shader
 {
 public:
 	// Reference ID of the Shader Program
 	GLuint ID;
 	
-	// Constructor that build the Shader Program from 2 different shaders
-	Shader(const char* vertexFile, const char* fragmentFile);
-	
+	// Constructor that build the Shader Program from 2 different shaders.
+	// With a cache the linked binary is reused from disk when the sources did not change.
+	// Compiling and linking is only submitted here; errors are checked when the program is first
+	// used, so constructing all programs up front lets the driver build them in the background.
+	// defines ("#define NAME VALUE" lines) are inserted into both stages right after #version.
+	Shader(const char* vertexFile, const char* fragmentFile, ProgramCache* cache = nullptr, const std::string& defines = "");
+
+	// True once the driver finished compiling and linking, never blocks
+	// (without parallel shader compile support it always returns true)
+	bool IsReady() const;
+	// Waits for the build, reports errors and reads the uniform table. Called automatically on first use.
+	void Finish() const;
+
 	// Activates the Shader Program
 	void Activate();
 
 	// Deletes the Shader Program
 	void Delete();
 
+	// Connects the named uniform block to a binding point, ignored when the program has no such block.
+	// Does not wait for a pending build, the binding is applied once it finishes.
+	void BindUniformBlock(const char* blockName, GLuint binding);
+
+	// Returns the location of an active uniform from the table built after linking, -1 if absent
+	GLint FindUniform(const std::string& name) const;
+	// Resolves a typed uniform handle, meant to be called once outside of the render loop
+	template<typename T>
+	Uniform<T> GetUniform(const std::string& name) const { return { FindUniform(name) }; }
+
+	// Setters for pre-resolved handles (the program has to be active)
+	void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const { glUniform2fv(uniform.location, 1, &value[0]); }
+	void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const { glUniform3fv(uniform.location, 1, &value[0]); }
+	void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const { glUniform4fv(uniform.location, 1, &value[0]); }
+	void set(Uniform<glm::mat4> uniform, const glm::mat4& value) const { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value)); }
+	void set(Uniform<float> uniform, float value) const { glUniform1f(uniform.location, value); }
+	void set(Uniform<int> uniform, int value) const { glUniform1i(uniform.location, value); }
+	void set(Uniform<bool> uniform, bool value) const { glUniform1i(uniform.location, (int)value); }
+
 	// Helper functions for variables setting
 	void setVec3(const std::string& name, glm::vec3 value) const;
 	void setFloat(const std::string& name, float value) const;
@@ -37,8 +81,40 @@ public:
 	void setBool(const std::string& name, bool value) const;
 
 private:
+	// Entry of the open addressing uniform table
+	struct UniformSlot
+	{
+		uint32_t hash = 0;
+		GLint location = -1;
+		std::string name;
+	};
+	// Flat hash table of active uniforms, power of two sized, linear probing
+	mutable std::vector<UniformSlot> uniformTable;
+
+	// Build state kept from submitting the program until its first use
+	struct PendingBuild
+	{
+		GLuint vertexShader = 0;
+		GLuint fragmentShader = 0;
+		ProgramCache* cache = nullptr;
+		uint64_t cacheKey = 0;
+		// Time spent issuing the compile, the wait in Finish is added to it
+		double submitMs = 0.0;
+		// Uniform block bindings requested before the build finished
+		std::vector<std::pair<std::string, GLuint>> blockBindings;
+	};
+	// Mutable so that the first lookup on a const Shader can complete the build
+	mutable bool pending = false;
+	mutable PendingBuild build;
+
 	// Checks if the different Shaders have compiled properly
-	void compileErrors(unsigned int shader, const char* type);
+	void compileErrors(unsigned int shader, const char* type) const;
+	// Enumerates active uniforms with glGetActiveUniform and fills the uniform table
+	void cacheUniforms() const;
+	// Adds a name -> location pair to the uniform table
+	void insertUniform(const std::string& name, GLint location) const;
+	// Inserts the define lines after the #version line, which has to stay first
+	static std::string injectDefines(const std::string& source, const std::string& defines);
 };
 
 
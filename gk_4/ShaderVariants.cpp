@@ -0,0 +1,94 @@
+#include"ShaderVariants.h"
+
+// Packs the options into a small integer identifying the variant
+uint32_t ShaderFeatures::Key() const
+{
+	// Two bits per option is plenty for every enum above
+	return (uint32_t)specular
+		| (uint32_t)fixedLight << 2
+		| (uint32_t)spotLight << 4
+		| (uint32_t)dirLight << 6
+		| (uint32_t)fog << 8
+		| (uint32_t)instanced << 10
+		| (uint32_t)multiDraw << 11
+		| (uint32_t)lightList << 12
+		| (uint32_t)deferred << 14
+		| (uint32_t)depthOnly << 16;
+}
+
+// Features of the depth-only program for the same geometry; the lighting options are
+// reset so every lighting variant shares one depth program
+ShaderFeatures ShaderFeatures::DepthOnly() const
+{
+	ShaderFeatures features;
+	features.instanced = instanced;
+	features.multiDraw = multiDraw;
+	features.depthOnly = true;
+	return features;
+}
+
+// "#define NAME VALUE" lines injected after the #version line (multiDraw and light lists
+// also replace #version)
+std::string ShaderFeatures::Defines() const
+{
+	std::ostringstream defines;
+	if (multiDraw || lightList != NO_LIGHT_LIST)
+		defines << "#version 430 core\n";
+	defines << "#define SPECULAR_MODEL " << specular << "\n"
+		<< "#define FIXED_LIGHT_TYPE " << fixedLight << "\n"
+		<< "#define SPOT_LIGHT_TYPE " << spotLight << "\n"
+		<< "#define DIR_LIGHT_TYPE " << dirLight << "\n"
+		<< "#define FOG_MODE " << fog << "\n"
+		<< "#define INSTANCED " << (instanced ? 1 : 0) << "\n"
+		<< "#define MULTI_DRAW " << (multiDraw ? 1 : 0) << "\n"
+		<< "#define LIGHT_LIST " << lightList << "\n"
+		<< "#define DEFERRED_STAGE " << deferred << "\n"
+		<< "#define DEPTH_ONLY " << (depthOnly ? 1 : 0) << "\n";
+	return defines.str();
+}
+
+ShaderVariants::ShaderVariants(const char* vertexFile, const char* fragmentFile, ProgramCache* cache)
+	: vertexFile(vertexFile), fragmentFile(fragmentFile), cache(cache)
+{
+}
+
+// Returns the program for the given features, submitting its build on first request
+Shader& ShaderVariants::Get(const ShaderFeatures& features)
+{
+	uint32_t key = features.Key();
+	auto found = variants.find(key);
+	if (found != variants.end())
+		return found->second;
+
+	Shader& shader = variants.emplace(key, Shader(vertexFile.c_str(), fragmentFile.c_str(), cache, features.Defines())).first->second;
+	for (const auto& [blockName, binding] : blockBindings)
+		shader.BindUniformBlock(blockName.c_str(), binding);
+	variantFeatures[&shader] = features;
+	return shader;
+}
+
+// Depth-only sibling of one of these variants (the program itself for any other program)
+Shader& ShaderVariants::DepthOnly(Shader& variant)
+{
+	auto found = variantFeatures.find(&variant);
+	if (found == variantFeatures.end())
+		return variant;
+	return Get(found->second.DepthOnly());
+}
+
+// Connects a uniform block of every variant, including ones compiled later
+void ShaderVariants::BindUniformBlock(const char* blockName, GLuint binding)
+{
+	blockBindings.push_back({ blockName, binding });
+	for (auto& [key, shader] : variants)
+		shader.BindUniformBlock(blockName, binding);
+}
+
+// Deletes every variant
+void ShaderVariants::Delete()
+{
+	for (auto& [key, shader] : variants)
+		shader.Delete();
+	variants.clear();
+	variantFeatures.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include<unordered_map>
+#include<vector>
+#include<string>
+#include<cstdint>
+
+#include"Shader.h"
+#include"LightSource.h"
+
+// Specular term of the lighting model
+enum SpecularModel { PHONG_SPECULAR, BLINN_PHONG_SPECULAR };
+
+// How the fog factor is computed, FOG_EXP is the original exponential fog
+enum FogMode { FOG_NONE, FOG_LINEAR, FOG_EXP };
+
+// Extra point and spot lights read from a storage buffer on top of the three scene lights:
+// none, every light for every fragment, or only the lights of the fragment's cluster
+enum LightList { NO_LIGHT_LIST, LIGHT_LIST_ALL, LIGHT_LIST_CLUSTERED };
+
+// Part of the scene shader that runs: all of it (forward shading), only the material
+// output into the G-buffer, or only the lighting of a G-buffer pixel (DeferredRenderer)
+enum DeferredStage { FORWARD_STAGE, GEOMETRY_STAGE, LIGHTING_STAGE };
+
+// Compile-time options of the scene shaders. Every combination is compiled into its own
+// program with matching #defines, so the shaders never branch on them per fragment.
+struct ShaderFeatures
+{
+	SpecularModel specular = PHONG_SPECULAR;
+	// Type of each of the three scene lights (fixedLight, spotLight, dirLight in the shader)
+	LightType fixedLight = POINT_LIGHT;
+	LightType spotLight = SPOT_LIGHT;
+	LightType dirLight = DIRECTIONAL_LIGHT;
+	FogMode fog = FOG_EXP;
+	// Model matrix comes from the per-instance attribute instead of the model uniform
+	bool instanced = false;
+	// Model matrix and material come from a storage buffer indexed per sub-draw of a
+	// glMultiDrawElementsIndirect call (GLSL 4.30, see MultiDrawBatch)
+	bool multiDraw = false;
+	// Dynamic lights from ClusteredLighting's storage buffers (GLSL 4.30)
+	LightList lightList = NO_LIGHT_LIST;
+	DeferredStage deferred = FORWARD_STAGE;
+	// Depth pre-pass program: transforms positions only, empty fragment shader
+	bool depthOnly = false;
+
+	// Packs the options into a small integer identifying the variant
+	uint32_t Key() const;
+	// Features of the depth-only program for the same geometry; the lighting options are
+	// reset so every lighting variant shares one depth program
+	ShaderFeatures DepthOnly() const;
+	// "#define NAME VALUE" lines injected after the #version line (multiDraw and light lists
+	// also replace #version)
+	std::string Defines() const;
+};
+
+// Lazily compiled and cached permutations of one vertex/fragment shader pair
+class ShaderVariants
+{
+public:
+	ShaderVariants(const char* vertexFile, const char* fragmentFile, ProgramCache* cache = nullptr);
+
+	// Returns the program for the given features, submitting its build on first request
+	Shader& Get(const ShaderFeatures& features);
+	// Connects a uniform block of every variant, including ones compiled later
+	void BindUniformBlock(const char* blockName, GLuint binding);
+	// Depth-only sibling of one of these variants (the program itself for any other program)
+	Shader& DepthOnly(Shader& variant);
+
+	// Number of variants built so far
+	size_t Count() const { return variants.size(); }
+
+	// Deletes every variant
+	void Delete();
+
+private:
+	std::string vertexFile;
+	std::string fragmentFile;
+	ProgramCache* cache;
+	std::unordered_map<uint32_t, Shader> variants;
+	// Features each variant was built with
+	std::unordered_map<const Shader*, ShaderFeatures> variantFeatures;
+	// Block bindings applied to new variants
+	std::vector<std::pair<std::string, GLuint>> blockBindings;
+};
@@ -11,12 +11,20 @@ Texture::Texture(const char* image, GLenum texType, GLenum slot, GLenum format,
 	stbi_set_flip_vertically_on_load(true);
 	// Reads the image from a file and stores it in bytes
 	unsigned char* bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
+	// Missing images fall back to a single white texel instead of uploading garbage sizes
+	unsigned char whiteTexel[4] = { 255, 255, 255, 255 };
+	if (!bytes)
+	{
+		std::cout << "Failed to load texture " << image << ", using white fallback" << std::endl;
+		widthImg = heightImg = 1;
+		format = GL_RGBA;
+	}
 
 	// Generates an OpenGL texture object
 	glGenTextures(1, &ID);
 	// Assigns the texture to a Texture Unit
-	glActiveTexture(slot);
-	glBindTexture(texType, ID);
+	glState.ActiveTexture(slot);
+	glState.BindTexture(texType, ID);
 
 	// Configures the type of algorithm that is used to make the image smaller or bigger
 	glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
@@ -27,21 +35,22 @@ Texture::Texture(const char* image, GLenum texType, GLenum slot, GLenum format,
 	glTexParameteri(texType, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 	// Assigns the image to the OpenGL Texture object
-	glTexImage2D(texType, 0, GL_RGBA, widthImg, heightImg, 0, format, pixelType, bytes);
+	glTexImage2D(texType, 0, GL_RGBA, widthImg, heightImg, 0, format, pixelType, bytes ? bytes : whiteTexel);
 	// Generates MipMaps
 	glGenerateMipmap(texType);
 
 	// Deletes the image data as it is already in the OpenGL Texture object
-	stbi_image_free(bytes);
+	if (bytes)
+		stbi_image_free(bytes);
 
 	// Unbinds the OpenGL Texture object so that it can't accidentally be modified
-	glBindTexture(texType, 0);
+	glState.BindTexture(texType, 0);
 }
 
 void Texture::texUnit(Shader& shader, const char* uniform, GLuint unit)
 {
 	// Gets the location of the uniform
-	GLuint texUni = glGetUniformLocation(shader.ID, uniform);
+	GLint texUni = shader.FindUniform(uniform);
 	// Shader needs to be activated before changing the value of a uniform
 	shader.Activate();
 	// Sets the value of the uniform
@@ -50,15 +59,16 @@ void Texture::texUnit(Shader& shader, const char* uniform, GLuint unit)
 
 void Texture::Bind()
 {
-	glBindTexture(type, ID);
+	glState.BindTexture(type, ID);
 }
 
 void Texture::Unbind()
 {
-	glBindTexture(type, 0);
+	glState.BindTexture(type, 0);
 }
 
 void Texture::Delete()
 {
+	glState.ForgetTexture(ID);
 	glDeleteTextures(1, &ID);
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include"ThreadPool.h"
+#include<algorithm>
+
+// Starts threadCount workers (0: one less than the hardware threads, the caller is the last)
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	workers.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+// Starts the loop, takes chunks on the calling thread and waits for the workers
+void ThreadPool::run(size_t itemCount, size_t grain, TaskFunction loopTask, void* loopContext)
+{
+	if (itemCount == 0)
+		return;
+	// About four chunks per thread, so a slow thread does not hold up the others for long
+	size_t size = std::max(std::max(grain, (size_t)1), (itemCount + Threads() * 4 - 1) / (Threads() * 4));
+	size_t chunks = (itemCount + size - 1) / size;
+	if (workers.empty() || chunks == 1)
+	{
+		loopTask(loopContext, 0, itemCount);
+		return;
+	}
+
+	std::lock_guard<std::mutex> loopLock(loopMutex);
+	{
+		// A worker that woke up late may still be looking at the previous loop
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this] { return busyWorkers == 0; });
+		task = loopTask;
+		context = loopContext;
+		count = itemCount;
+		chunkSize = size;
+		chunkCount = chunks;
+		nextChunk = 0;
+		generation++;
+	}
+	wake.notify_all();
+	runChunks();
+
+	// Every chunk has been taken; the ones workers took are done once they all left the loop
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+// Takes and runs chunks of the current loop until none are left
+void ThreadPool::runChunks()
+{
+	for (;;)
+	{
+		size_t chunk = nextChunk.fetch_add(1);
+		if (chunk >= chunkCount)
+			return;
+		size_t begin = chunk * chunkSize;
+		task(context, begin, std::min(count, begin + chunkSize));
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned joined = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [&] { return stopping || generation != joined; });
+		if (stopping)
+			return;
+		joined = generation;
+		busyWorkers++;
+		lock.unlock();
+		runChunks();
+		lock.lock();
+		if (--busyWorkers == 0)
+			finished.notify_all();
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<vector>
+#include<cstddef>
+#include<type_traits>
+
+// Fixed set of worker threads that run one parallel loop at a time. ParallelFor splits
+// [0, count) into chunks of at least grain items; the workers and the calling thread take
+// chunks until none are left, and the call returns when all of them are done. Nothing is
+// allocated per loop, the task is called through a plain function pointer.
+class ThreadPool
+{
+public:
+	// Starts threadCount workers (0: one less than the hardware threads, the caller is the last)
+	ThreadPool(unsigned threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Threads a loop runs on, the caller included
+	unsigned Threads() const { return (unsigned)workers.size() + 1; }
+
+	// Calls task(begin, end) over chunks covering [0, count) and waits for all of them
+	template<typename Task>
+	void ParallelFor(size_t count, size_t grain, Task&& task)
+	{
+		using TaskType = std::remove_reference_t<Task>;
+		run(count, grain, [](void* context, size_t begin, size_t end) { (*(TaskType*)context)(begin, end); }, (void*)&task);
+	}
+
+private:
+	using TaskFunction = void(*)(void*, size_t, size_t);
+
+	std::vector<std::thread> workers;
+	// Serializes loops started from different threads
+	std::mutex loopMutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	bool stopping = false;
+	// Incremented for every loop, workers join each loop once
+	unsigned generation = 0;
+	// Workers still taking chunks of the current loop
+	unsigned busyWorkers = 0;
+
+	// Current loop
+	TaskFunction task = nullptr;
+	void* context = nullptr;
+	size_t count = 0;
+	size_t chunkSize = 0;
+	size_t chunkCount = 0;
+	std::atomic<size_t> nextChunk{ 0 };
+
+	// Starts the loop, takes chunks on the calling thread and waits for the workers
+	void run(size_t count, size_t grain, TaskFunction task, void* context);
+	// Takes and runs chunks of the current loop until none are left
+	void runChunks();
+	void workerLoop();
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include<glm/glm.hpp>
+
+// C++ mirrors of the std140 uniform blocks declared in the shaders.
+// Member order is chosen so every vec3 is followed by a scalar, which makes
+// the std140 layout identical to the tightly packed C++ layout.
+
+// Binding points shared by every program
+enum UniformBlockBinding
+{
+	FRAME_BLOCK_BINDING = 0,
+	LIGHT_BLOCK_BINDING = 1,
+	OBJECT_BLOCK_BINDING = 2
+};
+
+// layout(std140) uniform FrameData: camera and fog state, written once per frame (per view)
+struct FrameBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 camMatrix;
+	glm::vec3 cameraPos;
+	float fogStart;
+	glm::vec3 fogColor;
+	float fogEnd;
+};
+static_assert(sizeof(FrameBlock) == 224, "FrameBlock must match the std140 FrameData block");
+
+// struct Light in the shaders
+struct LightBlock
+{
+	glm::vec3 position;
+	float cutOff;
+	glm::vec3 color;
+	float outerCutOff;
+	glm::vec3 direction;
+	int type;
+};
+static_assert(sizeof(LightBlock) == 48, "LightBlock must match the std140 Light struct");
+
+// layout(std140) uniform LightData: the scene lights, written once per frame
+struct LightsBlock
+{
+	LightBlock fixedLight;
+	LightBlock spotLight;
+	LightBlock dirLight;
+};
+static_assert(sizeof(LightsBlock) == 144, "LightsBlock must match the std140 LightData block");
+
+// layout(std140) uniform ObjectData: model matrix of one draw, written per draw
+struct ObjectBlock
+{
+	glm::mat4 model;
+};
+static_assert(sizeof(ObjectBlock) == 64, "ObjectBlock must match the std140 ObjectData block");
@@ -6,29 +6,52 @@ VAO::VAO()
 	glGenVertexArrays(1, &ID);
 }
 
-// Links a VBO Attribute such as a position or color to the VAO
-void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset)
+// Links the attributes of a vertex layout, interleaved in the VBO, to the VAO
+// (the VBO stays bound)
+void VAO::LinkLayout(VBO& VBO, const VertexLayoutView& layout)
 {
 	VBO.Bind();
-	glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
+	layout.LinkInterleaved();
+}
+
+// Links per-instance model matrices to locations layout .. layout + 3 (one vec4 column each)
+void VAO::LinkInstanceTransforms(InstanceBuffer& instances, GLuint layout)
+{
+	instances.Bind();
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(layout + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(layout + column);
+		// Advance once per instance instead of once per vertex
+		glVertexAttribDivisor(layout + column, 1);
+	}
+}
+
+// Links an unsigned integer per instance (divisor 1) to the location; with baseInstance
+// this gives every sub-draw of a multi-draw its own index
+void VAO::LinkInstanceIndex(VBO& VBO, GLuint layout)
+{
+	VBO.Bind();
+	glVertexAttribIPointer(layout, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
 	glEnableVertexAttribArray(layout);
-	VBO.Unbind();
+	glVertexAttribDivisor(layout, 1);
 }
 
 // Binds the VAO
 void VAO::Bind()
 {
-	glBindVertexArray(ID);
+	glState.BindVertexArray(ID);
 }
 
 // Unbinds the VAO
 void VAO::Unbind()
 {
-	glBindVertexArray(0);
+	glState.BindVertexArray(0);
 }
 
 // Deletes the VAO
 void VAO::Delete()
 {
+	glState.ForgetVertexArray(ID);
 	glDeleteVertexArrays(1, &ID);
 }
\ No newline at end of file
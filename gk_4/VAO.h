@@ -1,7 +1,10 @@
 #pragma once
 
 #include<glad/glad.h>
+#include"GLState.h"
 #include"VBO.h"
+#include"InstanceBuffer.h"
+#include"VertexLayout.h"
 
 class VAO
 {
@@ -11,8 +14,13 @@ public:
 	// Constructor that generates a VAO ID
 	VAO();
 
-	// Links a VBO Attribute such as a position or color to the VAO
-	void LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);
+	// Links the attributes of a vertex layout, interleaved in the VBO, to the VAO
+	void LinkLayout(VBO& VBO, const VertexLayoutView& layout);
+	// Links per-instance model matrices to locations layout .. layout + 3 (one vec4 column each)
+	void LinkInstanceTransforms(InstanceBuffer& instances, GLuint layout);
+	// Links an unsigned integer per instance (divisor 1) to the location; with baseInstance
+	// this gives every sub-draw of a multi-draw its own index
+	void LinkInstanceIndex(VBO& VBO, GLuint layout);
 	// Binds the VAO
 	void Bind();
 	// Unbinds the VAO
@@ -4,24 +4,25 @@
 VBO::VBO(GLfloat* vertices, GLsizeiptr size)
 {
 	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glState.BindBuffer(GL_ARRAY_BUFFER, ID);
 	glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
 // Binds the VBO
 void VBO::Bind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glState.BindBuffer(GL_ARRAY_BUFFER, ID);
 }
 
 // Unbinds the VBO
 void VBO::Unbind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glState.BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 // Deletes the VBO
 void VBO::Delete()
 {
+	glState.ForgetBuffer(ID);
 	glDeleteBuffers(1, &ID);
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include"VertexFormat.h"
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/packing.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<cmath>
+
+// Matrix taking packed positions (after normalization) to the mesh's local space
+glm::mat4 VertexQuantization::Decode() const
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), bias), glm::vec3(scale));
+}
+
+// Keeps the largest of both errors
+void VertexQuantization::Accumulate(const VertexQuantization& other)
+{
+	positionError = std::max(positionError, other.positionError);
+	normalError = std::max(normalError, other.normalError);
+	texCoordError = std::max(texCoordError, other.texCoordError);
+}
+
+// Bytes per vertex of a format
+GLsizei VertexSize(VertexFormat format)
+{
+	return FormatLayout(format).stride;
+}
+
+// "float" or "packed"
+const char* VertexFormatName(VertexFormat format)
+{
+	return format == VERTEX_PACKED ? "packed" : "float";
+}
+
+// Parses a format name, false if it is neither
+bool ParseVertexFormat(const std::string& name, VertexFormat& format)
+{
+	if (name == "float")
+		format = VERTEX_FLOAT;
+	else if (name == "packed")
+		format = VERTEX_PACKED;
+	else
+		return false;
+	return true;
+}
+
+// Rounds a value in [-1, 1] to a signed normalized integer with the given largest value
+static int Snorm(float value, int maxValue)
+{
+	return (int)std::lround(std::clamp(value, -1.0f, 1.0f) * maxValue);
+}
+
+// Packs vertexCount Object layout vertices (11 floats each) and measures the error by decoding
+// them again the way GL does (normalized shorts as c / 32767, 10-bit normals as c / 511)
+VertexQuantization PackVertices(const GLfloat* vertices, size_t vertexCount, PackedVertex* packed)
+{
+	VertexQuantization quantization;
+	if (vertexCount == 0)
+		return quantization;
+
+	// The box of the mesh is mapped to [-1, 1] along its longest axis
+	glm::vec3 low(vertices[0], vertices[1], vertices[2]), high = low;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		glm::vec3 position = glm::make_vec3(vertices + i * 11);
+		low = glm::min(low, position);
+		high = glm::max(high, position);
+	}
+	glm::vec3 halfExtent = 0.5f * (high - low);
+	quantization.bias = 0.5f * (low + high);
+	quantization.scale = std::max(std::max(halfExtent.x, halfExtent.y), halfExtent.z);
+	if (quantization.scale <= 0.0f)
+		quantization.scale = 1.0f;
+
+	float minNormalCos = 1.0f;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = vertices + i * 11;
+		PackedVertex& out = packed[i];
+
+		glm::vec3 position = glm::make_vec3(vertex);
+		glm::vec3 local = (position - quantization.bias) / quantization.scale;
+		for (int axis = 0; axis < 3; axis++)
+			out.position[axis] = (GLshort)Snorm(local[axis], 32767);
+		out.position[3] = 0;
+		glm::vec3 decoded = quantization.bias + quantization.scale * glm::vec3(out.position[0], out.position[1], out.position[2]) / 32767.0f;
+		glm::vec3 difference = glm::abs(decoded - position);
+		quantization.positionError = std::max(quantization.positionError, std::max(std::max(difference.x, difference.y), difference.z));
+
+		// x in the low bits, w (2 bits) unused
+		glm::vec3 normal = glm::make_vec3(vertex + 8);
+		float length = glm::length(normal);
+		normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+		int components[3];
+		for (int axis = 0; axis < 3; axis++)
+			components[axis] = Snorm(normal[axis], 511);
+		out.normal = (GLuint)(components[0] & 0x3FF) | ((GLuint)(components[1] & 0x3FF) << 10) | ((GLuint)(components[2] & 0x3FF) << 20);
+		glm::vec3 decodedNormal = glm::normalize(glm::vec3(components[0], components[1], components[2]) / 511.0f);
+		minNormalCos = std::min(minNormalCos, glm::dot(normal, decodedNormal));
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			out.texCoord[axis] = glm::packHalf1x16(vertex[6 + axis]);
+			float error = std::abs(glm::unpackHalf1x16(out.texCoord[axis]) - vertex[6 + axis]);
+			quantization.texCoordError = std::max(quantization.texCoordError, error);
+		}
+	}
+	quantization.normalError = glm::degrees(std::acos(std::clamp(minNormalCos, -1.0f, 1.0f)));
+	return quantization;
+}
+
+// Vertex layout of a format: ObjectLayout or PackedLayout
+VertexLayoutView FormatLayout(VertexFormat format)
+{
+	return format == VERTEX_PACKED ? PackedLayout::View() : ObjectLayout::View();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<string>
+#include"VertexLayout.h"
+
+// Vertex layouts a GeometryArena can store its meshes in
+//   VERTEX_FLOAT   44 bytes: position, color, texCoord, normal as 11 floats (ObjectLayout)
+//   VERTEX_PACKED  16 bytes: position as 3 normalized shorts (plus one of padding) relative to
+//                  a per-mesh box, normal as GL_INT_2_10_10_10_REV, texCoord as 2 half floats;
+//                  the color is dropped, no shader reads it
+enum VertexFormat { VERTEX_FLOAT, VERTEX_PACKED };
+
+// One VERTEX_PACKED vertex
+struct PackedVertex
+{
+	GLshort position[4];
+	GLuint normal;
+	GLhalf texCoord[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be 16 bytes");
+
+// Attributes of a PackedVertex, at the locations default.vert reads them from
+using PackedLayout = VertexLayout<PackedPosition, PackedNormal, HalfTexCoord>;
+static_assert(PackedLayout::Stride == sizeof(PackedVertex)
+	&& PackedLayout::OffsetOf<PackedNormal>() == offsetof(PackedVertex, normal)
+	&& PackedLayout::OffsetOf<HalfTexCoord>() == offsetof(PackedVertex, texCoord),
+	"PackedLayout must match PackedVertex");
+
+// How a mesh was quantized and the largest error it introduced
+struct VertexQuantization
+{
+	// Decoded position = bias + scale * packed position; the scale is the same on every axis,
+	// so the decode can be folded into the model matrix without bending normals
+	glm::vec3 bias = glm::vec3(0.0f);
+	float scale = 1.0f;
+	float positionError = 0.0f;
+	// Angle between the original and the decoded normal, in degrees
+	float normalError = 0.0f;
+	float texCoordError = 0.0f;
+
+	// Matrix taking packed positions (after normalization) to the mesh's local space
+	glm::mat4 Decode() const;
+	// Keeps the largest of both errors
+	void Accumulate(const VertexQuantization& other);
+};
+
+// Bytes per vertex of a format
+GLsizei VertexSize(VertexFormat format);
+// "float" or "packed"
+const char* VertexFormatName(VertexFormat format);
+// Parses a format name, false if it is neither
+bool ParseVertexFormat(const std::string& name, VertexFormat& format);
+
+// Packs vertexCount Object layout vertices (11 floats each) and measures the error by decoding
+// them again the way GL does (normalized shorts as c / 32767, 10-bit normals as c / 511)
+VertexQuantization PackVertices(const GLfloat* vertices, size_t vertexCount, PackedVertex* packed);
+
+// Vertex layout of a format: ObjectLayout or PackedLayout
+VertexLayoutView FormatLayout(VertexFormat format);
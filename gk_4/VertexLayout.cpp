@@ -0,0 +1,87 @@
+#include"VertexLayout.h"
+#include<cstring>
+#include<iostream>
+
+// Points the attributes at the bound GL_ARRAY_BUFFER, interleaved from baseOffset
+void VertexLayoutView::LinkInterleaved(GLintptr baseOffset) const
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const VertexAttribute& attribute = attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, stride, (void*)(baseOffset + attribute.offset));
+		glEnableVertexAttribArray(attribute.location);
+	}
+}
+
+// Points every attribute at its own stream of vertexCapacity tightly packed values in the
+// bound GL_ARRAY_BUFFER; the streams follow each other in attribute order, so an
+// attribute's stream starts at vertexCapacity * its interleaved offset
+void VertexLayoutView::LinkSplit(GLsizeiptr vertexCapacity) const
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const VertexAttribute& attribute = attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.size, (void*)(vertexCapacity * attribute.offset));
+		glEnableVertexAttribArray(attribute.location);
+	}
+}
+
+// Components a float vertex input of the given GLSL type reads, 0 for other types
+static GLint FloatComponents(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT: return 1;
+	case GL_FLOAT_VEC2: return 2;
+	case GL_FLOAT_VEC3: return 3;
+	case GL_FLOAT_VEC4: return 4;
+	default: return 0;
+	}
+}
+
+// Checks the vertex inputs of a linked program against the layout: every input the program
+// reads below firstInstanceLocation needs an attribute of the same name at the same
+// location. Prints each mismatch under the given program name and returns whether there
+// were none. Waits for the program to link.
+bool VertexLayoutView::Validate(GLuint program, const char* programName, GLuint firstInstanceLocation) const
+{
+	GLint inputCount = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &inputCount);
+	bool valid = true;
+	for (GLint input = 0; input < inputCount; input++)
+	{
+		char name[64];
+		GLint arraySize = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(program, (GLuint)input, sizeof(name), nullptr, &arraySize, &type, name);
+		GLint location = glGetAttribLocation(program, name);
+		// Built-ins such as gl_VertexID have no location
+		if (location < 0 || (GLuint)location >= firstInstanceLocation)
+			continue;
+
+		size_t found = Find((GLuint)location);
+		if (found == count)
+			std::cout << "Vertex layout mismatch in " << programName << ": nothing feeds " << name << " at location " << location << std::endl;
+		else if (std::strcmp(attributes[found].name, name) != 0)
+			std::cout << "Vertex layout mismatch in " << programName << ": " << name << " at location " << location
+				<< " is fed " << attributes[found].name << std::endl;
+		else if (FloatComponents(type) == 0 || attributes[found].components < FloatComponents(type))
+			std::cout << "Vertex layout mismatch in " << programName << ": " << name << " reads more components than "
+				<< attributes[found].components << " floats" << std::endl;
+		else
+			continue;
+		valid = false;
+	}
+	return valid;
+}
+
+// Index of the attribute at a location, count if there is none
+size_t VertexLayoutView::Find(GLuint location) const
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (attributes[i].location == location)
+			return i;
+	}
+	return count;
+}
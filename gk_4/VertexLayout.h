@@ -0,0 +1,121 @@
+#pragma once
+#include<glad/glad.h>
+#include<array>
+#include<cstddef>
+#include<type_traits>
+
+// One vertex attribute as the VAO sees it
+struct VertexAttribute
+{
+	// Input the shaders read it through, at location
+	const char* name;
+	GLuint location;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	// Bytes per vertex, and bytes from the start of an interleaved vertex
+	GLsizei size;
+	GLsizei offset;
+};
+
+// Attribute semantics: the shader input they feed and how they are stored. The locations
+// are the ones default.vert declares; the color is stored by the float meshes but no
+// shader reads it.
+template<GLuint location, GLint components, GLenum type, GLboolean normalized, GLsizei size>
+struct AttributeFormat
+{
+	static constexpr GLuint Location = location;
+	static constexpr GLint Components = components;
+	static constexpr GLenum Type = type;
+	static constexpr GLboolean Normalized = normalized;
+	static constexpr GLsizei Size = size;
+};
+struct Position : AttributeFormat<0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat)> { static constexpr const char* Name = "aPos"; };
+struct Normal : AttributeFormat<1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat)> { static constexpr const char* Name = "aNormal"; };
+struct TexCoord : AttributeFormat<2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat)> { static constexpr const char* Name = "aTexCoords"; };
+struct Color : AttributeFormat<3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat)> { static constexpr const char* Name = "aColor"; };
+// Normalized shorts relative to the mesh's box, padded to 8 bytes
+struct PackedPosition : AttributeFormat<0, 3, GL_SHORT, GL_TRUE, 4 * sizeof(GLshort)> { static constexpr const char* Name = "aPos"; };
+struct PackedNormal : AttributeFormat<1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(GLuint)> { static constexpr const char* Name = "aNormal"; };
+struct HalfTexCoord : AttributeFormat<2, 2, GL_HALF_FLOAT, GL_FALSE, 2 * sizeof(GLhalf)> { static constexpr const char* Name = "aTexCoords"; };
+
+// Attributes of a layout at run time, for code that handles several layouts
+struct VertexLayoutView
+{
+	const VertexAttribute* attributes;
+	size_t count;
+	GLsizei stride;
+
+	// Points the attributes at the bound GL_ARRAY_BUFFER, interleaved from baseOffset
+	void LinkInterleaved(GLintptr baseOffset = 0) const;
+	// Points every attribute at its own stream of vertexCapacity tightly packed values in the
+	// bound GL_ARRAY_BUFFER; the streams follow each other in attribute order, so an
+	// attribute's stream starts at vertexCapacity * its interleaved offset
+	void LinkSplit(GLsizeiptr vertexCapacity) const;
+	// Checks the vertex inputs of a linked program against the layout: every input the program
+	// reads below firstInstanceLocation needs an attribute of the same name at the same
+	// location. Prints each mismatch under the given program name and returns whether there
+	// were none. Waits for the program to link.
+	bool Validate(GLuint program, const char* programName, GLuint firstInstanceLocation = 0xFFFFFFFF) const;
+	// Index of the attribute at a location, count if there is none
+	size_t Find(GLuint location) const;
+};
+
+// Vertex layout as a list of attribute types. Stride, offsets and the attribute table are
+// computed at compile time; Link emits the VAO setup.
+//   using ObjectLayout = VertexLayout<Position, Color, TexCoord, Normal>;
+//   ObjectLayout::Stride == 44, ObjectLayout::OffsetOf<Normal>() == 32
+template<typename... Attributes>
+struct VertexLayout
+{
+	static constexpr size_t Count = sizeof...(Attributes);
+	static constexpr GLsizei Stride = (Attributes::Size + ...);
+
+	// Bytes from the start of an interleaved vertex to the attribute
+	template<typename Attribute>
+	static constexpr GLsizei OffsetOf()
+	{
+		static_assert((std::is_same_v<Attribute, Attributes> || ...), "attribute is not part of the layout");
+		GLsizei offset = 0;
+		bool found = false;
+		((found = found || std::is_same_v<Attribute, Attributes>, offset += found ? 0 : Attributes::Size), ...);
+		return offset;
+	}
+
+	static constexpr std::array<VertexAttribute, Count> MakeTable()
+	{
+		std::array<VertexAttribute, Count> table{};
+		GLsizei offset = 0;
+		size_t i = 0;
+		((table[i++] = VertexAttribute{ Attributes::Name, Attributes::Location, Attributes::Components, Attributes::Type,
+			Attributes::Normalized, Attributes::Size, offset }, offset += Attributes::Size), ...);
+		return table;
+	}
+	static constexpr std::array<VertexAttribute, Count> Table = MakeTable();
+
+	static constexpr bool UniqueLocations()
+	{
+		for (size_t i = 0; i < Count; i++)
+			for (size_t j = i + 1; j < Count; j++)
+				if (Table[i].location == Table[j].location)
+					return false;
+		return true;
+	}
+	static_assert(UniqueLocations(), "two attributes of a vertex layout share a location");
+
+	static constexpr VertexLayoutView View() { return { Table.data(), Count, Stride }; }
+	// Points the attributes at the bound GL_ARRAY_BUFFER (see VertexLayoutView)
+	static void Link(GLintptr baseOffset = 0) { View().LinkInterleaved(baseOffset); }
+	static void LinkSplit(GLsizeiptr vertexCapacity) { View().LinkSplit(vertexCapacity); }
+	static bool Validate(GLuint program, const char* programName, GLuint firstInstanceLocation = 0xFFFFFFFF)
+	{
+		return View().Validate(program, programName, firstInstanceLocation);
+	}
+};
+
+// The 11-float meshes of the scene (Object, GeometryArena input)
+using ObjectLayout = VertexLayout<Position, Color, TexCoord, Normal>;
+// Positions only (light cube, occlusion boxes)
+using PositionLayout = VertexLayout<Position>;
+static_assert(ObjectLayout::Stride == 11 * sizeof(GLfloat) && ObjectLayout::OffsetOf<Normal>() == 8 * sizeof(GLfloat),
+	"ObjectLayout must match the 11-float vertex tables");
@@ -1,76 +1,163 @@
 #version 330 core
 
+// Compile-time options, injected as #defines by ShaderVariants (values match the C++ enums).
+// Defaults below reproduce the original scene when the shader is built without them.
+#define PHONG_SPECULAR 0
+#define BLINN_PHONG_SPECULAR 1
+
+#define POINT_LIGHT 0
+#define SPOT_LIGHT 1
+#define DIRECTIONAL_LIGHT 2
+
+#define FOG_NONE 0
+#define FOG_LINEAR 1
+#define FOG_EXP 2
+
+#define NO_LIGHT_LIST 0
+#define LIGHT_LIST_ALL 1
+#define LIGHT_LIST_CLUSTERED 2
+
+#define FORWARD_STAGE 0
+#define GEOMETRY_STAGE 1
+#define LIGHTING_STAGE 2
+
+#ifndef SPECULAR_MODEL
+#define SPECULAR_MODEL PHONG_SPECULAR
+#endif
+#ifndef FIXED_LIGHT_TYPE
+#define FIXED_LIGHT_TYPE POINT_LIGHT
+#endif
+#ifndef SPOT_LIGHT_TYPE
+#define SPOT_LIGHT_TYPE SPOT_LIGHT
+#endif
+#ifndef DIR_LIGHT_TYPE
+#define DIR_LIGHT_TYPE DIRECTIONAL_LIGHT
+#endif
+#ifndef FOG_MODE
+#define FOG_MODE FOG_EXP
+#endif
+#ifndef MULTI_DRAW
+#define MULTI_DRAW 0
+#endif
+#ifndef LIGHT_LIST
+#define LIGHT_LIST NO_LIGHT_LIST
+#endif
+#ifndef DEFERRED_STAGE
+#define DEFERRED_STAGE FORWARD_STAGE
+#endif
+#ifndef DEPTH_ONLY
+#define DEPTH_ONLY 0
+#endif
+
+#if DEFERRED_STAGE == LIGHTING_STAGE
+// Rebuilt per pixel from the G-buffer (DeferredRenderer) at the start of main()
+vec3 FragPos;
+vec3 Normal;
+float FogFactor;
+#else
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 in float FogFactor;
+#endif
 
+#if DEFERRED_STAGE == GEOMETRY_STAGE
+// G-buffer targets: texture color and octahedral normal
+layout(location = 0) out vec4 GAlbedo;
+layout(location = 1) out vec2 GNormal;
+#else
 out vec4 FragColor;
+#endif
 
+#if DEFERRED_STAGE == LIGHTING_STAGE
+// G-buffer of the geometry stage, read with texelFetch
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+#elif MULTI_DRAW
+// One texture unit per material (MultiDrawBatch::MaxMaterials), picked by the draw's material
+flat in uint Material;
+uniform sampler2D materialTextures[4];
+#else
 uniform sampler2D tex0;
-uniform vec3 camPos;
-uniform vec3 fogColor;
-uniform bool useBlinn; 
+#endif
 
-// Light structure definition.
+// Camera and fog state shared by all programs, updated once per frame.
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 camMatrix;
+    vec3 cameraPos;
+    float fogStart;
+    vec3 fogColor;
+    float fogEnd;
+};
+
+// Light structure definition (std140: every vec3 is packed with the following scalar).
 struct Light {
     vec3 position;
-    vec3 color;
-    vec3 direction;
     float cutOff;
+    vec3 color;
     float outerCutOff;
+    vec3 direction;
+    int type;
 };
 
-// Uniforms for different lights.
-uniform Light fixedLight;
-uniform Light spotLight;
-uniform Light dirLight;
-
-// Function to calculate lighting using either Phong or Blinn-Phong for specular highlights.
-vec3 calculateLighting(Light light, vec3 normal, vec3 viewDir)
+// Scene lights, updated once per frame.
+layout(std140) uniform LightData
 {
-    vec3 lightDir;
-    float attenuation = 1.0;
+    Light fixedLight;
+    Light spotLight;
+    Light dirLight;
+};
 
-    // Spotlight calculation
-    if (light.cutOff > 0.0) 
-    {
-        lightDir = normalize(light.position - FragPos);
-        float theta = dot(lightDir, normalize(-light.direction));
-        float epsilon = light.cutOff - light.outerCutOff;
-        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-        attenuation = intensity;
-    }
-    // Directional light
-    else if (light.direction != vec3(0.0)) 
-    {
-        lightDir = normalize(-light.direction);
-    }
-    // Point light
-    else 
-    {
-        lightDir = normalize(light.position - FragPos);
-        float distance = length(light.position - FragPos);
-        attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
-    }
+#if LIGHT_LIST != NO_LIGHT_LIST
+// Dynamic point and spot lights with a finite radius (ClusteredLighting::GPULight).
+// Bindings match ClusteredLighting::LightBinding, ClusterBinding and IndexBinding.
+struct ListLight
+{
+    vec4 positionRadius;
+    vec4 colorType;
+    vec4 directionCutOff;
+    vec4 outerCutOff;
+};
+layout(std430, binding = 1) readonly buffer LightList
+{
+    ListLight lights[];
+};
+#endif
+#if LIGHT_LIST == LIGHT_LIST_CLUSTERED
+// Froxel grid of the camera view, rebuilt every frame (ClusteredLighting::GridHeader)
+layout(std430, binding = 2) readonly buffer ClusterGrid
+{
+    mat4 clusterView;
+    vec4 clusterProjection;
+    uvec4 gridSize;       // xyz: clusters per axis, w: light count
+    vec4 depthSlicing;    // near, far, slice = floor(log(depth) * z + w)
+    uvec2 clusters[];     // first index and light count of each cluster
+};
+layout(std430, binding = 3) readonly buffer ClusterLightIndices
+{
+    uint clusterLightIndices[];
+};
+#endif
 
+// Diffuse and specular shading for a light direction, Phong or Blinn-Phong depending on SPECULAR_MODEL.
+vec3 shade(Light light, vec3 lightDir, float attenuation, vec3 normal, vec3 viewDir)
+{
     // Diffuse component.
     float diff = max(dot(normal, lightDir), 0.0);
     
-    // Specular component: choose between Phong and Blinn-Phong.
-    float spec = 0.0;
-    if (useBlinn) 
-    {
-        // Blinn-Phong: compute halfway vector.
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-    } 
-    else 
-    {
-        // Phong: use reflection vector.
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
-    }
+#if SPECULAR_MODEL == BLINN_PHONG_SPECULAR
+    // Blinn-Phong: compute halfway vector.
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+#else
+    // Phong: use reflection vector.
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+#endif
     
     // Combine ambient, diffuse, and specular.
     vec3 ambient = light.color * 0.2;
@@ -80,20 +167,206 @@ vec3 calculateLighting(Light light, vec3 normal, vec3 viewDir)
     return (ambient + diffuse + specular) * attenuation;
 }
 
+// Point light
+vec3 pointLighting(Light light, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - FragPos);
+    float distance = length(light.position - FragPos);
+    float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
+    return shade(light, lightDir, attenuation, normal, viewDir);
+}
+
+// Spotlight calculation
+vec3 spotLighting(Light light, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - FragPos);
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return shade(light, lightDir, intensity, normal, viewDir);
+}
+
+// Directional light
+vec3 directionalLighting(Light light, vec3 normal, vec3 viewDir)
+{
+    return shade(light, normalize(-light.direction), 1.0, normal, viewDir);
+}
+
+#if LIGHT_LIST != NO_LIGHT_LIST
+// Point or spot light from the light list; the window term makes it reach zero at its radius
+vec3 listLighting(ListLight listLight, vec3 normal, vec3 viewDir)
+{
+    Light light;
+    light.position = listLight.positionRadius.xyz;
+    light.color = listLight.colorType.rgb;
+    light.direction = listLight.directionCutOff.xyz;
+    light.cutOff = listLight.directionCutOff.w;
+    light.outerCutOff = listLight.outerCutOff.x;
+
+    vec3 toLight = light.position - FragPos;
+    float distance = length(toLight);
+    float falloff = distance / listLight.positionRadius.w;
+    float window = clamp(1.0 - falloff * falloff * falloff * falloff, 0.0, 1.0);
+    if (window == 0.0)
+        return vec3(0.0);
+    vec3 lightDir = toLight / distance;
+    float attenuation = window * window / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
+    if (int(listLight.colorType.w) == SPOT_LIGHT)
+    {
+        float theta = dot(lightDir, -light.direction);
+        attenuation *= clamp((theta - light.outerCutOff) / (light.cutOff - light.outerCutOff), 0.0, 1.0);
+    }
+    return shade(light, lightDir, attenuation, normal, viewDir);
+}
+#endif
+
+// Octahedral normal encoding: the unit vector is projected onto the octahedron |x|+|y|+|z| = 1,
+// whose lower half is folded over the upper one, and stored in [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return folded * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 encoded)
+{
+    vec2 e = encoded * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+    return normalize(n);
+}
+
+#if DEFERRED_STAGE == LIGHTING_STAGE
+// World position of a pixel from its depth and the FrameData matrices
+vec3 reconstructPosition(vec2 pixel, float depth)
+{
+    vec3 ndc = vec3(pixel / vec2(textureSize(gDepth, 0)), depth) * 2.0 - 1.0;
+    float viewZ = -projection[3][2] / (ndc.z + projection[2][2]);
+    vec3 viewPos = vec3(ndc.xy * -viewZ / vec2(projection[0][0], projection[1][1]), viewZ);
+    // The view matrix is rigid, so its inverse is the transposed rotation
+    return transpose(mat3(view)) * (viewPos - view[3].xyz);
+}
+
+// Per-pixel version of the fog factor default.vert computes per vertex
+float fogFactor(vec3 position)
+{
+    float distance = length(position - cameraPos);
+#if FOG_MODE == FOG_EXP
+    return clamp(exp(-0.05 * (distance - fogStart)), 0.0, 1.0);
+#elif FOG_MODE == FOG_LINEAR
+    return clamp((fogEnd - distance) / (fogEnd - fogStart), 0.0, 1.0);
+#else
+    return 1.0;
+#endif
+}
+#endif
+
+vec4 baseColor()
+{
+#if DEFERRED_STAGE == LIGHTING_STAGE
+    return texelFetch(gAlbedo, ivec2(gl_FragCoord.xy), 0);
+#elif MULTI_DRAW
+    // Constant indices only: the material is uniform per draw, but sampler arrays may not be
+    // indexed with values the compiler cannot prove dynamically uniform
+    switch (Material)
+    {
+    case 1u: return texture(materialTextures[1], TexCoords);
+    case 2u: return texture(materialTextures[2], TexCoords);
+    case 3u: return texture(materialTextures[3], TexCoords);
+    default: return texture(materialTextures[0], TexCoords);
+    }
+#else
+    return texture(tex0, TexCoords);
+#endif
+}
+
+#if DEPTH_ONLY
 void main()
 {
+    // Depth pre-pass: only the depth test and write matter
+}
+#elif DEFERRED_STAGE == GEOMETRY_STAGE
+void main()
+{
+    // Only the material is stored, lighting runs once per visible pixel in the lighting stage
+    GAlbedo = baseColor();
+    GNormal = encodeNormal(normalize(Normal));
+}
+#else
+void main()
+{
+#if DEFERRED_STAGE == LIGHTING_STAGE
+    // Pixels no geometry was drawn to keep the clear color
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float storedDepth = texelFetch(gDepth, pixel, 0).r;
+    if (storedDepth == 1.0)
+        discard;
+    FragPos = reconstructPosition(gl_FragCoord.xy, storedDepth);
+    Normal = decodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    FogFactor = fogFactor(FragPos);
+#endif
+
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(camPos - FragPos);
+    vec3 viewDir = normalize(cameraPos - FragPos);
+
+    // Sum the lighting contributions from each light source, the light types are known at compile time.
+    vec3 lighting = vec3(0.0);
+#if FIXED_LIGHT_TYPE == SPOT_LIGHT
+    lighting += spotLighting(fixedLight, norm, viewDir);
+#elif FIXED_LIGHT_TYPE == DIRECTIONAL_LIGHT
+    lighting += directionalLighting(fixedLight, norm, viewDir);
+#else
+    lighting += pointLighting(fixedLight, norm, viewDir);
+#endif
+#if SPOT_LIGHT_TYPE == SPOT_LIGHT
+    lighting += spotLighting(spotLight, norm, viewDir);
+#elif SPOT_LIGHT_TYPE == DIRECTIONAL_LIGHT
+    lighting += directionalLighting(spotLight, norm, viewDir);
+#else
+    lighting += pointLighting(spotLight, norm, viewDir);
+#endif
+#if DIR_LIGHT_TYPE == SPOT_LIGHT
+    lighting += spotLighting(dirLight, norm, viewDir);
+#elif DIR_LIGHT_TYPE == DIRECTIONAL_LIGHT
+    lighting += directionalLighting(dirLight, norm, viewDir);
+#else
+    lighting += pointLighting(dirLight, norm, viewDir);
+#endif
+
+#if LIGHT_LIST == LIGHT_LIST_CLUSTERED
+    // Only the lights binned into this fragment's cluster; fragments outside the camera grid
+    // (reflected geometry seen through the mirror) fall back to every light
+    vec4 clusterPos = clusterView * vec4(FragPos, 1.0);
+    float depth = -clusterPos.z;
+    vec2 ndc = clusterProjection.xy * clusterPos.xy / depth;
+    ivec3 cell = ivec3(floor(vec3((ndc * 0.5 + 0.5) * vec2(gridSize.xy), log(depth) * depthSlicing.z + depthSlicing.w)));
+    if (depth > depthSlicing.x && all(greaterThanEqual(cell, ivec3(0))) && all(lessThan(cell, ivec3(gridSize.xyz))))
+    {
+        uvec2 cluster = clusters[(cell.z * int(gridSize.y) + cell.y) * int(gridSize.x) + cell.x];
+        for (uint i = 0u; i < cluster.y; i++)
+            lighting += listLighting(lights[clusterLightIndices[cluster.x + i]], norm, viewDir);
+    }
+    else
+    {
+        for (uint i = 0u; i < gridSize.w; i++)
+            lighting += listLighting(lights[i], norm, viewDir);
+    }
+#elif LIGHT_LIST == LIGHT_LIST_ALL
+    for (int i = 0; i < lights.length(); i++)
+        lighting += listLighting(lights[i], norm, viewDir);
+#endif
 
-    // Sum the lighting contributions from each light source.
-    vec3 lighting = calculateLighting(fixedLight, norm, viewDir) +
-                    calculateLighting(spotLight, norm, viewDir) +
-                    calculateLighting(dirLight, norm, viewDir);
-                    
     // Apply texture and modulate with lighting.
-    vec4 objectColor = texture(tex0, TexCoords) * vec4(lighting, 1.0);
+    vec4 objectColor = baseColor() * vec4(lighting, 1.0);
     
+#if FOG_MODE == FOG_NONE
+    FragColor = objectColor;
+#else
     // Mix the object color with the fog color.
     vec3 finalColor = mix(fogColor, objectColor.rgb, FogFactor);
     FragColor = vec4(finalColor, objectColor.a);
+#endif
 }
+#endif
@@ -1,5 +1,22 @@
 #version 330 core
 
+// Fog modes, FOG_MODE is injected by ShaderVariants (see default.frag)
+#define FOG_NONE 0
+#define FOG_LINEAR 1
+#define FOG_EXP 2
+#ifndef FOG_MODE
+#define FOG_MODE FOG_EXP
+#endif
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+#ifndef MULTI_DRAW
+#define MULTI_DRAW 0
+#endif
+#ifndef DEPTH_ONLY
+#define DEPTH_ONLY 0
+#endif
+
 layout(location = 0) in vec3 aPos;       
 layout(location = 1) in vec3 aNormal;    
 layout(location = 2) in vec2 aTexCoords; 
@@ -10,13 +27,53 @@ out vec3 Normal;
 out vec2 TexCoords;  
 out float FogFactor; 
 
+// The depth pre-pass and the GL_EQUAL shading pass run different programs, which must
+// still produce bit-identical depths
+invariant gl_Position;
+
 // Uniforms
-uniform mat4 model;       
-uniform mat4 view;      
-uniform mat4 projection;  
-uniform vec3 cameraPos;  
-uniform float fogStart;
-uniform float fogEnd;   
+#if INSTANCED
+// Per-instance model matrix, locations 4-7 (Object::InstanceTransformLocation)
+layout(location = 4) in mat4 aInstanceModel;
+#define model aInstanceModel
+#elif MULTI_DRAW
+// Index of the sub-draw: instance attribute with divisor 1, offset by each command's baseInstance
+layout(location = 8) in uint aDrawIndex;
+
+// Per-draw data of MultiDrawBatch, std430 mirror of MultiDrawBatch::DrawData
+struct DrawData
+{
+    mat4 model;
+    mat4 normalMatrix;
+    uvec4 material;
+};
+layout(std430) readonly buffer DrawDataBuffer
+{
+    DrawData draws[];
+};
+#define model draws[aDrawIndex].model
+
+// Texture of the draw, selected in the fragment shader
+flat out uint Material;
+#else
+// Model matrix of the draw, written to the per-frame ring buffer (UniformBlocks.h ObjectBlock)
+layout(std140) uniform ObjectData
+{
+    mat4 model;
+};
+#endif
+
+// Camera and fog state shared by all programs, updated once per frame.
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 camMatrix;
+    vec3 cameraPos;
+    float fogStart;
+    vec3 fogColor;
+    float fogEnd;
+};
 
 void main()
 {
@@ -24,17 +81,38 @@ void main()
     vec4 worldPos = model * vec4(aPos, 1.0);
     FragPos = worldPos.xyz;
     
+    // Shading inputs, the depth pre-pass needs none of them
+#if !DEPTH_ONLY
+#if MULTI_DRAW
+    // Normal matrix is computed once per draw on the CPU
+    Normal = mat3(draws[aDrawIndex].normalMatrix) * aNormal;
+    Material = draws[aDrawIndex].material.x;
+#elif INSTANCED
+    // Instance transforms are rotation + uniform scale only, so the model matrix itself keeps
+    // normals perpendicular (the fragment shader normalizes) and no per-vertex inverse is needed
+    Normal = mat3(model) * aNormal;
+#else
     // Transform the normal vector properly to world space
     Normal = mat3(transpose(inverse(model))) * aNormal;
+#endif
     
     // Pass texture coordinates to the fragment shader
     TexCoords = aTexCoords;
     
+#if FOG_MODE == FOG_EXP
     // Compute the fog factor (exp(-density * (distance - fogStart)))
     float distance = length(FragPos - cameraPos);  // Compute distance from the camera
     float density = 0.05;  // Fog density 
     FogFactor = exp(-density * (distance - fogStart));  // Fog equation
     FogFactor = clamp(FogFactor, 0.0, 1.0);  // Clamp fog value between 0 (opaque) and 1 (clear)
+#elif FOG_MODE == FOG_LINEAR
+    // Linear fog between fogStart and fogEnd
+    float distance = length(FragPos - cameraPos);
+    FogFactor = clamp((fogEnd - distance) / (fogEnd - fogStart), 0.0, 1.0);
+#else
+    FogFactor = 1.0;
+#endif
+#endif
 
     // Compute final vertex position in clip space
     gl_Position = projection * view * worldPos;
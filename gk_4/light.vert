@@ -2,8 +2,23 @@
 
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 camMatrix;
+// Model matrix of the draw, written to the per-frame ring buffer (UniformBlocks.h ObjectBlock)
+layout(std140) uniform ObjectData
+{
+    mat4 model;
+};
+
+// Camera and fog state shared by all programs, updated once per frame.
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 camMatrix;
+    vec3 cameraPos;
+    float fogStart;
+    vec3 fogColor;
+    float fogEnd;
+};
 
 void main()
 {
@@ -7,6 +7,12 @@
 #include <cmath>
 #include <cstddef>
 #include <list>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <optional>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -24,36 +30,112 @@
 #include "LightSource.h"
 #include "Object.h"
 #include "Program.h"
+#include "Headless.h"
+#include "FrameProfiler.h"
+#include "RingBuffer.h"
+#include "UniformBlocks.h"
+#include "GLExtensions.h"
+#include "ProgramCache.h"
+#include "ShaderVariants.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "BVH.h"
+#include "BVHBenchmark.h"
+#include "MeshBenchmark.h"
+#include "MeshGenerator.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "LodSelector.h"
+#include "OcclusionCulling.h"
+#include "MultiDrawBatch.h"
+#include "GeometryArena.h"
+#include "ClusteredLighting.h"
+#include "DeferredRenderer.h"
+#include "DepthPrepass.h"
+#include "PlanarMirror.h"
+#include "VertexLayout.h"
+
+// Command line options
+struct Options
+{
+    bool headless = false;          // --headless: render offscreen with a fixed clock
+    int frameCount = 600;           // --frames N: frames recorded in headless mode
+    int warmupFrames = 10;          // --warmup N: frames rendered before recording starts
+    float timeStep = 1.0f / 60.0f;  // --timestep S: seconds of scene time per headless frame
+    std::string csvPath = "frame_times.csv"; // --csv PATH: per-frame timings output
+    std::string dumpPath;           // --dump PATH: writes the last headless frame as a PPM image
+    bool shaderCache = true;        // --no-shader-cache: always compile shaders from source
+    bool blinn = false;             // --blinn: start with Blinn-Phong instead of Phong specular
+    FogMode fog = FOG_EXP;          // --fog none|linear|exp: fog variant of the scene shader
+    int instanceCount = 0;          // --instances N: extra field of N small pyramids behind the mirror
+    bool instancing = true;         // --no-instancing: draw that field with one draw call per pyramid
+    int torusFieldCount = 0;        // --tori N: field of N tori beyond the pyramid field, each drawn at its own detail level
+    float lodPixelError = 1.0f;     // --lod-error PX: largest projected simplification error of a detail level in pixels (0: always full detail)
+    glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 2.0f);    // --camera X,Y,Z: start position
+    glm::vec3 cameraLook = glm::vec3(0.0f, 0.0f, -1.0f);  // --look X,Y,Z: point the camera starts looking at
+    bool bvh = true;                // --no-bvh: cull by testing every object instead of walking the BVH
+    bool bvhBenchmark = false;      // --bvh-benchmark: compare BVH and brute force queries, then exit
+    bool meshBenchmark = false;     // --mesh-benchmark: time the sphere and torus generators, then exit
+    bool occlusion = false;         // --occlusion: skip objects whose bounding box is hidden (hardware queries)
+    bool multiDraw = false;         // --multi-draw: draw static meshes with one glMultiDrawElementsIndirect (GL 4.3)
+    bool arena = true;              // --no-arena: draw every mesh from its own VAO instead of the shared geometry arena
+    bool persistentMap = true;      // --no-persistent-map: map the ring buffer per write instead of once (GL 4.4)
+    int dynamicLights = 0;          // --lights N: N extra moving point and spot lights over the floor (GL 4.3)
+    bool clustering = true;         // --no-clustering: shade every fragment with every dynamic light
+    bool deferred = false;          // --deferred: light the opaque objects from a G-buffer (G toggles it)
+    PrepassMode depthPrepass = PREPASS_AUTO; // --depth-prepass off|on|auto: depth-only pass before shading the opaque objects
+    VertexFormat vertexFormat = VERTEX_FLOAT; // --vertex-format float|packed: layout of the geometry arena's vertices (44 or 16 bytes)
+    bool splitStreams = false;      // --vertex-streams interleaved|split: store the arena's attributes interleaved or one stream each
+    bool cullBackFaces = true;      // --no-cull: shade the back faces of the opaque meshes too
+    bool overdrawCounter = false;   // --overdraw: count shaded fragments per pixel in the stencil buffer (reads it back)
+    float mirrorScale = 0.0f;       // --mirror-scale S: render the reflection into a texture with S texels per mirror pixel (0: straight into the scene)
+    int mirrorInterval = 1;         // --mirror-update N|motion: re-render that texture every Nth frame, or only when the camera or a reflected object moved
+};
+
+// Uniform handles of the mirror program, resolved once before the render loop.
+// Camera, fog, light and model matrices live in the uniform blocks from UniformBlocks.h instead.
+struct SceneUniforms
+{
+    Uniform<glm::vec4> mirrorColor;
+    Uniform<int> reflectionTexture;
+    Uniform<glm::mat4> reflectionTransform;
+    Uniform<glm::vec2> reflectionLimit;
+};
 
 // Function prototypes
+Options ParseOptions(int argc, char** argv);
+SceneUniforms ResolveSceneUniforms(const Shader& mirrorShader);
+void DumpFramebuffer(GLuint fbo, const std::string& path);
+
 void Cleanup(Object& pyramid, Object& cube, Object& floor, Object& sphere, Object& lightCube,
     Texture& brickTex, Texture& sphereTex, Texture& floorTex,
-    Shader& shaderProgram, Shader& lightShader, Shader& mirrorShader, GLFWwindow* window);
+    ShaderVariants& sceneShaders, Shader& lightShader, Shader& mirrorShader, GLFWwindow* window);
 
-void generateSphere(float radius, unsigned int sectorCount, unsigned int stackCount,
-    std::vector<float>& vertices, std::vector<unsigned int>& indices);
 void HandleSpotlightChange(GLFWwindow* window, LightSource& spotLight);
 
 std::tuple<Texture, Texture, Texture, Texture> SetupTextures(Shader& shaderProgram);
 
-std::tuple<LightSource, LightSource, LightSource> SetupLightSources(Shader& shaderProgram);
+std::tuple<LightSource, LightSource, LightSource> SetupLightSources();
 
-void SetFogUniforms(Shader& shaderProgram, float time, Camera camera, LightSource spotLight);
+FrameBlock MakeFrameBlock(float time, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
 
-template <size_t VSize, size_t ISize>
-std::tuple<Object, VAO> SetupObject(GLfloat(&vertices)[VSize], GLuint(&indices)[ISize]);
+void UpdatePyramidField(std::vector<glm::mat4>& transforms, float time);
+void SetupTorusField(std::vector<glm::mat4>& transforms);
 
-template <size_t VSize>
-std::tuple<Object, VAO> SetupObject(GLfloat(&vertices)[VSize]);
+std::vector<LightSource> SetupDynamicLights(int count);
+void UpdateDynamicLights(std::vector<LightSource>& lights, float time);
 
-std::tuple<Object, VAO> SetupSphere(std::vector<float>& sphereVerts, std::vector<unsigned int>& sphereInds);
+DrawPacket MakePacket(Shader& shader, const glm::mat4& model,
+    GLuint texture, GLuint vao, GLsizei count);
+DrawPacket MakePacket(Shader& shader, const glm::mat4& model,
+    GLuint texture, GLuint vao, const MeshLod& lod);
 
-std::tuple<GLuint, GLuint> SetupMirrorTexture();
+template <typename Layout = ObjectLayout>
+std::tuple<Object, VAO> SetupObject(MeshOptimizer& optimizer, MeshSimplifier& simplifier, const char* name, MeshData& mesh);
 
-void generateTorus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings,
-    std::vector<float>& vertices, std::vector<unsigned int>& indices);
+std::tuple<Object, VAO> SetupSphere(MeshOptimizer& optimizer, MeshSimplifier& simplifier, MeshData& sphereData);
 
-std::tuple<Object, VAO> SetupTorus(std::vector<float>& torusVerts, std::vector<unsigned int>& torusInds);
+std::tuple<Object, VAO> SetupTorus(MeshOptimizer& optimizer, MeshSimplifier& simplifier, MeshData& torusData);
 
 // --- Geometry Data ---
 // 
@@ -89,7 +171,8 @@ GLuint pyramidIndices[] = {
     13, 15, 14
 };
 
-// Cube vertices: 36 vertices with same layout as pyramid.
+// Cube vertices: 36 vertices with same layout as pyramid, a triangle list (welded to 24
+// indexed vertices when the mesh is optimized).
 GLfloat cubeVertices[] = {
     // Back face
     1.0f, -0.5f, -0.5f,  1,0,0,   0.0f, 0.0f,    0,0,-1,
@@ -145,7 +228,7 @@ GLfloat floorVertices[] = {
 };
 GLuint floorIndices[] = { 0, 1, 2, 0, 2, 3 };
 
-// Light cube: a small cube.
+// Light cube: a small cube, positions only (PositionLayout).
 GLfloat lightVertices[] = {
     -0.1f, -0.1f,  0.1f,
     -0.1f, -0.1f, -0.1f,
@@ -177,254 +260,967 @@ GLfloat mirrorVertices[] = {
 GLuint mirrorIndices[] = { 0, 1, 2, 0, 2, 3 };
 
 const unsigned int width = 800, height = 800;
-
-int main()
+// Starting size of the geometry arena (it grows when a mesh does not fit)
+const GLuint ArenaVertexCapacity = 8192, ArenaIndexCapacity = 32768;
+// Starting size of each frame's section of the ring buffer (it grows when a frame does not fit)
+const GLsizeiptr RingBufferFrameSize = 64 * 1024;
+// Clip planes of the camera, shared with the cluster grid
+const float NearPlane = 0.1f, FarPlane = 100.0f;
+
+int main(int argc, char** argv)
 {
+    Options options = ParseOptions(argc, argv);
+    if (options.bvhBenchmark)
+    {
+        RunBVHBenchmark();
+        return 0;
+    }
+    if (options.meshBenchmark)
+    {
+        RunMeshBenchmark();
+        return 0;
+    }
+
     // Toggle for specular model
-    static bool useBlinn = false;
-
-    // Initialize GLFW and create window.
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow* window = glfwCreateWindow(width, height, "YoutubeOpenGL", NULL, NULL);
-    if (!window)
+    static bool useBlinn = options.blinn;
+    // Toggle between forward and deferred shading of the opaque objects
+    bool useDeferred = options.deferred;
+    bool deferredKeyDown = false;
+
+    // Window for interactive mode, offscreen context for headless mode.
+    GLFWwindow* window = nullptr;
+    HeadlessContext headless;
+    // Framebuffer the scene ends up in (0 is the window's default framebuffer).
+    GLuint sceneFBO = 0;
+    if (options.headless)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (!headless.Create(width, height))
+            return -1;
+        sceneFBO = headless.FBO;
     }
-    glfwMakeContextCurrent(window);
-    gladLoadGL();
-    glViewport(0, 0, width, height);
+    else
+    {
+        // Initialize GLFW and create window.
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(width, height, "YoutubeOpenGL", NULL, NULL);
+        if (!window)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        gladLoadGL();
+        glViewport(0, 0, width, height);
+    }
+    // Entry points glad does not cover (program binaries, ...).
+    glExt.Load(options.headless ? headless.Loader() : (GLADloadproc)glfwGetProcAddress);
 
-    // Build shaders.
-    Shader shaderProgram("default.vert", "default.frag");
-    Shader lightShader("light.vert", "light.frag");
-    Shader mirrorShader("mirror.vert", "mirror.frag");
+    // Queue shader builds first, reusing linked binaries from earlier runs when possible.
+    // Their status is only checked on first use, so the driver compiles them while
+    // the geometry and textures below are being set up.
+    ProgramCache programCache("shader_cache", options.shaderCache);
+    Shader lightShader("light.vert", "light.frag", &programCache);
+    // The mirror surface samples the reflection texture when there is one
+    Shader mirrorShader("mirror.vert", "mirror.frag", &programCache, options.mirrorScale > 0.0f ? "#define REFLECTION_TEXTURE 1\n" : "");
+
+    // Set Up Lights 
+    auto [fixedLight, spotLight, dirLight] = SetupLightSources();
+    // Dynamic lights come from storage buffers, binned into clusters of the view by default
+    if (options.dynamicLights > 0 && !glExt.shaderStorage)
+    {
+        std::cout << "Dynamic lights need OpenGL 4.3 shader storage buffers, rendering without them" << std::endl;
+        options.dynamicLights = 0;
+    }
+    std::vector<LightSource> dynamicLights = SetupDynamicLights(options.dynamicLights);
+    ClusteredLighting clusteredLighting(NearPlane, FarPlane, options.clustering);
+
+    // The scene shader is specialized for the specular model, light types and fog mode.
+    // Both specular variants are queued now, so toggling with B never waits for a compile.
+    ShaderVariants sceneShaders("default.vert", "default.frag", &programCache);
+    ShaderFeatures features;
+    features.fixedLight = fixedLight.type;
+    features.spotLight = spotLight.type;
+    features.dirLight = dirLight.type;
+    features.fog = options.fog;
+    if (!dynamicLights.empty())
+        features.lightList = options.clustering ? LIGHT_LIST_CLUSTERED : LIGHT_LIST_ALL;
+    features.deferred = useDeferred ? GEOMETRY_STAGE : FORWARD_STAGE;
+    features.specular = useBlinn ? PHONG_SPECULAR : BLINN_PHONG_SPECULAR;
+    sceneShaders.Get(features);
+    features.specular = useBlinn ? BLINN_PHONG_SPECULAR : PHONG_SPECULAR;
+    Shader* shaderProgram = &sceneShaders.Get(features);
+    ShaderFeatures instancedFeatures = features;
+    instancedFeatures.instanced = true;
+    if ((options.instanceCount > 0 || options.torusFieldCount > 0) && options.instancing)
+        sceneShaders.Get(instancedFeatures);
 
     // --- Set Up Geometry Objects ---
+    // Every mesh is welded and reordered for the vertex caches before it is uploaded, and
+    // gets its coarser detail levels appended to its indices; the geometry arena below is
+    // filled with the optimized meshes as well.
+    MeshOptimizer meshOptimizer;
+    MeshSimplifier meshSimplifier;
     // Pyramid
-    auto [pyramid, pyramidVAO] = SetupObject(pyramidVertices, pyramidIndices);
+    MeshData pyramidData(pyramidVertices, pyramidIndices);
+    auto [pyramid, pyramidVAO] = SetupObject(meshOptimizer, meshSimplifier, "pyramid", pyramidData);
 
-    // Moving Cube
-    auto [cube, cubeVAO] = SetupObject(cubeVertices);
+    // Moving Cube (indexed by the welding)
+    MeshData cubeData(cubeVertices);
+    auto [cube, cubeVAO] = SetupObject(meshOptimizer, meshSimplifier, "cube", cubeData);
 
     // Floor
-    auto [floor, floorVAO] = SetupObject(floorVertices, floorIndices);
+    MeshData floorData(floorVertices, floorIndices);
+    auto [floor, floorVAO] = SetupObject(meshOptimizer, meshSimplifier, "floor", floorData);
 
     // Rotating Sphere
-    std::vector<float> sphereVerts;
-    std::vector<unsigned int> sphereInds;
-    auto [sphere, sphereVAO] = SetupSphere(sphereVerts, sphereInds);
+    MeshData sphereData;
+    auto [sphere, sphereVAO] = SetupSphere(meshOptimizer, meshSimplifier, sphereData);
 
     // Light Cube
-    auto [lightCube, lightVAO] = SetupObject(lightVertices, lightIndices);
+    MeshData lightData(lightVertices, lightIndices);
+    auto [lightCube, lightVAO] = SetupObject<PositionLayout>(meshOptimizer, meshSimplifier, "light cube", lightData);
 
     // Mirror
-    auto [mirror, mirrorVAO] = SetupObject(mirrorVertices, mirrorIndices);
-
-    // Set Up Textures
-    auto [brickTex, floorTex, sphereTex, torrusTex] = SetupTextures(shaderProgram);
-
-    // Set Up Lights 
-    auto [fixedLight, spotLight, dirLight] = SetupLightSources(shaderProgram);
-
-    // Create a texture and framebuffer for mirror reflection.
-    auto [reflectionTexture, reflectionFBO] = SetupMirrorTexture();
+    MeshData mirrorData(mirrorVertices, mirrorIndices);
+    auto [mirror, mirrorVAO] = SetupObject(meshOptimizer, meshSimplifier, "mirror", mirrorData);
 
     // Rotating Torus
-    std::vector<float> torusVerts;
-    std::vector<unsigned int> torusInds;
-    auto [torus, torusVAO] = SetupTorus(torusVerts, torusInds);
-    
-    // Reflection matrix for mirror plane (plane z = -3).
-    glm::mat4 reflectionMatrix = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -6)), glm::vec3(1, 1, -1));
+    MeshData torusData;
+    auto [torus, torusVAO] = SetupTorus(meshOptimizer, meshSimplifier, torusData);
+
+    // Geometry arena: the static meshes as ranges of one shared vertex/index buffer pair,
+    // so switching meshes needs no VAO change. The light cube has its own vertex layout.
+    // With --no-arena it is not built at all and the mesh ids are unused.
+    std::optional<GeometryArena> arena;
+    if (options.arena)
+        arena.emplace(ArenaVertexCapacity, ArenaIndexCapacity, options.vertexFormat, options.splitStreams);
+    auto addMesh = [&](const MeshData& mesh) {
+        return arena ? arena->Add(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), mesh.lods) : 0;
+    };
+    uint32_t pyramidMesh = addMesh(pyramidData);
+    uint32_t cubeMesh = addMesh(cubeData);
+    uint32_t floorMesh = addMesh(floorData);
+    uint32_t sphereMesh = addMesh(sphereData);
+    uint32_t torusMesh = addMesh(torusData);
+    uint32_t mirrorMesh = addMesh(mirrorData);
+
+    // Model matrix to draw a mesh with: packed arena vertices are decoded through it
+    auto meshModel = [&](uint32_t mesh, const glm::mat4& model) {
+        return options.arena ? model * arena->Decode(mesh) : model;
+    };
+    // Points a packet at a detail level of the mesh in the arena; with --no-arena it keeps the
+    // object's own VAO and range
+    auto meshPacket = [&](uint32_t mesh, DrawPacket packet, size_t level = 0) {
+        if (!options.arena)
+            return packet;
+        GeometryArena::MeshRange range = arena->Lod(mesh, level);
+        packet.model = meshModel(mesh, packet.model);
+        packet.vao = arena->vao.ID;
+        packet.indexed = true;
+        packet.first = (GLint)range.firstIndex;
+        packet.count = (GLsizei)range.indexCount;
+        packet.baseVertex = range.baseVertex;
+        return packet;
+    };
+    // Draws a mesh outside the render queue, from the arena or from the object's own VAO
+    auto drawMesh = [&](uint32_t mesh, VAO& ownVAO, GLsizei ownCount) {
+        if (options.arena)
+        {
+            arena->Bind();
+            arena->Draw(mesh);
+        }
+        else
+        {
+            ownVAO.Bind();
+            glDrawElements(GL_TRIANGLES, ownCount, GL_UNSIGNED_INT, 0);
+        }
+    };
+
+    // Pyramid and torus fields: per-instance transforms live in one buffer linked to the
+    // pyramid and torus VAOs (and to the arena VAO, which they are drawn from by default).
+    // The visible pyramids come first, then the visible tori grouped by detail level.
+    std::vector<glm::mat4> fieldTransforms(options.instanceCount);
+    std::vector<glm::mat4> torusFieldTransforms(options.torusFieldCount);
+    SetupTorusField(torusFieldTransforms);
+    InstanceBuffer fieldInstances(std::max(options.instanceCount + options.torusFieldCount, 1));
+    if (options.instanceCount > 0 || options.torusFieldCount > 0)
+    {
+        pyramid.LinkInstances(fieldInstances);
+        torus.LinkInstances(fieldInstances);
+        if (arena)
+        {
+            arena->vao.Bind();
+            arena->vao.LinkInstanceTransforms(fieldInstances, Object::InstanceTransformLocation);
+            arena->vao.Unbind();
+        }
+    }
+
+    // Multi-draw path: the arena meshes drawn with one indirect call.
+    // Materials index the texture units the MULTI_DRAW shader samples from.
+    bool useMultiDraw = options.multiDraw && glExt.multiDrawIndirect && options.arena;
+    if (options.multiDraw && !glExt.multiDrawIndirect)
+        std::cout << "Multi-draw indirect needs OpenGL 4.3, drawing objects one by one" << std::endl;
+    else if (options.multiDraw && !options.arena)
+        std::cout << "Multi-draw draws from the geometry arena, drawing objects one by one (--no-arena)" << std::endl;
+    enum Material { BRICK_MATERIAL, FLOOR_MATERIAL, SPHERE_MATERIAL, TORUS_MATERIAL };
+    MultiDrawBatch multiDraw;
+    if (useMultiDraw)
+        multiDraw.Init(*arena);
+    ShaderFeatures multiDrawFeatures = features;
+    multiDrawFeatures.multiDraw = true;
+    // Multi-draw variants (shading and depth-only) whose storage block and samplers are set up
+    std::vector<Shader*> preparedBatchShaders;
+    if (useMultiDraw)
+        sceneShaders.Get(multiDrawFeatures);
+
+    // Deferred path: G-buffer and the full-screen lighting variants of the scene shader
+    DeferredRenderer deferredRenderer(width, height, &programCache);
+    // Depth pre-pass of the opaque objects, chosen from the measured overdraw by default
+    DepthPrepass depthPrepass(options.depthPrepass);
+
+    // Set Up Textures (last, it is the first step that needs a linked program)
+    auto [brickTex, floorTex, sphereTex, torrusTex] = SetupTextures(*shaderProgram);
+
+    // Mirror in the plane z = -3, facing +z
+    PlanarMirror planarMirror(glm::vec4(0.0f, 0.0f, 1.0f, 3.0f), width, height, options.mirrorScale, options.mirrorInterval);
 
     // Camera Setup 
-    Camera camera(width, height, glm::vec3(0.0f, 0.0f, 2.0f));
+    Camera camera(width, height, options.cameraPos);
+    camera.Orientation = glm::normalize(options.cameraLook - options.cameraPos);
     camera.target = glm::vec3(0.0f);
 
     glEnable(GL_DEPTH_TEST);
 
-    // Main Render Loop 
-    while (!glfwWindowShouldClose(window))
+    // Programs the setup above did not fully hide; using them below waits for the driver.
+    int stillCompiling = 0;
+    for (Shader* program : { shaderProgram, &lightShader, &mirrorShader })
+        stillCompiling += program->IsReady() ? 0 : 1;
+    if (glExt.parallelShaderCompile)
+        std::cout << "Shader programs still compiling after setup: " << stillCompiling << std::endl;
+
+    // Vertex inputs of the programs against the layouts that feed them; mismatches are printed
+    const VertexLayoutView sceneLayout = options.arena ? arena->Layout() : ObjectLayout::View();
+    sceneLayout.Validate(shaderProgram->ID, "default.vert", Object::InstanceTransformLocation);
+    if (options.depthPrepass != PREPASS_OFF)
+        sceneLayout.Validate(sceneShaders.DepthOnly(*shaderProgram).ID, "default.vert (depth only)", Object::InstanceTransformLocation);
+    sceneLayout.Validate(mirrorShader.ID, "mirror.vert");
+    PositionLayout::Validate(lightShader.ID, "light.vert");
+
+    // Resolve uniform handles once; the render loop never looks up names.
+    SceneUniforms uniforms = ResolveSceneUniforms(mirrorShader);
+    // Mirror uniforms never change, so they are set once instead of per draw.
+    mirrorShader.Activate();
+    mirrorShader.set(uniforms.mirrorColor, glm::vec4(0.8f, 0.9f, 1.0f, 0.15f));
+    mirrorShader.set(uniforms.reflectionTexture, 0);
+    lightShader.Activate();
+    lightShader.set(lightShader.GetUniform<glm::vec4>("lightColor"), glm::vec4(fixedLight.color, 1.0f));
+    RenderQueue renderQueue;
+    // Reflected scene, sorted for the reflected view
+    RenderQueue mirrorQueue;
+    // World bounds of everything drawn, tested against the camera frustum and the mirrored
+    // frustum every frame; the BVH over them is refitted as objects move.
+    CullingBatch mainCulling;
+    BVH sceneBVH;
+    std::vector<uint8_t> mainVisible, mirrorVisible;
+    size_t mainVisibleCount = 0, mirrorVisibleCount = 0;
+    // The mirror pass was skipped last frame because the quad's query found it hidden
+    bool mirrorSkipped = false;
+    // Occlusion queries on the boxes of the same objects, read back a frame or more later
+    // (only built with --occlusion).
+    std::optional<OcclusionCuller> occlusion;
+    if (options.occlusion)
+        occlusion.emplace(&programCache);
+    std::vector<glm::mat4> visibleFieldTransforms;
+    // Detail levels picked per culling slot; the visible field tori of every level
+    LodSelector lodSelector(options.lodPixelError);
+    std::vector<std::vector<size_t>> torusFieldLevels;
+
+    // Uniform blocks shared by all programs. Every frame writes two FrameData blocks (the camera
+    // and the reflected camera of the mirror pass), LightData and one ObjectData block
+    // per draw into its section of the ring buffer and binds the ranges as they are needed.
+    for (Shader* program : { &lightShader, &mirrorShader })
     {
-        float time = glfwGetTime();
+        program->BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+        program->BindUniformBlock("LightData", LIGHT_BLOCK_BINDING);
+        program->BindUniformBlock("ObjectData", OBJECT_BLOCK_BINDING);
+    }
+    sceneShaders.BindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+    sceneShaders.BindUniformBlock("LightData", LIGHT_BLOCK_BINDING);
+    sceneShaders.BindUniformBlock("ObjectData", OBJECT_BLOCK_BINDING);
+    RingBuffer frameRing(RingBufferFrameSize, options.persistentMap);
+    if (options.persistentMap && !frameRing.Persistent())
+        std::cout << "Persistent mapping needs OpenGL 4.4 or GL_ARB_buffer_storage, mapping per write" << std::endl;
+    // Model matrices of draws made outside the render queue
+    auto setModel = [&](const glm::mat4& model) {
+        RingBuffer::BindUniform(OBJECT_BLOCK_BINDING, frameRing.Write(ObjectBlock{ model }));
+    };
+
+    FrameProfiler profiler;
+    int frameIndex = 0;
 
-        // Toggle specular model
-        if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+    // Main Render Loop 
+    int headlessFrames = options.warmupFrames + options.frameCount;
+    while (options.headless ? frameIndex < headlessFrames : !glfwWindowShouldClose(window))
+    {
+        // Headless runs use a deterministic clock so every run renders the same frames.
+        float time = options.headless ? frameIndex * options.timeStep : (float)glfwGetTime();
+        // Only headless runs report timings; warm-up frames absorb shader compilation and
+        // driver first-use costs.
+        bool profiled = options.headless && frameIndex >= options.warmupFrames;
+        if (profiled)
+            profiler.BeginFrame();
+
+        if (window)
         {
-            useBlinn = !useBlinn;
+            // Toggle specular model
+            if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+            {
+                useBlinn = !useBlinn;
+            }
+            // Toggle deferred shading once per key press
+            bool deferredKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+            if (deferredKey && !deferredKeyDown)
+                useDeferred = !useDeferred;
+            deferredKeyDown = deferredKey;
+
+            // --- Update Camera & Input ---
+            camera.HandleModes(window);
+            camera.Inputs(window);
         }
-
-        // --- Update Camera & Input ---
-        camera.HandleModes(window);
-        camera.Inputs(window);
-        camera.updateMatrix(45.0f, 0.1f, 100.0f);
+        camera.updateMatrix(45.0f, NearPlane, FarPlane);
 
         // Clear buffers.
+        glState.BindFramebuffer(sceneFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        // Deferred shading draws the opaque objects into the G-buffer instead
+        if (useDeferred)
+            deferredRenderer.BeginGeometry();
 
-        // Update cube position and spotlight.
+        // Update cube position and spotlight attached to it.
         glm::vec3 cubePos(sinf(time) * 3.0f, 0.5f, 1.0f);
         camera.attachedObject = &cubePos;
-        dirLight.color = glm::vec3(1.0f, 1.0f, std::max(sin(time / 10), 0.0f));
-        dirLight.setUniforms(shaderProgram, "dirLight");
-        fixedLight.setUniforms(shaderProgram, "fixedLight");
-        shaderProgram.setVec3("spotLight.position", spotLight.position);
-        HandleSpotlightChange(window, spotLight);
+        glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), cubePos);
+        glm::vec3 localOffset(0.2f, 0.2f, 0.0f);
+        spotLight.position = glm::vec3(cubeModel * glm::vec4(localOffset, 1.0f));
+        dirLight.color = glm::vec3(1.0f, 1.0f, std::max(sinf(time / 10), 0.0f));
+        if (window)
+            HandleSpotlightChange(window, spotLight);
+
+        // --- Write per-frame uniform blocks ---
+        // Camera/fog for the main view and the mirrored view, and the lights, go into this
+        // frame's ring buffer section (waiting only if the GPU is still reading it).
+        frameRing.BeginFrame();
+        FrameBlock mainFrame = MakeFrameBlock(time, camera.viewMatrix, camera.projectionMatrix, camera.Position);
+        // (the mirror quad is not transformed, its local box is its world box)
+        planarMirror.Update(camera.viewMatrix, camera.projectionMatrix, camera.Position, mirror.bounds.box);
+        FrameBlock mirroredFrame = MakeFrameBlock(time, planarMirror.View(), planarMirror.Projection(), planarMirror.CameraPosition());
+        RingBuffer::Range mainFrameRange = frameRing.Write(mainFrame);
+        RingBuffer::Range mirroredFrameRange = frameRing.Write(mirroredFrame);
+        RingBuffer::BindUniform(FRAME_BLOCK_BINDING, mainFrameRange);
+
+        LightsBlock lights = { fixedLight.toBlock(), spotLight.toBlock(), dirLight.toBlock() };
+        RingBuffer::BindUniform(LIGHT_BLOCK_BINDING, frameRing.Write(lights));
+        // Dynamic lights, with their clusters of this frame's view
+        if (!dynamicLights.empty())
+        {
+            UpdateDynamicLights(dynamicLights, time);
+            clusteredLighting.Update(dynamicLights, camera.viewMatrix, camera.projectionMatrix);
+            clusteredLighting.Bind(frameRing);
+        }
+
+        // --- Pick the scene shader variant ---
+        // Variants only differ in code; all their inputs come from the uniform blocks.
+        features.specular = useBlinn ? BLINN_PHONG_SPECULAR : PHONG_SPECULAR;
+        features.fixedLight = fixedLight.type;
+        features.spotLight = spotLight.type;
+        features.dirLight = dirLight.type;
+        features.deferred = useDeferred ? GEOMETRY_STAGE : FORWARD_STAGE;
+        shaderProgram = &sceneShaders.Get(features);
+        // The mirror pass is always shaded forward
+        ShaderFeatures forwardFeatures = features;
+        forwardFeatures.deferred = FORWARD_STAGE;
+        Shader* forwardProgram = &sceneShaders.Get(forwardFeatures);
 
         // --- Render Main Scene ---
-        shaderProgram.Activate();
-        shaderProgram.setBool("useBlinn", useBlinn);
-        SetFogUniforms(shaderProgram, time, camera, spotLight);
+        // Opaque objects go through the render queue, which sorts them by program, texture,
+        // VAO and depth. With a reflection texture the mirror quad is queued as blended.
+        renderQueue.Begin(camera.viewMatrix, 100.0f);
+        // Full detail index counts (the indices of the coarser levels follow them)
+        GLsizei pyramidCount = (GLsizei)pyramidData.lods[0].indexCount;
+        GLsizei cubeCount = (GLsizei)cubeData.lods[0].indexCount;
+        GLsizei floorCount = (GLsizei)floorData.lods[0].indexCount;
+        GLsizei lightCount = (GLsizei)lightData.lods[0].indexCount;
+        GLsizei mirrorCount = (GLsizei)mirrorData.lods[0].indexCount;
 
-        // Draw Pyramid.
         glm::mat4 pyramidModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f));
-        pyramid.SetTexture(brickTex);
-        pyramid.Draw(glm::vec3(0.0f), shaderProgram, sizeof(pyramidIndices) / sizeof(GLuint));
-
-        // Draw Cube.
-        glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), cubePos);
-        cube.Draw(cubePos, shaderProgram, 0, 36);
-
-        // Update spotlight attached to cube.
-        glm::vec3 localOffset(0.2f, 0.2f, 0.0f);
-        glm::vec3 spotlightWorldPos = glm::vec3(cubeModel * glm::vec4(localOffset, 1.0f));
-        spotLight.position = spotlightWorldPos;
-        spotLight.setUniforms(shaderProgram, "spotLight");
-        shaderProgram.setVec3("spotLight.position", spotLight.position);
-        shaderProgram.setVec3("spotLight.direction", spotLight.direction);
-
-        // Draw Rotating Sphere.
         glm::mat4 sphereModel = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.0f, 0.0f)),
             time, glm::vec3(0.0f, 1.0f, 0.0f));
-        shaderProgram.setMatrix4("model", sphereModel);
-        sphereTex.Bind();
-        sphereVAO.Bind();
-        glDrawElements(GL_TRIANGLES, sphereInds.size(), GL_UNSIGNED_INT, 0);
-
-        // Draw Floor.
         glm::mat4 floorModel = glm::mat4(1.0f);
-        floor.SetTexture(floorTex);
-        floor.Draw(glm::vec3(0.0f), shaderProgram, 6);
-
-        // Render Light Cube
         glm::vec3 lightCubePos(3.5f, 1.5f, 5.5f);
         glm::mat4 lightModel = glm::translate(glm::mat4(1.0f), lightCubePos);
-        shaderProgram.setMatrix4("model", lightModel);
-        shaderProgram.setMatrix4("camMatrix", camera.cameraMatrix);
-        shaderProgram.setVec4("lightColor", glm::vec4(1.0f));
-        lightVAO.Bind();
-        glDrawElements(GL_TRIANGLES, sizeof(lightIndices) / sizeof(GLuint), GL_UNSIGNED_INT, 0);
-
-        // Render torus
         glm::mat4 torusModel = glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f, 0.5f, -2.0f));
         torusModel = glm::rotate(torusModel, time, glm::vec3(0.0f, 1.0f, 0.0f));
-        shaderProgram.setMatrix4("model", torusModel);
-        torusVAO.Bind();
-        torrusTex.Bind();
-        glDrawElements(GL_TRIANGLES, torusInds.size(), GL_UNSIGNED_INT, 0);
-
-        // Render Mirror Reflection
-        // Reflection texture
-        glBindFramebuffer(GL_FRAMEBUFFER, reflectionFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glm::mat4 reflectionViewMatrix = camera.viewMatrix * reflectionMatrix;
-        shaderProgram.setMatrix4("view", reflectionViewMatrix);
-        shaderProgram.setMatrix4("projection", camera.projectionMatrix);
-        brickTex.Bind();
-        pyramidVAO.Bind();
-        glDrawElements(GL_TRIANGLES, sizeof(pyramidIndices) / sizeof(GLuint), GL_UNSIGNED_INT, 0);
-        cubeVAO.Bind();
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // Mark mirror area in stencil buffer.
-        glEnable(GL_STENCIL_TEST);
-        glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-        glDepthMask(GL_FALSE);
-        shaderProgram.Activate();
         glm::mat4 mirrorModel = glm::mat4(1.0f);
-        shaderProgram.setMatrix4("model", mirrorModel);
-        mirrorVAO.Bind();
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-        glDepthMask(GL_TRUE);
-
-        // Render reflection only in mirror region
-        glStencilFunc(GL_EQUAL, 1, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-        shaderProgram.Activate();
-        shaderProgram.setMatrix4("view", camera.viewMatrix * reflectionMatrix);
-        glm::vec3 reflectedCameraPos(camera.Position.x, camera.Position.y, -camera.Position.z - 6);
-        shaderProgram.setVec3("cameraPos", reflectedCameraPos);
-
-        // Render reflected Pyramid
-        pyramidModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f));
-        pyramidModel = reflectionMatrix * pyramidModel;
-        mirrorShader.setMatrix4("model", pyramidModel);
-        brickTex.Bind();
-        pyramidVAO.Bind();
-        glDrawElements(GL_TRIANGLES, sizeof(pyramidIndices) / sizeof(GLuint), GL_UNSIGNED_INT, 0);
-
-        // Render reflected Cube
-        cube.Draw(cubePos, shaderProgram, 0, 36);
-
-        // Render reflected Sphere
-        sphereModel = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.0f, 0.0f)),
-            time, glm::vec3(0.0f, 1.0f, 0.0f));
-        shaderProgram.setMatrix4("model", sphereModel);
-        sphereVAO.Bind();
-        sphereTex.Bind();
-        glDrawElements(GL_TRIANGLES, sphereInds.size(), GL_UNSIGNED_INT, 0);
-
-        // Render reflected Torus
-        torusModel = glm::rotate(
-            glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f, 0.5f, -2.0f)),
-            time, glm::vec3(0.0f, 1.0f, 0.0f)
-        );
-        shaderProgram.setMatrix4("model", torusModel);
-        torusVAO.Bind();
-        torrusTex.Bind();
-        glDrawElements(GL_TRIANGLES, torusInds.size(), GL_UNSIGNED_INT, 0);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_STENCIL_TEST);
-
-        // Draw the mirror surface with reflection texture.
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        mirrorShader.Activate();
-        mirrorShader.setMatrix4("view", camera.viewMatrix);
-        mirrorShader.setMatrix4("projection", camera.projectionMatrix);
-        mirrorShader.setMatrix4("model", mirrorModel);
-        mirrorShader.setVec4("mirrorColor", glm::vec4(1.0f, 1.0f, 1.0f, 0.3f));
-        mirrorShader.setInt("reflectionTexture", 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, reflectionTexture);
-        mirrorVAO.Bind();
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glDisable(GL_BLEND);
+        if (options.instanceCount > 0)
+            UpdatePyramidField(fieldTransforms, time);
+
+        // --- Frustum culling ---
+        // Everything drawn is tested in one batch, against the camera frustum here and the
+        // reflected frustum of the mirror pass below; the field pyramids follow the named objects.
+        mainCulling.Clear();
+        size_t pyramidSlot = mainCulling.Add(pyramid.bounds, pyramidModel);
+        size_t cubeSlot = mainCulling.Add(cube.bounds, cubeModel);
+        size_t sphereSlot = mainCulling.Add(sphere.bounds, sphereModel);
+        size_t floorSlot = mainCulling.Add(floor.bounds, floorModel);
+        size_t lightSlot = mainCulling.Add(lightCube.bounds, lightModel);
+        size_t torusSlot = mainCulling.Add(torus.bounds, torusModel);
+        size_t mirrorSlot = mainCulling.Add(mirror.bounds, mirrorModel);
+        size_t fieldSlot = mainCulling.Size();
+        for (const glm::mat4& fieldModel : fieldTransforms)
+            mainCulling.Add(pyramid.bounds, fieldModel);
+        size_t torusFieldSlot = mainCulling.Size();
+        for (const glm::mat4& fieldModel : torusFieldTransforms)
+            mainCulling.Add(torus.bounds, fieldModel);
+        if (options.bvh)
+        {
+            sceneBVH.Update(mainCulling.Boxes());
+            mainVisibleCount = sceneBVH.Cull(camera.frustum, mainVisible);
+        }
+        else
+            mainVisibleCount = mainCulling.Cull(camera.frustum, mainVisible);
+
+        // Objects hidden at their last finished occlusion query are drawn after this frame's
+        // queries, each one conditional on its own query. The rest are drawn first as occluders.
+        if (options.occlusion)
+            occlusion->BeginFrame(mainCulling.Size(), camera.Position, camera.projectionMatrix);
+        const size_t occlusionTestedSlots[] = { pyramidSlot, cubeSlot, sphereSlot, lightSlot, torusSlot };
+        auto submitOpaque = [&](size_t slot, DrawPacket packet) {
+            if (options.occlusion && occlusion->WasOccluded(slot, mainCulling.Boxes()[slot]))
+            {
+                packet.conditionQuery = occlusion->QueryObject(slot);
+                renderQueue.Submit(OCCLUSION_TESTED_PASS, packet);
+            }
+            else
+                renderQueue.Submit(OPAQUE_PASS, packet);
+        };
+        // Static meshes go into the multi-draw batch instead when it is enabled (one indirect
+        // draw cannot be made conditional per object, so occlusion results do not apply there)
+        multiDraw.Begin();
+        auto submitStatic = [&](size_t slot, uint32_t mesh, uint32_t material, const DrawPacket& packet, size_t level = 0) {
+            if (useMultiDraw)
+                multiDraw.Add(mesh, packet.model, material, level);
+            else
+                submitOpaque(slot, meshPacket(mesh, packet, level));
+        };
+
+        // Detail levels of the sphere and the tori from their projected simplification error,
+        // keyed by culling slot; the mirror pass draws them at the same levels
+        lodSelector.Begin(camera.Position, camera.projectionMatrix, camera.height);
+        size_t sphereLevel = mainVisible[sphereSlot] ? lodSelector.Select(sphereSlot, sphere.lods, sphere.bounds, sphereModel) : 0;
+        size_t torusLevel = mainVisible[torusSlot] ? lodSelector.Select(torusSlot, torus.lods, torus.bounds, torusModel) : 0;
+
+        // Pyramid.
+        if (mainVisible[pyramidSlot])
+            submitStatic(pyramidSlot, pyramidMesh, BRICK_MATERIAL, MakePacket(*shaderProgram, pyramidModel, brickTex.ID, pyramidVAO.ID, pyramidCount));
+
+        // Cube.
+        if (mainVisible[cubeSlot])
+            submitStatic(cubeSlot, cubeMesh, BRICK_MATERIAL, MakePacket(*shaderProgram, cubeModel, brickTex.ID, cubeVAO.ID, cubeCount));
+
+        // Rotating Sphere.
+        if (mainVisible[sphereSlot])
+            submitStatic(sphereSlot, sphereMesh, SPHERE_MATERIAL, MakePacket(*shaderProgram, sphereModel, sphereTex.ID, sphereVAO.ID, sphere.lods[sphereLevel]), sphereLevel);
+
+        // Floor.
+        if (mainVisible[floorSlot] && useMultiDraw)
+            multiDraw.Add(floorMesh, floorModel, FLOOR_MATERIAL);
+        else if (mainVisible[floorSlot])
+            renderQueue.Submit(OPAQUE_PASS, meshPacket(floorMesh, MakePacket(*shaderProgram, floorModel, floorTex.ID, floorVAO.ID, floorCount)));
+
+        // Light Cube: unlit, in the light's color. It only has positions, so it is queued with
+        // the blended objects, after the depth pre-pass and the deferred lighting.
+        if (mainVisible[lightSlot])
+        {
+            DrawPacket lightPacket = MakePacket(lightShader, lightModel, 0, lightVAO.ID, lightCount);
+            if (options.occlusion && !occlusion->ReachesNearPlane(mainCulling.Boxes()[lightSlot]))
+                lightPacket.conditionQuery = occlusion->QueryObject(lightSlot);
+            renderQueue.Submit(BLENDED_PASS, lightPacket);
+        }
+
+        // Torus.
+        if (mainVisible[torusSlot])
+            submitStatic(torusSlot, torusMesh, TORUS_MATERIAL, MakePacket(*shaderProgram, torusModel, torrusTex.ID, torusVAO.ID, torus.lods[torusLevel]), torusLevel);
+
+        // Pyramid field: only the visible transforms are uploaded for one instanced packet,
+        // or submitted as one packet per pyramid with --no-instancing.
+        instancedFeatures.specular = features.specular;
+        instancedFeatures.fixedLight = features.fixedLight;
+        instancedFeatures.spotLight = features.spotLight;
+        instancedFeatures.dirLight = features.dirLight;
+        instancedFeatures.deferred = features.deferred;
+        visibleFieldTransforms.clear();
+        if (options.instanceCount > 0)
+        {
+            if (useMultiDraw)
+            {
+                // Consecutive draws of one mesh share a command, so the field adds no draw calls
+                for (size_t i = 0; i < fieldTransforms.size(); i++)
+                {
+                    if (mainVisible[fieldSlot + i])
+                        multiDraw.Add(pyramidMesh, fieldTransforms[i], BRICK_MATERIAL);
+                }
+            }
+            else if (options.instancing)
+            {
+                // The instance transforms decode packed arena vertices themselves
+                for (size_t i = 0; i < fieldTransforms.size(); i++)
+                {
+                    if (mainVisible[fieldSlot + i])
+                        visibleFieldTransforms.push_back(meshModel(pyramidMesh, fieldTransforms[i]));
+                }
+                if (!visibleFieldTransforms.empty())
+                {
+                    DrawPacket fieldPacket = meshPacket(pyramidMesh, MakePacket(sceneShaders.Get(instancedFeatures), visibleFieldTransforms[0], brickTex.ID, pyramidVAO.ID, pyramidCount));
+                    fieldPacket.instanceCount = (GLsizei)visibleFieldTransforms.size();
+                    fieldPacket.objectData = false;
+                    renderQueue.Submit(OPAQUE_PASS, fieldPacket);
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < fieldTransforms.size(); i++)
+                {
+                    if (mainVisible[fieldSlot + i])
+                        renderQueue.Submit(OPAQUE_PASS, meshPacket(pyramidMesh, MakePacket(*shaderProgram, fieldTransforms[i], brickTex.ID, pyramidVAO.ID, pyramidCount)));
+                }
+            }
+        }
+
+        // Torus field: every visible torus is drawn at its own detail level. The tori are
+        // grouped by level, so the multi-draw batch packs a level into one command and
+        // instancing draws a level with one packet, whose transforms follow the pyramids' in
+        // the instance buffer from its baseInstance on (GL 4.2; one packet per torus without).
+        if (options.torusFieldCount > 0)
+        {
+            torusFieldLevels.resize(torus.lods.size());
+            for (std::vector<size_t>& tori : torusFieldLevels)
+                tori.clear();
+            for (size_t i = 0; i < torusFieldTransforms.size(); i++)
+            {
+                if (mainVisible[torusFieldSlot + i])
+                    torusFieldLevels[lodSelector.Select(torusFieldSlot + i, torus.lods, torus.bounds, torusFieldTransforms[i])].push_back(i);
+            }
+            for (size_t level = 0; level < torusFieldLevels.size(); level++)
+            {
+                const std::vector<size_t>& tori = torusFieldLevels[level];
+                if (tori.empty())
+                    continue;
+                if (useMultiDraw)
+                {
+                    for (size_t i : tori)
+                        multiDraw.Add(torusMesh, torusFieldTransforms[i], TORUS_MATERIAL, level);
+                }
+                else if (options.instancing && glExt.baseInstance)
+                {
+                    GLuint baseInstance = (GLuint)visibleFieldTransforms.size();
+                    for (size_t i : tori)
+                        visibleFieldTransforms.push_back(meshModel(torusMesh, torusFieldTransforms[i]));
+                    DrawPacket levelPacket = meshPacket(torusMesh, MakePacket(sceneShaders.Get(instancedFeatures), visibleFieldTransforms[baseInstance], torrusTex.ID, torusVAO.ID, torus.lods[level]), level);
+                    levelPacket.instanceCount = (GLsizei)tori.size();
+                    levelPacket.baseInstance = baseInstance;
+                    levelPacket.objectData = false;
+                    renderQueue.Submit(OPAQUE_PASS, levelPacket);
+                }
+                else
+                {
+                    for (size_t i : tori)
+                        renderQueue.Submit(OPAQUE_PASS, meshPacket(torusMesh, MakePacket(*shaderProgram, torusFieldTransforms[i], torrusTex.ID, torusVAO.ID, torus.lods[level]), level));
+                }
+            }
+        }
+        if (!visibleFieldTransforms.empty())
+            fieldInstances.Update(visibleFieldTransforms);
+
+        // Mirror surface showing the reflection texture, when there is one (the single pass
+        // path blends the surface itself). When it is off screen or seen from behind the whole
+        // mirror pass is skipped, and with occlusion culling also while the last finished query
+        // of the quad found it hidden (the quad is still queried below to notice it coming back).
+        bool mirrorOnScreen = mainVisible[mirrorSlot] && planarMirror.Faces(camera.Position);
+        bool mirrorHidden = options.occlusion && occlusion->WasOccluded(mirrorSlot, mainCulling.Boxes()[mirrorSlot]);
+        bool mirrorRendered = mirrorOnScreen && !mirrorHidden;
+        mirrorVisibleCount = 0;
+        if (mirrorRendered && planarMirror.UsesTexture())
+        {
+            DrawPacket mirrorPacket = meshPacket(mirrorMesh, MakePacket(mirrorShader, mirrorModel, planarMirror.Texture(), mirrorVAO.ID, mirrorCount));
+            if (options.occlusion && !occlusion->ReachesNearPlane(mainCulling.Boxes()[mirrorSlot]))
+                mirrorPacket.conditionQuery = occlusion->QueryObject(mirrorSlot);
+            renderQueue.Submit(BLENDED_PASS, mirrorPacket);
+        }
+
+        renderQueue.Sort();
+
+        // Draws the multi-draw batch, with its depth-only program in the depth pre-pass
+        auto drawBatch = [&](bool depthOnly) {
+            if (!useMultiDraw || multiDraw.DrawCount() == 0)
+                return;
+            multiDrawFeatures.specular = features.specular;
+            multiDrawFeatures.fixedLight = features.fixedLight;
+            multiDrawFeatures.spotLight = features.spotLight;
+            multiDrawFeatures.dirLight = features.dirLight;
+            multiDrawFeatures.deferred = features.deferred;
+            Shader& multiDrawVariant = depthOnly ? sceneShaders.DepthOnly(sceneShaders.Get(multiDrawFeatures)) : sceneShaders.Get(multiDrawFeatures);
+            if (std::find(preparedBatchShaders.begin(), preparedBatchShaders.end(), &multiDrawVariant) == preparedBatchShaders.end())
+            {
+                // New variant: connect its storage block and point each material at its unit
+                preparedBatchShaders.push_back(&multiDrawVariant);
+                MultiDrawBatch::PrepareShader(multiDrawVariant);
+            }
+            multiDrawVariant.Activate();
+            if (!depthOnly)
+            {
+                const GLuint materialTextures[MultiDrawBatch::MaxMaterials] = { brickTex.ID, floorTex.ID, sphereTex.ID, torrusTex.ID };
+                for (int material = 0; material < MultiDrawBatch::MaxMaterials; material++)
+                {
+                    glState.ActiveTexture(GL_TEXTURE0 + material);
+                    glState.BindTexture(GL_TEXTURE_2D, materialTextures[material]);
+                }
+                glState.ActiveTexture(GL_TEXTURE0);
+            }
+            multiDraw.Draw(frameRing);
+        };
+
+        // Depth pre-pass: the opaque objects lay down depth with a trivial program, then
+        // the shading pass below only shades the fragments that end up visible
+        bool prepass = depthPrepass.BeginFrame();
+        // The opaque meshes are closed and wound counterclockwise, so their back faces are
+        // culled; the mesh optimizer orders their front faces to hide each other
+        if (options.cullBackFaces)
+            glEnable(GL_CULL_FACE);
+        if (prepass)
+        {
+            depthPrepass.BeginDepth();
+            renderQueue.DrawDepth(OPAQUE_PASS, frameRing, sceneShaders);
+            drawBatch(true);
+            depthPrepass.EndDepth();
+        }
+        if (options.overdrawCounter)
+            depthPrepass.BeginCounting();
+        renderQueue.Draw(OPAQUE_PASS, frameRing);
+        drawBatch(false);
+        if (options.overdrawCounter)
+            depthPrepass.EndCounting(width, height);
+        if (prepass)
+            depthPrepass.EndShading();
+        if (options.cullBackFaces)
+            glDisable(GL_CULL_FACE);
+
+        if (options.occlusion)
+        {
+            // Boxes of the objects hidden last frame, tested against the occluders just drawn
+            occlusion->BeginQueries();
+            for (size_t slot : occlusionTestedSlots)
+            {
+                if (mainVisible[slot] && occlusion->WasOccluded(slot, mainCulling.Boxes()[slot]))
+                    occlusion->Query(slot, mainCulling.Boxes()[slot]);
+            }
+            occlusion->EndQueries();
+            renderQueue.Draw(OCCLUSION_TESTED_PASS, frameRing);
+
+            // Everything else is queried against the finished depth buffer for the next frames,
+            // the mirror quad too: once its result is read, it decides whether the mirror pass runs
+            occlusion->BeginQueries();
+            for (size_t slot : occlusionTestedSlots)
+            {
+                if (mainVisible[slot])
+                    occlusion->Query(slot, mainCulling.Boxes()[slot]);
+            }
+            if (mirrorOnScreen)
+                occlusion->Query(mirrorSlot, mainCulling.Boxes()[mirrorSlot]);
+            occlusion->EndQueries();
+        }
+
+        // Deferred lighting: every covered pixel shaded once into the scene framebuffer, which
+        // also receives the G-buffer depth for the mirror and blended passes
+        if (useDeferred)
+            deferredRenderer.Light(features, sceneFBO);
+
+        if (mirrorRendered)
+        {
+            // In the frame the quad comes back, its last result may be older than this frame's
+            // query, so the GPU waits for that query and drops the pass if the box is still
+            // hidden (the reflection texture is always rendered when due, later frames reuse it)
+            bool conditional = options.occlusion && mirrorSkipped && !planarMirror.UsesTexture()
+                && !occlusion->ReachesNearPlane(mainCulling.Boxes()[mirrorSlot]);
+            if (conditional)
+                glBeginConditionalRender(occlusion->QueryObject(mirrorSlot), GL_QUERY_WAIT);
+
+            // Reflected scene, culled against the reflected frustum: its near plane is the
+            // mirror plane, so objects behind the mirror are dropped here and clipped on the GPU
+            mirrorVisibleCount = options.bvh ? sceneBVH.Cull(planarMirror.ReflectedFrustum(), mirrorVisible)
+                : mainCulling.Cull(planarMirror.ReflectedFrustum(), mirrorVisible);
+            mirrorQueue.Begin(planarMirror.View(), 100.0f);
+            // Tracked objects decide whether a reflection texture refreshed on motion is due
+            auto submitReflected = [&](const DrawPacket& packet) {
+                mirrorQueue.Submit(OPAQUE_PASS, packet);
+                planarMirror.Track(packet.model);
+            };
+            if (mirrorVisible[pyramidSlot])
+                submitReflected(meshPacket(pyramidMesh, MakePacket(*forwardProgram, pyramidModel, brickTex.ID, pyramidVAO.ID, pyramidCount)));
+            if (mirrorVisible[cubeSlot])
+                submitReflected(meshPacket(cubeMesh, MakePacket(*forwardProgram, cubeModel, brickTex.ID, cubeVAO.ID, cubeCount)));
+            if (mirrorVisible[sphereSlot])
+                submitReflected(meshPacket(sphereMesh, MakePacket(*forwardProgram, sphereModel, sphereTex.ID, sphereVAO.ID, sphere.lods[sphereLevel]), sphereLevel));
+            if (mirrorVisible[floorSlot])
+                submitReflected(meshPacket(floorMesh, MakePacket(*forwardProgram, floorModel, floorTex.ID, floorVAO.ID, floorCount)));
+            if (mirrorVisible[lightSlot])
+                submitReflected(MakePacket(lightShader, lightModel, 0, lightVAO.ID, lightCount));
+            if (mirrorVisible[torusSlot])
+                submitReflected(meshPacket(torusMesh, MakePacket(*forwardProgram, torusModel, torrusTex.ID, torusVAO.ID, torus.lods[torusLevel]), torusLevel));
+            // The fields lie behind the mirror, so their pyramids and tori are only ever culled here
+            for (size_t i = 0; i < fieldTransforms.size(); i++)
+            {
+                if (mirrorVisible[fieldSlot + i])
+                    submitReflected(meshPacket(pyramidMesh, MakePacket(*forwardProgram, fieldTransforms[i], brickTex.ID, pyramidVAO.ID, pyramidCount)));
+            }
+            for (size_t i = 0; i < torusFieldTransforms.size(); i++)
+            {
+                size_t level = lodSelector.Level(torusFieldSlot + i);
+                if (mirrorVisible[torusFieldSlot + i])
+                    submitReflected(meshPacket(torusMesh, MakePacket(*forwardProgram, torusFieldTransforms[i], torrusTex.ID, torusVAO.ID, torus.lods[level]), level));
+            }
+            mirrorQueue.Sort();
+
+            if (planarMirror.UsesTexture())
+            {
+                // Reduced resolution reflection texture, only re-rendered when due; the mirror
+                // surface samples it through the matrices of its last render
+                if (planarMirror.TextureDue())
+                {
+                    planarMirror.BeginTexture();
+                    RingBuffer::BindUniform(FRAME_BLOCK_BINDING, mirroredFrameRange);
+                    mirrorQueue.Draw(OPAQUE_PASS, frameRing);
+                    planarMirror.EndTexture(sceneFBO);
+                    mirrorShader.Activate();
+                    mirrorShader.set(uniforms.reflectionTransform, planarMirror.TextureTransform());
+                    mirrorShader.set(uniforms.reflectionLimit, planarMirror.TextureLimit());
+                }
+            }
+            else
+            {
+                // Mark the visible mirror pixels, reset them to the far plane, draw the reflected
+                // scene into them once, then blend the surface over it with its own depth
+                glState.BindFramebuffer(sceneFBO);
+                forwardProgram->Activate();
+                setModel(meshModel(mirrorMesh, mirrorModel));
+                planarMirror.BeginMask();
+                drawMesh(mirrorMesh, mirrorVAO, mirrorCount);
+                planarMirror.BeginClear();
+                drawMesh(mirrorMesh, mirrorVAO, mirrorCount);
+                planarMirror.BeginReflection();
+                RingBuffer::BindUniform(FRAME_BLOCK_BINDING, mirroredFrameRange);
+                mirrorQueue.Draw(OPAQUE_PASS, frameRing);
+                planarMirror.BeginSurface();
+                mirrorShader.Activate();
+                RingBuffer::BindUniform(FRAME_BLOCK_BINDING, mainFrameRange);
+                setModel(meshModel(mirrorMesh, mirrorModel));
+                drawMesh(mirrorMesh, mirrorVAO, mirrorCount);
+                planarMirror.End();
+            }
+
+            if (conditional)
+                glEndConditionalRender();
+        }
+        mirrorSkipped = mirrorHidden;
+
+        // Draw the blended pass (the mirror surface of the texture path) back to front.
+        RingBuffer::BindUniform(FRAME_BLOCK_BINDING, mainFrameRange);
+        renderQueue.Draw(BLENDED_PASS, frameRing);
+        frameRing.EndFrame();
+
+        if (profiled)
+            profiler.EndFrame();
+        glState.EndFrame();
+        frameIndex++;
 
         // Swap buffers and poll events.
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (window)
+        {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
     }
 
+    profiler.Finish();
+    // Printed after the loop: programs are only built (and stored) once they are first used.
+    programCache.PrintStats();
+    glState.PrintSummary();
+    std::cout << "Render queue (last frame): " << renderQueue.Size() << " packets, " << renderQueue.ProgramChanges()
+        << " program, " << renderQueue.TextureChanges() << " texture, " << renderQueue.VertexArrayChanges() << " VAO changes" << std::endl;
+    std::cout << "Frustum culling (last frame): " << mainVisibleCount << " of " << mainCulling.Size()
+        << " bounds visible, mirror view " << mirrorVisibleCount << std::endl;
+    if (options.occlusion)
+        occlusion->PrintStats();
+    if (useMultiDraw)
+        std::cout << "Multi-draw (last frame): " << multiDraw.DrawCount() << " draws in " << multiDraw.CommandCount()
+            << " indirect commands, 1 draw call" << std::endl;
+    if (options.arena)
+        arena->PrintStats();
+    meshOptimizer.PrintStats();
+    meshSimplifier.PrintStats();
+    lodSelector.PrintStats();
+    frameRing.PrintStats();
+    if (!dynamicLights.empty())
+        clusteredLighting.PrintStats();
+    deferredRenderer.PrintStats();
+    depthPrepass.PrintStats();
+    planarMirror.PrintStats();
+    if (options.bvh)
+        std::cout << "BVH: " << sceneBVH.NodeCount() << " nodes, cost " << sceneBVH.Cost() << " (" << sceneBVH.BuiltCost()
+            << " after build), " << sceneBVH.Rebuilds() << " rebuilds" << std::endl;
+    if (options.headless)
+    {
+        profiler.PrintSummary("headless");
+        profiler.WriteCSV(options.csvPath);
+        if (!options.dumpPath.empty())
+            DumpFramebuffer(sceneFBO, options.dumpPath);
+    }
+    profiler.Delete();
+
+    frameRing.Delete();
+    deferredRenderer.Delete();
+    depthPrepass.Delete();
+    planarMirror.Delete();
+    if (occlusion)
+        occlusion->Delete();
+    multiDraw.Delete();
+    if (arena)
+        arena->Delete();
+    fieldInstances.Delete();
     Cleanup(pyramid, cube, floor, sphere, lightCube,
         brickTex, sphereTex, floorTex,
-        shaderProgram, lightShader, mirrorShader, window);
+        sceneShaders, lightShader, mirrorShader, window);
+    if (options.headless)
+        headless.Destroy();
     return 0;
 }
 
+Options ParseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+            options.headless = true;
+        else if (arg == "--frames" && hasValue)
+            options.frameCount = std::atoi(argv[++i]);
+        else if (arg == "--timestep" && hasValue)
+            options.timeStep = (float)std::atof(argv[++i]);
+        else if (arg == "--warmup" && hasValue)
+            options.warmupFrames = std::atoi(argv[++i]);
+        else if (arg == "--csv" && hasValue)
+            options.csvPath = argv[++i];
+        else if (arg == "--dump" && hasValue)
+            options.dumpPath = argv[++i];
+        else if (arg == "--no-shader-cache")
+            options.shaderCache = false;
+        else if ((arg == "--camera" || arg == "--look") && hasValue)
+        {
+            glm::vec3 point;
+            if (std::sscanf(argv[++i], "%f,%f,%f", &point.x, &point.y, &point.z) == 3)
+                (arg == "--camera" ? options.cameraPos : options.cameraLook) = point;
+        }
+        else if (arg == "--instances" && hasValue)
+            options.instanceCount = std::atoi(argv[++i]);
+        else if (arg == "--no-instancing")
+            options.instancing = false;
+        else if (arg == "--tori" && hasValue)
+            options.torusFieldCount = std::atoi(argv[++i]);
+        else if (arg == "--lod-error" && hasValue)
+            options.lodPixelError = (float)std::atof(argv[++i]);
+        else if (arg == "--no-bvh")
+            options.bvh = false;
+        else if (arg == "--bvh-benchmark")
+            options.bvhBenchmark = true;
+        else if (arg == "--mesh-benchmark")
+            options.meshBenchmark = true;
+        else if (arg == "--occlusion")
+            options.occlusion = true;
+        else if (arg == "--multi-draw")
+            options.multiDraw = true;
+        else if (arg == "--no-arena")
+            options.arena = false;
+        else if (arg == "--no-persistent-map")
+            options.persistentMap = false;
+        else if (arg == "--lights" && hasValue)
+            options.dynamicLights = std::atoi(argv[++i]);
+        else if (arg == "--no-clustering")
+            options.clustering = false;
+        else if (arg == "--deferred")
+            options.deferred = true;
+        else if (arg == "--vertex-format" && hasValue)
+        {
+            if (!ParseVertexFormat(argv[++i], options.vertexFormat))
+                std::cout << "Unknown vertex format " << argv[i] << ", using float" << std::endl;
+        }
+        else if (arg == "--vertex-streams" && hasValue)
+        {
+            std::string streams = argv[++i];
+            if (streams != "interleaved" && streams != "split")
+                std::cout << "Unknown vertex streams " << streams << ", using interleaved" << std::endl;
+            options.splitStreams = streams == "split";
+        }
+        else if (arg == "--depth-prepass" && hasValue)
+        {
+            std::string mode = argv[++i];
+            options.depthPrepass = mode == "off" ? PREPASS_OFF : mode == "on" ? PREPASS_ON : PREPASS_AUTO;
+        }
+        else if (arg == "--no-cull")
+            options.cullBackFaces = false;
+        else if (arg == "--overdraw")
+            options.overdrawCounter = true;
+        else if (arg == "--mirror-scale" && hasValue)
+            options.mirrorScale = std::max((float)std::atof(argv[++i]), 0.0f);
+        else if (arg == "--mirror-update" && hasValue)
+        {
+            std::string mode = argv[++i];
+            options.mirrorInterval = mode == "motion" ? 0 : std::max(std::atoi(mode.c_str()), 1);
+        }
+        else if (arg == "--blinn")
+            options.blinn = true;
+        else if (arg == "--fog" && hasValue)
+        {
+            std::string mode = argv[++i];
+            options.fog = mode == "none" ? FOG_NONE : mode == "linear" ? FOG_LINEAR : FOG_EXP;
+        }
+        else
+            std::cout << "Unknown argument: " << arg << std::endl;
+    }
+    return options;
+}
+
+// Writes the color attachment of the given framebuffer as a binary PPM, top row first
+void DumpFramebuffer(GLuint fbo, const std::string& path)
+{
+    std::vector<unsigned char> pixels(width * height * 3);
+    glState.BindFramebuffer(fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int row = height - 1; row >= 0; row--)
+        out.write((const char*)&pixels[row * width * 3], width * 3);
+}
+
 void Cleanup(Object& pyramid, Object& cube, Object& floor, Object& sphere, Object& lightCube,
     Texture& brickTex, Texture& sphereTex, Texture& floorTex,
-    Shader& shaderProgram, Shader& lightShader, Shader& mirrorShader, GLFWwindow* window)
+    ShaderVariants& sceneShaders, Shader& lightShader, Shader& mirrorShader, GLFWwindow* window)
 {
     // Delete objects and textures.
     pyramid.Delete();
@@ -435,79 +1231,13 @@ void Cleanup(Object& pyramid, Object& cube, Object& floor, Object& sphere, Objec
     brickTex.Delete();
     floorTex.Delete();
     sphereTex.Delete();
-    shaderProgram.Delete();
+    sceneShaders.Delete();
     lightShader.Delete();
     mirrorShader.Delete();
-    glfwDestroyWindow(window);
-    glfwTerminate();
-}
-
-void generateSphere(float radius, unsigned int sectorCount, unsigned int stackCount,
-    std::vector<float>& vertices, std::vector<unsigned int>& indices)
-{
-    vertices.clear();
-    indices.clear();
-    float lengthInv = 1.0f / radius;
-    float sectorStep = 2 * glm::pi<float>() / sectorCount;
-    float stackStep = glm::pi<float>() / stackCount;
-
-    // Generate vertices.
-    for (unsigned int i = 0; i <= stackCount; ++i)
+    if (window)
     {
-        float stackAngle = glm::pi<float>() / 2 - i * stackStep;
-        float xy = radius * cosf(stackAngle);
-        float z = radius * sinf(stackAngle);
-
-        for (unsigned int j = 0; j <= sectorCount; ++j)
-        {
-            float sectorAngle = j * sectorStep;
-            float x = xy * cosf(sectorAngle);
-            float y = xy * sinf(sectorAngle);
-            float s = (float)j / sectorCount;
-            float t = (float)i / stackCount;
-            
-            // Position
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-            
-            // Color (white)
-            vertices.push_back(1.0f);
-            vertices.push_back(1.0f);
-            vertices.push_back(1.0f);
-
-            // Texture coordinates
-            vertices.push_back(s);
-            vertices.push_back(t);
-            
-            // Normal
-            vertices.push_back(x * lengthInv);
-            vertices.push_back(y * lengthInv);
-            vertices.push_back(z * lengthInv);
-        }
-    }
-
-    // Generate indices.
-    unsigned int k1, k2;
-    for (unsigned int i = 0; i < stackCount; ++i)
-    {
-        k1 = i * (sectorCount + 1);
-        k2 = k1 + sectorCount + 1;
-        for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2)
-        {
-            if (i != 0)
-            {
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-            }
-            if (i != (stackCount - 1))
-            {
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
-        }
+        glfwDestroyWindow(window);
+        glfwTerminate();
     }
 }
 
@@ -534,121 +1264,172 @@ void HandleSpotlightChange(GLFWwindow* window, LightSource& spotLight)
 std::tuple<Texture, Texture, Texture, Texture> SetupTextures(Shader& shaderProgram)
 {
     Texture brickTex("brick.png", GL_TEXTURE_2D, GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE);
-    brickTex.texUnit(shaderProgram, "tex0", 0);
     Texture floorTex("wood_texture.png", GL_TEXTURE_2D, GL_TEXTURE0, GL_RGB, GL_UNSIGNED_BYTE);
-    floorTex.texUnit(shaderProgram, "tex0", 0);
     Texture sphereTex("brick.png", GL_TEXTURE_2D, GL_TEXTURE0, GL_RGB, GL_UNSIGNED_BYTE);
-    sphereTex.texUnit(shaderProgram, "tex0", 0);
     Texture torrusTex("torrus.png", GL_TEXTURE_2D, GL_TEXTURE0, GL_RGB, GL_UNSIGNED_BYTE);
-    torrusTex.texUnit(shaderProgram, "tex0", 0);
+    // All textures sample from unit 0. Touching the program waits for its compile,
+    // so this comes after the image decoding.
+    brickTex.texUnit(shaderProgram, "tex0", 0);
 
     return { brickTex, floorTex, sphereTex, torrusTex };
 }
 
-std::tuple<LightSource, LightSource, LightSource> SetupLightSources(Shader& shaderProgram)
+std::tuple<LightSource, LightSource, LightSource> SetupLightSources()
 {
     LightSource fixedLight(POINT_LIGHT, glm::vec3(0.5f, 0.5f, 6.5f), glm::vec3(1.0f, 0.3f, 0.3f));
     LightSource spotLight(SPOT_LIGHT, glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(1.0f, 1.0f, 0.8f));
     LightSource dirLight(DIRECTIONAL_LIGHT, glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(1.0f, 1.0f, 0.0f));
     dirLight.direction = glm::normalize(glm::vec3(0.0f, -1.0f, 0.0f));
-
-    shaderProgram.setVec3("fixedLight.position", fixedLight.position);
-    shaderProgram.setVec3("fixedLight.color", fixedLight.color);
-    shaderProgram.setVec3("spotLight.color", spotLight.color);
-    shaderProgram.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-    shaderProgram.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-    shaderProgram.setVec3("dirLight.direction", dirLight.direction);
-    shaderProgram.setVec3("dirLight.color", dirLight.color);
-    shaderProgram.setFloat("fixedLight.cutOff", 0.0f);
-    shaderProgram.setFloat("dirLight.cutOff", 0.0f);
     return { fixedLight, spotLight, dirLight };
 }
 
-void SetFogUniforms(Shader& shaderProgram, float time, Camera camera, LightSource spotLight)
+// Camera and fog state for one view, laid out as the std140 FrameData block
+FrameBlock MakeFrameBlock(float time, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos)
 {
-    shaderProgram.setVec3("fogColor", glm::vec3(
-        0.5f + 0.5f * cos(time / 10),
-        0.5f + 0.5f * cos(time / 10),
-        0.5f + 0.5f * cos(time / 10)));
-    shaderProgram.setFloat("fogStart", -4.0f);
-    shaderProgram.setFloat("fogEnd", 1.0f + 20 * cos(time));
-    shaderProgram.setVec3("cameraPos", camera.Position);
-    shaderProgram.setVec3("spotLight.direction", spotLight.direction);
-    shaderProgram.setMatrix4("view", camera.viewMatrix);
-    shaderProgram.setMatrix4("projection", camera.projectionMatrix);
+    FrameBlock block;
+    block.view = view;
+    block.projection = projection;
+    block.camMatrix = projection * view;
+    block.cameraPos = cameraPos;
+    block.fogColor = glm::vec3(0.5f + 0.5f * cos(time / 10));
+    block.fogStart = -4.0f;
+    block.fogEnd = 1.0f + 20 * cos(time);
+    return block;
 }
 
-template <size_t VSize, size_t ISize>
-std::tuple<Object, VAO> SetupObject(GLfloat(&vertices)[VSize], GLuint(&indices)[ISize])
+// Indexed draw packet of a whole mesh
+DrawPacket MakePacket(Shader& shader, const glm::mat4& model,
+    GLuint texture, GLuint vao, GLsizei count)
 {
-    VAO vao;
-    vao.Bind();
-    VBO vbo(vertices, VSize * sizeof(GLfloat));
-    EBO ebo(indices, ISize * sizeof(GLuint));
-    Object obj(vao, vbo);
+    DrawPacket packet;
+    packet.shader = &shader;
+    packet.model = model;
+    packet.texture = texture;
+    packet.vao = vao;
+    packet.count = count;
+    return packet;
+}
 
-    obj.LinkAttributes();
-    obj.SetEBO(ebo);
-    obj.Unbind();
+// Indexed draw packet of one detail level of a mesh
+DrawPacket MakePacket(Shader& shader, const glm::mat4& model,
+    GLuint texture, GLuint vao, const MeshLod& lod)
+{
+    DrawPacket packet = MakePacket(shader, model, texture, vao, (GLsizei)lod.indexCount);
+    packet.first = (GLint)lod.firstIndex;
+    return packet;
+}
 
-    return { obj, vao };
+// Square grid of small spinning pyramids on the floor behind the mirror
+void UpdatePyramidField(std::vector<glm::mat4>& transforms, float time)
+{
+    int side = (int)std::ceil(std::sqrt((float)transforms.size()));
+    float spacing = 6.0f / side;
+    for (size_t i = 0; i < transforms.size(); i++)
+    {
+        float x = -3.0f + spacing * (i % side + 0.5f);
+        float z = -10.0f + spacing * (i / side + 0.5f);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+        model = glm::rotate(model, time + 0.1f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+        transforms[i] = glm::scale(model, glm::vec3(0.6f * spacing));
+    }
+}
+
+// Square grid of standing tori, turned to different angles, on the floor from the far end
+// of the pyramid field into the distance
+void SetupTorusField(std::vector<glm::mat4>& transforms)
+{
+    int side = (int)std::ceil(std::sqrt((float)transforms.size()));
+    const float spacing = 0.8f;
+    for (size_t i = 0; i < transforms.size(); i++)
+    {
+        float x = spacing * ((float)(i % side) - 0.5f * (side - 1));
+        float z = -11.0f - spacing * (i / side);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.1f, z));
+        model = glm::rotate(model, 0.7f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+        transforms[i] = glm::scale(model, glm::vec3(0.5f));
+    }
 }
 
+// Colored lights with a short range scattered over the floor; every fourth one is a
+// spotlight pointing down
+std::vector<LightSource> SetupDynamicLights(int count)
+{
+    std::vector<LightSource> lights;
+    for (int i = 0; i < count; i++)
+    {
+        // Golden angle hues, so neighbouring lights get different colors
+        float hue = std::fmod(i * 0.618034f, 1.0f) * 6.0f;
+        glm::vec3 color = glm::clamp(glm::vec3(std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f)), 0.0f, 1.0f);
+        LightSource light(i % 4 == 3 ? SPOT_LIGHT : POINT_LIGHT, glm::vec3(0.0f), color * 0.6f);
+        light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        light.cutOff = glm::cos(glm::radians(25.0f));
+        light.outerCutOff = glm::cos(glm::radians(35.0f));
+        light.radius = light.type == SPOT_LIGHT ? 2.5f : 1.5f + (i % 3) * 0.5f;
+        lights.push_back(light);
+    }
+    return lights;
+}
 
-template <size_t VSize>
-std::tuple<Object, VAO> SetupObject(GLfloat(&vertices)[VSize])
+// Moves every dynamic light on its own circle around a fixed point of the floor
+void UpdateDynamicLights(std::vector<LightSource>& lights, float time)
 {
-    VAO vao; 
+    int side = (int)std::ceil(std::sqrt((float)lights.size()));
+    float spacing = 18.0f / side;
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        float x = -9.0f + spacing * (i % side + 0.5f);
+        float z = -9.0f + spacing * (i / side + 0.5f);
+        float angle = time * (0.5f + 0.1f * (i % 7)) + i;
+        float height = lights[i].type == SPOT_LIGHT ? 1.5f : 0.4f + 0.2f * (i % 4);
+        lights[i].position = glm::vec3(x + 0.4f * spacing * cosf(angle), height, z + 0.4f * spacing * sinf(angle));
+    }
+}
+
+SceneUniforms ResolveSceneUniforms(const Shader& mirrorShader)
+{
+    SceneUniforms uniforms;
+    uniforms.mirrorColor = mirrorShader.GetUniform<glm::vec4>("mirrorColor");
+    uniforms.reflectionTexture = mirrorShader.GetUniform<int>("reflectionTexture");
+    uniforms.reflectionTransform = mirrorShader.GetUniform<glm::mat4>("reflectionTransform");
+    uniforms.reflectionLimit = mirrorShader.GetUniform<glm::vec2>("reflectionLimit");
+    return uniforms;
+}
+
+// Optimizes the mesh (MeshOptimizer.h), appends its detail levels (MeshSimplifier.h) and
+// uploads it to a new VAO
+template <typename Layout>
+std::tuple<Object, VAO> SetupObject(MeshOptimizer& optimizer, MeshSimplifier& simplifier, const char* name, MeshData& mesh)
+{
+    optimizer.Optimize(name, mesh, Layout::Stride / sizeof(GLfloat));
+    simplifier.BuildLods(name, mesh, Layout::Stride / sizeof(GLfloat));
+    VAO vao;
     vao.Bind();
-    VBO vbo(vertices, sizeof(vertices));
+    VBO vbo(mesh.vertices.data(), mesh.vertices.size() * sizeof(GLfloat));
+    EBO ebo(mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
     Object obj(vao, vbo);
-    obj.LinkAttributes();
+    obj.ComputeBounds<Layout>(mesh.vertices.data(), mesh.vertices.size());
+
+    obj.lods = mesh.lods;
+
+    obj.LinkAttributes<Layout>();
+    obj.SetEBO(ebo);
     obj.Unbind();
 
     return { obj, vao };
 }
 
 
-std::tuple<Object, VAO> SetupSphere(std::vector<float>& sphereVerts, std::vector<unsigned int>& sphereInds)
+std::tuple<Object, VAO> SetupSphere(MeshOptimizer& optimizer, MeshSimplifier& simplifier, MeshData& sphereData)
 {
-    generateSphere(0.5f, 36, 18, sphereVerts, sphereInds);
-    VAO sphereVAO; sphereVAO.Bind();
-    VBO sphereVBO(sphereVerts.data(), sphereVerts.size() * sizeof(float));
-    EBO sphereEBO(sphereInds.data(), sphereInds.size() * sizeof(unsigned int));
-    Object sphere(sphereVAO, sphereVBO);
-    sphere.LinkAttributes();
-    sphere.Unbind();
-    return { sphere, sphereVAO };
-}
-
-std::tuple<GLuint, GLuint> SetupMirrorTexture()
-{
-    GLuint reflectionTexture;
-    glGenTextures(1, &reflectionTexture);
-    glBindTexture(GL_TEXTURE_2D, reflectionTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Reflection framebuffer.
-    GLuint reflectionFBO;
-    glGenFramebuffers(1, &reflectionFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, reflectionFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reflectionTexture, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    return { reflectionTexture, reflectionFBO };
+    MeshGenerator generator;
+    generator.Sphere(0.5f, 36, 18, sphereData.vertices, sphereData.indices);
+    return SetupObject(optimizer, simplifier, "sphere", sphereData);
 }
 
 std::tuple<
     std::list<std::tuple<Object, VAO>>, 
     std::list<LightSource>, 
-    std::list<Texture>,
-    GLuint, GLuint
+    std::list<Texture>
 > Setup(Shader& shaderProgram)
 {
     std::list<std::tuple<Object,VAO>> ans = {};
@@ -656,30 +1437,36 @@ std::tuple<
     std::list<LightSource> sources = {};
 
     // --- Set Up Geometry Objects ---
+    MeshOptimizer optimizer;
+    MeshSimplifier simplifier;
     // Pyramid
-    auto [pyramid, pyramidVAO] = SetupObject(pyramidVertices, pyramidIndices);
+    MeshData pyramidData(pyramidVertices, pyramidIndices);
+    auto [pyramid, pyramidVAO] = SetupObject(optimizer, simplifier, "pyramid", pyramidData);
     ans.push_back({ pyramid, pyramidVAO });
 
     // Moving Cube
-    auto [cube, cubeVAO] = SetupObject(cubeVertices);
+    MeshData cubeData(cubeVertices);
+    auto [cube, cubeVAO] = SetupObject(optimizer, simplifier, "cube", cubeData);
     ans.push_back({ cube, cubeVAO });
 
     // Floor
-    auto [floor, floorVAO] = SetupObject(floorVertices, floorIndices);
+    MeshData floorData(floorVertices, floorIndices);
+    auto [floor, floorVAO] = SetupObject(optimizer, simplifier, "floor", floorData);
     ans.push_back({ floor, floorVAO });
 
     // Rotating Sphere
-    std::vector<float> sphereVerts;
-    std::vector<unsigned int> sphereInds;
-    auto [sphere, sphereVAO] = SetupSphere(sphereVerts, sphereInds);
+    MeshData sphereData;
+    auto [sphere, sphereVAO] = SetupSphere(optimizer, simplifier, sphereData);
     ans.push_back({ sphere, sphereVAO });
 
     // Light Cube
-    auto [lightCube, lightVAO] = SetupObject(lightVertices, lightIndices);
+    MeshData lightData(lightVertices, lightIndices);
+    auto [lightCube, lightVAO] = SetupObject<PositionLayout>(optimizer, simplifier, "light cube", lightData);
     ans.push_back({ lightCube, lightVAO });
 
     // Mirror
-    auto [mirror, mirrorVAO] = SetupObject(mirrorVertices, mirrorIndices);
+    MeshData mirrorData(mirrorVertices, mirrorIndices);
+    auto [mirror, mirrorVAO] = SetupObject(optimizer, simplifier, "mirror", mirrorData);
     ans.push_back({ mirror, mirrorVAO });
 
     // --- Set Up Textures ---
@@ -689,105 +1476,17 @@ std::tuple<
     texs.push_back(sphereTex);
 
     // --- Set Up Lights ---
-    auto [fixedLight, spotLight, dirLight] = SetupLightSources(shaderProgram);
+    auto [fixedLight, spotLight, dirLight] = SetupLightSources();
     sources.push_back(fixedLight);
     sources.push_back(spotLight);
     sources.push_back(dirLight);
-
-    // Create a texture and framebuffer for mirror reflection.
-    auto [reflectionTexture, reflectionFBO] = SetupMirrorTexture();
-    return { ans, sources, texs, reflectionTexture, reflectionFBO };
+    return { ans, sources, texs };
 }
 
-void generateTorus(float innerRadius, float outerRadius, unsigned int nsides, unsigned int nrings,
-    std::vector<float>& vertices, std::vector<unsigned int>& indices)
-{
-    vertices.clear();
-    indices.clear();
-
-    float ringFactor = 2.0f * glm::pi<float>() / nrings;
-    float sideFactor = 2.0f * glm::pi<float>() / nsides;
-    float offsetY = 0.5f;  
-
-    // Generate vertices.
-    for (unsigned int ring = 0; ring <= nrings; ++ring)
-    {
-        float u = ring * ringFactor;
-        float cosU = cos(u);
-        float sinU = sin(u);
-        for (unsigned int side = 0; side <= nsides; ++side)
-        {
-            float v = side * sideFactor;
-            float cosV = cos(v);
-            float sinV = sin(v);
-
-            // The distance from the center of the torus tube to the current point.
-            float r = outerRadius + innerRadius * cosV;
-            float x = r * cosU;
-            float y = r * sinU + offsetY;  // add the offset here
-            float z = innerRadius * sinV;
-
-            // Position.
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-
-            // Color (choose a pleasant light blue color).
-            vertices.push_back(0.3f);
-            vertices.push_back(0.7f);
-            vertices.push_back(0.9f);
-
-            // Texture coordinates.
-            vertices.push_back((float)ring / nrings);
-            vertices.push_back((float)side / nsides);
-
-            // Compute normal.
-            // The center of the tube for this ring is at (outerRadius*cosU, outerRadius*sinU, 0), then add the same offset.
-            float cx = outerRadius * cosU;
-            float cy = outerRadius * sinU + offsetY;
-            float cz = 0.0f;
-            glm::vec3 normal = glm::normalize(glm::vec3(x - cx, y - cy, z - cz));
-            vertices.push_back(normal.x);
-            vertices.push_back(normal.y);
-            vertices.push_back(normal.z);
-        }
-    }
-
-    // Generate indices.
-    for (unsigned int ring = 0; ring < nrings; ++ring)
-    {
-        unsigned int ringStart = ring * (nsides + 1);
-        unsigned int nextRingStart = (ring + 1) * (nsides + 1);
-        for (unsigned int side = 0; side < nsides; ++side)
-        {
-            unsigned int current = ringStart + side;
-            unsigned int next = ringStart + side + 1;
-            unsigned int currentNextRing = nextRingStart + side;
-            unsigned int nextNextRing = nextRingStart + side + 1;
-            // Two triangles per quad.
-            indices.push_back(current);
-            indices.push_back(currentNextRing);
-            indices.push_back(next);
-
-            indices.push_back(next);
-            indices.push_back(currentNextRing);
-            indices.push_back(nextNextRing);
-        }
-    }
-}
-
-
-std::tuple<Object, VAO> SetupTorus(std::vector<float>& torusVerts, std::vector<unsigned int>& torusInds)
+std::tuple<Object, VAO> SetupTorus(MeshOptimizer& optimizer, MeshSimplifier& simplifier, MeshData& torusData)
 {
-    generateTorus(0.2f, 0.5f, 24, 24, torusVerts, torusInds);
-    VAO torusVAO;
-    torusVAO.Bind();
-    VBO torusVBO(torusVerts.data(), torusVerts.size() * sizeof(float));
-    EBO torusEBO(torusInds.data(), torusInds.size() * sizeof(unsigned int));
-    Object torus(torusVAO, torusVBO);
-    torus.LinkAttributes();
-    torus.SetEBO(torusEBO);
-    torus.Unbind();
-    return { torus, torusVAO };
+    MeshGenerator generator;
+    generator.Torus(0.2f, 0.5f, 24, 24, torusData.vertices, torusData.indices);
+    return SetupObject(optimizer, simplifier, "torus", torusData);
 }
 
@@ -1,14 +1,27 @@
 #version 330 core
 
-in vec2 TexCoords;  // Receive texture coordinates from vertex shader
+#ifndef REFLECTION_TEXTURE
+#define REFLECTION_TEXTURE 0
+#endif
+
+#if REFLECTION_TEXTURE
+in vec4 ReflectionCoords;  // Projective coordinates in the reflection texture
+uniform sampler2D reflectionTexture;
+uniform vec2 reflectionLimit;  // Only the texels below this were rendered
+#endif
 
 out vec4 FragColor;
 
-uniform vec4 mirrorColor;  
-uniform sampler2D reflectionTexture;  // The reflection texture
+uniform vec4 mirrorColor;  // Tint blended over the reflection drawn behind the surface
 
 void main()
 {
-    // Sample the reflection texture with the given texture coordinates
-    FragColor = texture(reflectionTexture, TexCoords) * mirrorColor;
+#if REFLECTION_TEXTURE
+    // Same tint, applied to the reflection texture instead of the framebuffer
+    vec2 coords = min(ReflectionCoords.xy / ReflectionCoords.w, reflectionLimit);
+    vec3 reflected = texture(reflectionTexture, coords).rgb;
+    FragColor = vec4(mix(reflected, mirrorColor.rgb, mirrorColor.a), 1.0);
+#else
+    FragColor = mirrorColor;
+#endif
 }
@@ -1,19 +1,42 @@
 #version 330 core
 
+// The surface samples a reflection texture instead of tinting a reflection drawn behind it
+#ifndef REFLECTION_TEXTURE
+#define REFLECTION_TEXTURE 0
+#endif
+
 layout(location = 0) in vec3 aPos;       // Object position
-layout(location = 1) in vec2 aTexCoords; // Texture coordinates
 
-out vec2 TexCoords;  // Output texture coordinates to fragment shader
+#if REFLECTION_TEXTURE
+// World position to coordinates in the reflection texture (PlanarMirror::TextureTransform)
+uniform mat4 reflectionTransform;
+out vec4 ReflectionCoords;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Model matrix of the draw, written to the per-frame ring buffer (UniformBlocks.h ObjectBlock)
+layout(std140) uniform ObjectData
+{
+    mat4 model;
+};
 
-void main()
+// Camera and fog state shared by all programs, updated once per frame.
+layout(std140) uniform FrameData
 {
-    // Pass texture coordinates to fragment shader
-    TexCoords = aTexCoords;
+    mat4 view;
+    mat4 projection;
+    mat4 camMatrix;
+    vec3 cameraPos;
+    float fogStart;
+    vec3 fogColor;
+    float fogEnd;
+};
 
+void main()
+{
     // Calculate the final position of the vertex
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
+#if REFLECTION_TEXTURE
+    ReflectionCoords = reflectionTransform * worldPos;
+#endif
 }
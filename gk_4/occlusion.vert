@@ -0,0 +1,24 @@
+#version 330 core
+
+// Corner of the unit cube, scaled onto the tested box
+layout (location = 0) in vec3 aPos;
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+// Camera and fog state shared by all programs, updated once per frame.
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 camMatrix;
+    vec3 cameraPos;
+    float fogStart;
+    vec3 fogColor;
+    float fogEnd;
+};
+
+void main()
+{
+	gl_Position = camMatrix * vec4(mix(boxMin, boxMax, aPos), 1.0f);
+}